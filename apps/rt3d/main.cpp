@@ -1,5 +1,7 @@
 #include <QApplication>
+#include <QThreadPool>
 #include "../../src/main_window/main_window.h"
+#include "../../src/utility/pythonruntime.h"
 #include <QDebug>
 #include <pybind11/embed.h> // everything needed for embedding
 
@@ -24,8 +26,18 @@ int main(int argc, char *argv[]) {
 
     if (GeneralSettings::getOpenGLValue()) qInfo() << "Using OpenGL";
 
-    auto w = MainWindow(message.getConsoleWidget());
-    w.show();
-    return QApplication::exec();
+    // the scripts import while the window opens
+    PythonRuntime::instance()->warmUp();
+
+    int code;
+    {
+        auto w = MainWindow(message.getConsoleWidget());
+        w.show();
+        code = QApplication::exec();
+    }
+    // the window is gone and no pool job is left that could resolve a function again
+    QThreadPool::globalInstance()->waitForDone();
+    PythonRuntime::instance()->release();
+    return code;
 
 }
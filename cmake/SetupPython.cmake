@@ -19,6 +19,7 @@ message(STATUS ${python_site_packages})
 
 set(PYTHON_SCRIPTS_DIR "${CMAKE_CURRENT_LIST_DIR}/../scripts" CACHE INTERNAL "")  # hacked path, no time for fanciness
 message(DEBUG "Python scripts directory: ${PYTHON_SCRIPTS_DIR}")
+set(PYTHON_EXTENSIONS_DIR "${CMAKE_BINARY_DIR}/python" CACHE INTERNAL "")
 
 
 function(find_python_package NAME)
@@ -53,3 +54,11 @@ function(include_python_script SCRIPT_NAME TARGET_NAME)
 
 endfunction()
 
+
+# Builds a module the application embeds as an extension module of the same name, for the scripts run on their own.
+# The source defines its module with PYBIND11_MODULE when RT3D_PYTHON_EXTENSION is set.
+function(add_python_extension NAME SOURCE)
+    pybind11_add_module(${NAME} MODULE ${SOURCE})
+    target_compile_definitions(${NAME} PRIVATE RT3D_PYTHON_EXTENSION)
+    set_target_properties(${NAME} PROPERTIES LIBRARY_OUTPUT_DIRECTORY "${PYTHON_EXTENSIONS_DIR}")
+endfunction()
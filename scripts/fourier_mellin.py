@@ -0,0 +1,84 @@
+"""
+Rotation and scale invariant matching of a flight image to the base map (Fourier-Mellin).
+
+The magnitude of a spectrum does not change with translation, and a rotation or scaling of the image rotates or
+ scales its magnitude spectrum. Resampled on a log-polar grid, rotation and scale become shifts along the angle and
+ log-radius axes, so a phase correlation of the two log-polar magnitudes gives both. The flight image is then
+ rotated and scaled to the base map and the translation is found by the usual phase matcher.
+
+The log-polar resampling and its correlation are those of the pair pre-registration (src/utility/FourierMellin.hpp),
+ from the rt3d_fourier_mellin module the application embeds and the build also makes as an extension module.
+"""
+import cv2 as cv
+import numpy as np
+import rt3d_fourier_mellin as _native
+
+from .phase_correlation import windowed_spectrum
+from .phase_matching_correct import phase_matching_correct
+from .tile_bank import snap
+
+# Angle and log-radius samples of the log-polar magnitudes
+POLAR_SIZE = 256
+
+
+def log_polar_magnitude(spectrum):
+    """
+    :param spectrum: Centred windowed spectrum, see windowed_spectrum
+    :return: POLAR_SIZE x POLAR_SIZE float32 log-polar magnitude, rows are angles over a full turn
+    """
+    return _native.log_polar_magnitude(np.abs(spectrum).astype(np.float32), POLAR_SIZE)
+
+
+def rotation_scale(lp_tmp, lp_src, temp_size):
+    """
+    :return: Rotation in degrees, counter clockwise, and scale that turn the flight image onto the base map,
+     a spectrum cannot tell the rotation from the one half a turn away
+    """
+    angle, scale, _ = _native.rotation_scale(lp_src, lp_tmp, temp_size)
+    return angle, scale
+
+
+def derotate(img_tmp, angle, scale):
+    """The flight image turned by angle and resized by scale about its centre onto the base map, same frame size."""
+    h, w = img_tmp.shape
+    m = cv.getRotationMatrix2D((w / 2, h / 2), angle, scale)
+    return cv.warpAffine(img_tmp, m, (w, h), flags=cv.INTER_LINEAR, borderMode=cv.BORDER_REFLECT)
+
+
+def fourier_mellin_match(img_tmp, img_src, n_current_x, n_current_y, count=3, n_xstep=50, bank=None, window=450):
+    """
+    Matches a flight image taken at another heading or altitude than the base map.
+    Rotation and scale are estimated against the base map block at the prior position, whose log-polar magnitude
+     is kept in the tile bank, then the translation of both candidate rotations is searched and the stronger kept.
+
+    :param img_tmp: The current flight image, greyscale array
+    :param img_src: The reference image (base map)
+    :param bank: Optional TileBank of img_src
+    :return: x, y, the mean correlation peak (0 to 1), the rotation in degrees and the scale of the flight image
+    """
+    temp_size = 300
+    h1, w1 = img_tmp.shape
+    s1 = round(h1 / 2 - temp_size / 2)
+    s3 = round(w1 / 2 - temp_size / 2)
+    lp_tmp = log_polar_magnitude(windowed_spectrum(img_tmp[s1:s1 + temp_size, s3:s3 + temp_size], temp_size))
+
+    x0 = snap(n_current_x - temp_size / 2, n_xstep)
+    y0 = snap(n_current_y - temp_size / 2, n_xstep)
+    if bank is not None:
+        lp_src = bank.log_polar(x0, y0)
+    else:
+        block = img_src[max(y0, 0):y0 + temp_size, max(x0, 0):x0 + temp_size]
+        lp_src = log_polar_magnitude(windowed_spectrum(block, temp_size)) \
+            if block.shape == (temp_size, temp_size) else None
+    if lp_src is None:
+        return int(n_current_x), int(n_current_y), 0.0, 0.0, 1.0
+
+    angle, scale = rotation_scale(lp_tmp, lp_src, temp_size)
+    best = None
+    for candidate in (angle, angle + 180.0):
+        upright = derotate(img_tmp, candidate, scale)
+        x, y, peak = phase_matching_correct(upright, img_src, n_current_x, n_current_y, count, n_xstep, bank, window)
+        if best is None or peak > best[2]:
+            # the heading of the flight image is the turn that takes it back
+            best = (x, y, peak, float((180.0 - candidate) % 360.0 - 180.0), float(1.0 / scale))
+    return best
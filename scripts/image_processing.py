@@ -1,29 +1,123 @@
 import numpy as np
 from PIL import Image
 
+from .fourier_mellin import fourier_mellin_match
 from .phase_matching_correct import phase_matching_correct
+from .pyramid_search import coarse_to_fine
+from .template_match import template_match
+from .tile_bank import bank_for, prebuild_corridor
 
 thresh = 0
 er_x = 0
 er_y = 0
 
+# Matchers, as NavigationSettings::Matcher
+PHASE_CORRELATION = 0
+NORMALISED_CROSS_CORRELATION = 1
 
-def match_aerial_to_map(aerial_image_path: str, map_image_path: str, x: int, y: int):
+# Below this peak the translation match has failed, a match holds peaks of 0.4 and more and a failure about 0.02
+ROTATION_FALLBACK_PEAK = 0.1
+# The NCC of a wrong position is often 0.3 on textured ground, a match holds 0.6 and more
+NCC_ACCEPT = 0.6
+
+# Stages of match_aerial_to_map, which one gave the position
+STAGE_PHASE = 'phase'
+STAGE_NCC = 'ncc'
+STAGE_ROTATED = 'rotated'
+STAGE_NONE = 'none'
+
+
+def match_aerial_to_map(aerial_image_path: str, map_image_path: str, x: int, y: int, window: int = 450,
+                        matcher: int = PHASE_CORRELATION):
+    """
+    With phase correlation, falls back to the dense NCC when the flight image does not match by translation, and
+     to the rotation and scale invariant match when the NCC does not hold either, e.g. when the heading or altitude
+     differs from the base map. The NCC comes first as it costs about one phase correlation.
+
+    :param matcher: PHASE_CORRELATION or NORMALISED_CROSS_CORRELATION
+    :return: x, y, the match confidence and the stage that gave it. The confidence is the mean phase correlation
+     peak, or the NCC (0 to 1) when it reaches NCC_ACCEPT, below that it is 0 as such an NCC says nothing
+    """
     aerial_image = Image.open(aerial_image_path)
     aerial_image = aerial_image.convert('L')
 
-    map_image = Image.open(map_image_path)
-    map_image = map_image.convert('L')
+    bank = bank_for(map_image_path)
+
+    if matcher == NORMALISED_CROSS_CORRELATION:
+        return match_ncc(aerial_image, bank.img_src, x, y, window)
+
+    new_pos = image_matching(aerial_image, bank.img_src, np.array([x, y]), bank, window)
+    if new_pos[2] >= ROTATION_FALLBACK_PEAK:
+        return int(new_pos[0]), int(new_pos[1]), float(new_pos[2]), STAGE_PHASE
 
-    new_pos = image_matching(aerial_image, map_image, np.array([x, y]))
-    return new_pos[0], new_pos[1]
+    ncc = match_ncc(aerial_image, bank.img_src, x, y, window)
+    if ncc[2] > 0:
+        return ncc
+
+    rotated = match_rotated(np.array(aerial_image), bank, x, y, window)
+    if rotated[2] >= ROTATION_FALLBACK_PEAK:
+        return rotated[0], rotated[1], rotated[2], STAGE_ROTATED
+    return int(x), int(y), 0.0, STAGE_NONE
+
+
+def match_ncc(aerial_image, img_src, x, y, window=450):
+    """
+    :return: x, y, the NCC of the dense template match, 0 below NCC_ACCEPT, and the stage
+    """
+    nx_pos, ny_pos, peak = template_match(np.array(aerial_image), img_src, x + er_x, y - er_y, window)
+    if peak < NCC_ACCEPT:
+        return int(x), int(y), 0.0, STAGE_NONE
+    return int(round(nx_pos)), int(round(ny_pos)), float(peak), STAGE_NCC
+
+
+def match_aerial_to_map_rotated(aerial_image_path: str, map_image_path: str, x: int, y: int, window: int = 450):
+    """
+    Rotation and scale invariant match, see fourier_mellin.
+
+    :return: x, y, the match confidence, the heading of the flight image relative to the base map in degrees
+     and its scale
+    """
+    aerial_image = np.array(Image.open(aerial_image_path).convert('L'))
+    return match_rotated(aerial_image, bank_for(map_image_path), x, y, window)
+
+
+def match_rotated(aerial_image, bank, x, y, window=450):
+    """
+    :param aerial_image: Greyscale array of the flight image
+    :param bank: TileBank of the base map
+    :return: As match_aerial_to_map_rotated
+    """
+    nx_pos, ny_pos, peak, angle, scale = fourier_mellin_match(aerial_image, bank.img_src, x + er_x, y - er_y,
+                                                              3, 50, bank, window)
+    return int(nx_pos), int(ny_pos), float(peak), float(angle), float(scale)
+
+
+def match_aerial_to_map_pyramid(aerial_image_path: str, map_image_path: str, x: int, y: int, radius: int):
+    """
+    Coarse to fine search for large prior position errors, e.g. after a GPS loss.
+
+    :param radius: Search radius around (x, y) in base map pixels
+    :return: x, y and the match confidence
+    """
+    aerial_image = np.array(Image.open(aerial_image_path).convert('L'))
+    nx_pos, ny_pos, peak = coarse_to_fine(aerial_image, map_image_path, x + er_x, y - er_y, radius)
+    return int(nx_pos), int(ny_pos), float(peak)
+
+
+def prebuild_map_corridor(map_image_path: str, points):
+    """
+    Caches the base map block spectra around each planned waypoint ahead of the flight.
+    """
+    return prebuild_corridor(map_image_path, points)
 
 
-def image_matching(img_tmp1, img_src, pos):
+def image_matching(img_tmp1, img_src, pos, bank=None, window=450):
     """
     :param img_tmp1: UAV image
     :param img_src: Base map image
     :param pos:
+    :param bank: Optional TileBank of the base map
+    :param window: Search window size in pixels
     :return:
     """
     n_true_x = pos[0] + er_x
@@ -32,6 +126,6 @@ def image_matching(img_tmp1, img_src, pos):
     img_tmp1 = np.array(img_tmp1)  # the current flight location image
     img_src = np.array(img_src)  # the reference image
 
-    nx_pos, ny_pos = phase_matching_correct(img_tmp1, img_src, n_true_x, n_true_y, 3, 50)
+    nx_pos, ny_pos, peak = phase_matching_correct(img_tmp1, img_src, n_true_x, n_true_y, 3, 50, bank, window)
 
-    return np.array([nx_pos, ny_pos])
+    return np.array([nx_pos, ny_pos, peak])
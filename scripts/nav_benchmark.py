@@ -0,0 +1,239 @@
+"""
+Accuracy and latency benchmark of the flight image matcher against known positions.
+
+The corpus is a folder of flight images with a ground_truth.csv (file,x,y[,heading,prior_x,prior_y]),
+as written by the flight simulator, and a base map given with --map or found in the folder as basemap.*.
+
+    python -m scripts.nav_benchmark data/navigation_images --windows 450 550 --steps 25 50 --counts 1 3
+
+--matcher phase times phase_matching_correct alone, aerial the full match_aerial_to_map with its fallbacks and
+ pyramid the coarse to fine search over --radii. Each configuration also matches every frame from a prior moved
+ --wrong-prior px off the truth in a seeded direction, and reports the share of those the tracker would accept
+ at a wrong position, the false accept rate.
+"""
+import argparse
+import csv
+import json
+import time
+from pathlib import Path
+
+import numpy as np
+from PIL import Image
+
+from . import image_processing
+from .phase_matching_correct import phase_matching_correct
+from .tile_bank import TileBank, bank_for, load_base_map
+
+# Matches further than this from the truth count as failures, in base map pixels
+FAILURE_DISTANCE = 30.0
+# Lowest confidence the flight tracker accepts, FlightTracker::minConfidence
+ACCEPT_CONFIDENCE = 0.08
+
+MATCHERS = ('phase', 'aerial', 'pyramid')
+
+
+def read_ground_truth(corpus_dir: Path):
+    """
+    :return: List of (image path, truth (x, y), prior (x, y)), the prior is the truth when not recorded
+    """
+    frames = []
+    with open(corpus_dir / 'ground_truth.csv', newline='') as file:
+        for row in csv.DictReader(file):
+            truth = (float(row['x']), float(row['y']))
+            prior = truth
+            if row.get('prior_x') and row.get('prior_y'):
+                prior = (float(row['prior_x']), float(row['prior_y']))
+            frames.append((corpus_dir / row['file'], truth, prior))
+    return frames
+
+
+def find_base_map(corpus_dir: Path):
+    for candidate in sorted(corpus_dir.glob('basemap.*')):
+        return candidate
+    raise FileNotFoundError(f'No basemap.* in {corpus_dir}, give the base map with --map')
+
+
+def percentile(values, q):
+    return float(np.percentile(values, q)) if len(values) else 0.0
+
+
+def wrong_priors(frames, distance, seed):
+    """The frames with their prior moved distance px from the truth in a seeded random direction."""
+    rng = np.random.default_rng(seed + 1)
+    angles = rng.uniform(0, 2 * np.pi, len(frames))
+    return [(path, truth, (truth[0] + distance * np.cos(a), truth[1] + distance * np.sin(a)))
+            for (path, truth, _), a in zip(frames, angles)]
+
+
+def run_config(frames, match, clear, accept=ACCEPT_CONFIDENCE):
+    """
+    Matches every frame once.
+
+    :param match: Callable (image path, prior) -> x, y, confidence, stage
+    :param clear: Callable emptying the base map caches before every match, None to reuse them as in flight
+    :param accept: Confidence from which a match counts as accepted
+    :return: Dictionary of the scores
+    """
+    latencies = []
+    errors = []
+    peaks = []
+    stages = {}
+    failures = 0
+    false_accepts = 0
+    for image_path, truth, prior in frames:
+        if clear is not None:
+            clear()
+        start = time.perf_counter()
+        x, y, peak, stage = match(image_path, prior)
+        latencies.append((time.perf_counter() - start) * 1000)
+
+        error = float(np.hypot(x - truth[0], y - truth[1]))
+        peaks.append(peak)
+        stages[stage] = stages.get(stage, 0) + 1
+        if peak <= 0 or error > FAILURE_DISTANCE:
+            failures += 1
+            if peak >= accept and error > FAILURE_DISTANCE:
+                false_accepts += 1
+        else:
+            errors.append(error)
+
+    total_s = sum(latencies) / 1000
+    return {
+        'frames': len(frames),
+        'matches_per_second': len(frames) / total_s if total_s > 0 else 0.0,
+        'latency_ms': {
+            'mean': float(np.mean(latencies)) if latencies else 0.0,
+            'p50': percentile(latencies, 50),
+            'p95': percentile(latencies, 95),
+            'p99': percentile(latencies, 99),
+        },
+        'rms_error_px': float(np.sqrt(np.mean(np.square(errors)))) if errors else None,
+        'failure_rate': failures / len(frames) if frames else 0.0,
+        'false_accept_rate': false_accepts / len(frames) if frames else 0.0,
+        'mean_confidence': float(np.mean(peaks)) if peaks else 0.0,
+        'stages': stages,
+    }
+
+
+def configurations(matcher, img_src, map_path, windows, steps, counts, radii):
+    """
+    :return: (parameters, match, clear) of every configuration of the matcher, see run_config
+    """
+    if matcher == 'phase':
+        for window in windows:
+            for step in steps:
+                for count in counts:
+                    # a bank per configuration, so earlier configurations do not warm it
+                    bank = TileBank(img_src)
+
+                    def match(path, prior, bank=bank, window=window, step=step, count=count):
+                        img_tmp = np.array(Image.open(path).convert('L'))
+                        x, y, peak = phase_matching_correct(img_tmp, bank.img_src, prior[0], prior[1],
+                                                            count, step, bank, window)
+                        return x, y, peak, 'phase'
+
+                    yield {'window': window, 'step': step, 'count': count}, match, bank.blocks.clear
+    elif matcher == 'aerial':
+        # the application's entry point, on the bank it keeps for the base map
+        bank = bank_for(str(map_path))
+        for window in windows:
+            def match(path, prior, window=window):
+                return image_processing.match_aerial_to_map(str(path), str(map_path), round(prior[0]),
+                                                            round(prior[1]), window)
+
+            yield {'window': window}, match, bank.blocks.clear
+    else:
+        bank = bank_for(str(map_path))
+        for radius in radii:
+            def match(path, prior, radius=radius):
+                x, y, peak = image_processing.match_aerial_to_map_pyramid(str(path), str(map_path), round(prior[0]),
+                                                                         round(prior[1]), radius)
+                return x, y, peak, 'pyramid'
+
+            yield {'radius': radius}, match, bank.blocks.clear
+
+
+def benchmark(corpus_dir, map_path=None, windows=(450,), steps=(50,), counts=(3,),
+              prior_error=0.0, repeats=2, cold=False, seed=1, matcher='phase', radii=(1000,), wrong_prior=600.0):
+    """
+    Runs every configuration of the matcher over the corpus, (window, step, count) for phase, the window for
+     aerial and the radius for pyramid.
+
+    :param prior_error: Standard deviation in pixels added to the priors, seeded so runs are comparable
+    :param repeats: Passes over the corpus per configuration, the first pass warms the caches
+    :param wrong_prior: Distance of the wrong priors from the truth in pixels, 0 skips the false accept pass
+    :return: The report as a dictionary
+    """
+    corpus_dir = Path(corpus_dir)
+    map_path = Path(map_path) if map_path else find_base_map(corpus_dir)
+    frames = read_ground_truth(corpus_dir)
+    if prior_error > 0:
+        rng = np.random.default_rng(seed)
+        frames = [(path, truth, tuple(np.add(prior, rng.normal(0, prior_error, 2))))
+                  for path, truth, prior in frames]
+    img_src = load_base_map(str(map_path))
+    misled = wrong_priors(frames, wrong_prior, seed) if wrong_prior > 0 else []
+
+    results = []
+    for parameters, match, clear in configurations(matcher, img_src, map_path, windows, steps, counts, radii):
+        run = None
+        for _ in range(max(1, repeats)):
+            run = run_config(frames, match, clear if cold else None)
+        run = {**parameters, **run}
+        if misled:
+            wrong = run_config(misled, match, clear if cold else None)
+            run['wrong_prior'] = {'false_accept_rate': wrong['false_accept_rate'],
+                                  'mean_confidence': wrong['mean_confidence'], 'stages': wrong['stages']}
+        results.append(run)
+
+    return {
+        'corpus': str(corpus_dir),
+        'map': str(map_path),
+        'matcher': matcher,
+        'frames': len(frames),
+        'prior_error_px': prior_error,
+        'failure_distance_px': FAILURE_DISTANCE,
+        'accept_confidence': ACCEPT_CONFIDENCE,
+        'wrong_prior_px': wrong_prior,
+        'cold': cold,
+        'configs': results,
+    }
+
+
+def main(argv=None):
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('corpus', help='Folder of flight images with a ground_truth.csv')
+    parser.add_argument('--map', help='Base map, defaults to basemap.* in the corpus folder')
+    parser.add_argument('--matcher', choices=MATCHERS, default='phase', help='Matching path benchmarked')
+    parser.add_argument('--windows', type=int, nargs='+', default=[450], help='Search window sides in pixels')
+    parser.add_argument('--steps', type=int, nargs='+', default=[50], help='Search grid steps in pixels')
+    parser.add_argument('--counts', type=int, nargs='+', default=[3], help='Top-k candidates averaged')
+    parser.add_argument('--radii', type=int, nargs='+', default=[1000], help='Pyramid search radii in pixels')
+    parser.add_argument('--wrong-prior', type=float, default=600.0,
+                        help='Distance of the priors of the false accept pass from the truth, 0 skips it')
+    parser.add_argument('--prior-error', type=float, default=0.0, help='Prior noise in pixels')
+    parser.add_argument('--repeats', type=int, default=2, help='Passes per configuration, the last is reported')
+    parser.add_argument('--cold', action='store_true', help='No base map spectra reused between matches')
+    parser.add_argument('--seed', type=int, default=1)
+    parser.add_argument('--output', help='JSON report path, printed when not given')
+    args = parser.parse_args(argv)
+
+    report = benchmark(args.corpus, args.map, args.windows, args.steps, args.counts,
+                       args.prior_error, args.repeats, args.cold, args.seed, args.matcher, args.radii,
+                       args.wrong_prior)
+    text = json.dumps(report, indent=2)
+    if args.output:
+        Path(args.output).write_text(text)
+        for run in report['configs']:
+            config = ' '.join(f'{key} {run[key]}' for key in ('window', 'step', 'count', 'radius') if key in run)
+            false_accepts = run['wrong_prior']['false_accept_rate'] if 'wrong_prior' in run else 0.0
+            print(f"{args.matcher} {config}: "
+                  f"{run['matches_per_second']:.1f} matches/s, p95 {run['latency_ms']['p95']:.1f} ms, "
+                  f"rms {run['rms_error_px']} px, failures {run['failure_rate']:.0%}, "
+                  f"false accepts {false_accepts:.0%}")
+    else:
+        print(text)
+
+
+if __name__ == '__main__':
+    main()
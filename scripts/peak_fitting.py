@@ -0,0 +1,38 @@
+"""
+Sub-pixel peak fitting of correlation surfaces.
+
+The fits are those of src/utility/PeakFitting.hpp, from the rt3d_peak module the application embeds and the build
+ also makes as an extension module, so the scripts and the C++ correlators locate their peaks the same way.
+"""
+import rt3d_peak as _native
+
+# Methods, as peak::Method
+PARABOLIC = 0
+GAUSSIAN = 1
+LEAST_SQUARES = 2
+ROBUST = 3
+
+
+def fit(surface, x, y, method=GAUSSIAN):
+    """
+    :param surface: 2D correlation surface
+    :param x: Column of the peak sample
+    :param y: Row of the peak sample
+    :return: x, y and value of the sub-pixel peak
+    """
+    return _native.fit(surface, int(x), int(y), method)
+
+
+def locate(surface, method=GAUSSIAN):
+    """
+    :return: x, y and value of the sub-pixel maximum of the surface
+    """
+    return _native.locate(surface, method)
+
+
+def locate_all(windows, method=GAUSSIAN):
+    """
+    :param windows: count x height x width array of surfaces
+    :return: count x 3 array of the (x, y, value) maxima
+    """
+    return _native.locate_all(windows, method)
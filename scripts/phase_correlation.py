@@ -1,30 +1,47 @@
+from functools import lru_cache
+
 import numpy as np
 from numpy.fft import fft2, fftshift, ifft2, ifftshift
 
+from .peak_fitting import GAUSSIAN, fit
 
-def phase_correlation(img_tmp, img_src, n_current_x, n_current_y, temp_size):
-    A = img_tmp[:temp_size, :temp_size].astype(np.double)
-    B = img_src[:temp_size, :temp_size].astype(np.double)
 
+@lru_cache(maxsize=8)
+def hamming_window(temp_size):
     f = np.hamming(temp_size).reshape(-1, 1)
-    f = f * f.conj().T
+    return f * f.conj().T
+
+
+def windowed_spectrum(img, temp_size):
+    """Hamming windowed, centred spectrum of the top left temp_size block of img."""
+    A = img[:temp_size, :temp_size].astype(np.double)
+    return fftshift(fft2(hamming_window(temp_size) * A))
 
-    a = fftshift(fft2(f * A))
-    b = fftshift(fft2(f * B))
 
-    m, temp_size = a.shape
+def phase_correlation_spectra(a, b, n_current_x, n_current_y, temp_size):
+    """
+    Phase correlation of two precomputed windowed spectra, see windowed_spectrum.
+    """
     s = np.abs(a * np.conj(b))
     s[s == 0] = 1
 
     c = (a * np.conj(b)) / s
 
-    invertfft_c = np.real_if_close(ifftshift(ifft2(c)))
+    invertfft_c = np.real(ifftshift(ifft2(c)))
     m, i = np.max(invertfft_c, 0), np.argmax(invertfft_c, 0)
     n, j = np.max(m, 0), np.argmax(m, 0)
-    x_shift = j - temp_size / 2
-    y_shift = i[j] - temp_size / 2
+    peak_x, peak_y, _ = fit(invertfft_c, j, i[j], GAUSSIAN)
+    x_shift = peak_x - temp_size / 2
+    y_shift = peak_y - temp_size / 2
 
     nx_pos = n_current_x - x_shift
     ny_pos = n_current_y - y_shift
 
     return nx_pos, ny_pos, n
+
+
+def phase_correlation(img_tmp, img_src, n_current_x, n_current_y, temp_size):
+    a = windowed_spectrum(img_tmp, temp_size)
+    b = windowed_spectrum(img_src, temp_size)
+
+    return phase_correlation_spectra(a, b, n_current_x, n_current_y, temp_size)
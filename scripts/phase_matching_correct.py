@@ -1,5 +1,6 @@
 import numpy as np
-from .phase_correlation import phase_correlation
+from .phase_correlation import windowed_spectrum, phase_correlation_spectra
+from .tile_bank import snap
 
 
 # def crop(arr, height, width):
@@ -13,7 +14,9 @@ def phase_matching_correct(img_tmp, img_src,
                            n_current_x,
                            n_current_y,
                            count=3,
-                           n_xstep=50):
+                           n_xstep=50,
+                           bank=None,
+                           window=450):
     """
 
     :param img_tmp: The current flight image
@@ -22,10 +25,12 @@ def phase_matching_correct(img_tmp, img_src,
     :param n_current_y:
     :param count:
     :param n_xstep:
-    :return:
+    :param bank: Optional TileBank of img_src, the search window is snapped to its grid and block spectra are reused
+    :param window: Side of the square search window in base map pixels, at least temp_size + n_xstep
+    :return: x, y and the mean correlation peak of the selected candidates, from 0 (no match) to 1
     """
-    height = 450
-    width = 450
+    height = window
+    width = window
     temp_size = 300
 
     h1, w1 = img_tmp.shape
@@ -34,41 +39,43 @@ def phase_matching_correct(img_tmp, img_src,
     s2 = round(h1 / 2 + temp_size / 2)
     s3 = round(w1 / 2 - temp_size / 2)
     s4 = round(w1 / 2 + temp_size / 2)
-    img_tmp = img_tmp[s1:s2, s3:s4]
+    a = windowed_spectrum(img_tmp[s1:s2, s3:s4], temp_size)  # only transformed once per match
 
-    s1 = round(n_current_y - height / 2)
-    s2 = round(n_current_y + height / 2)
-    s3 = round(n_current_x - width / 2)
-    s4 = round(n_current_x + width / 2)
-    clip_img = img_src[s1:s2, s3:s4]  # extracted clip image from base map
+    if bank is not None:
+        bank.reserve(window, n_xstep)
+        x0 = snap(n_current_x - width / 2, n_xstep)
+        y0 = snap(n_current_y - height / 2, n_xstep)
+    else:
+        x0 = round(n_current_x - width / 2)
+        y0 = round(n_current_y - height / 2)
 
     n_ystep = n_xstep
     n_xcount = int(np.floor((width - temp_size) / n_xstep))
     n_ycount = int(np.floor((height - temp_size) / n_ystep))
 
-    n_total_count = n_xcount * n_ycount
-    phase_pos = np.zeros((n_total_count, 3))
-    run = 0
+    phase_pos = []
 
-    for m in range(0, n_ycount * n_xcount, n_xstep):
+    for m in range(0, n_xcount * n_xstep, n_xstep):
         for n in range(0, n_ycount * n_ystep, n_ystep):
+            if bank is not None:
+                b = bank.spectrum(x0 + m, y0 + n)
+            else:
+                search_img = img_src[max(y0 + n, 0):y0 + n + temp_size, max(x0 + m, 0):x0 + m + temp_size]
+                b = windowed_spectrum(search_img, temp_size) if search_img.shape == (temp_size, temp_size) else None
+            if b is None:
+                continue  # block falls outside the base map
+
             nx_frm = int(m + temp_size / 2)
             ny_frm = int(n + temp_size / 2)
 
-            s1 = round(ny_frm - temp_size / 2)
-            s2 = round(ny_frm + temp_size / 2)
-            s3 = round(nx_frm - temp_size / 2)
-            s4 = round(nx_frm + temp_size / 2)
-            search_img = clip_img[s1:s2, s3:s4]
-
-            nx_pos, ny_pos, n = phase_correlation(img_tmp, search_img, nx_frm, ny_frm, temp_size)
+            nx_pos, ny_pos, peak = phase_correlation_spectra(a, b, nx_frm, ny_frm, temp_size)
 
-            nx_pos = nx_pos + n_current_x - width / 2
-            ny_pos = ny_pos + n_current_y - height / 2
+            phase_pos.append([nx_pos + x0, ny_pos + y0, peak])
 
-            phase_pos[run, :] = np.array([nx_pos, ny_pos, n])
-            run += 1
+    if not phase_pos:
+        return int(n_current_x), int(n_current_y), 0.0
 
+    phase_pos = np.array(phase_pos)
     n_sort = phase_pos[:, 2]
     i = np.argsort(-n_sort)
     i_max = i[:count]
@@ -77,5 +84,6 @@ def phase_matching_correct(img_tmp, img_src,
 
     nx_pos = np.mean(new_pos_x)
     ny_pos = np.mean(new_pos_y)
+    peak = np.mean(phase_pos[i_max, 2])
 
-    return int(nx_pos), int(ny_pos)
+    return int(round(nx_pos)), int(round(ny_pos)), float(peak)
@@ -0,0 +1,117 @@
+import threading
+
+import cv2 as cv
+import numpy as np
+from numpy.fft import fft2, ifft2
+
+from .peak_fitting import GAUSSIAN, fit
+from .phase_correlation import hamming_window
+from .phase_matching_correct import phase_matching_correct
+from .tile_bank import bank_for, _map_key
+
+# Coarsest template side in pixels, below this the phase correlation peak is unreliable
+MIN_TEMPLATE = 64
+
+_pyramids = {}
+_pyramids_lock = threading.Lock()
+
+
+def pyramid_for(map_image_path: str, levels: int):
+    """
+    Gaussian pyramid of the greyscale base map, level 0 is full resolution.
+    Built once per base map and extended when more levels are requested.
+    """
+    path, mtime = _map_key(map_image_path)
+    # the localisation workers call this at once and pyrDown releases the GIL, unguarded two could both extend
+    #  the list and level k would no longer be scale 2^-k
+    with _pyramids_lock:
+        pyramid = _pyramids.get(path)
+        if pyramid is None or pyramid[0] != mtime:
+            pyramid = (mtime, [bank_for(path).img_src])
+            _pyramids[path] = pyramid
+        levels_ = pyramid[1]
+        while len(levels_) <= levels:
+            levels_.append(cv.pyrDown(levels_[-1]))
+        return levels_
+
+
+def pyramid_level(radius_px, temp_size=300):
+    """
+    Finest level where the scaled radius fits the search budget of one template side,
+     coarser only while the template stays at least MIN_TEMPLATE.
+    """
+    level = 0
+    while (temp_size >> (level + 1)) >= MIN_TEMPLATE and (radius_px >> level) > temp_size:
+        level += 1
+    return level
+
+
+def padded_phase_correlation(template, region):
+    """
+    Phase only correlation of a template against a larger region in a single FFT.
+
+    :return: Sub-pixel offset (x, y) of the template's top left corner in the region, and the peak value
+    """
+    rh, rw = region.shape
+    th, tw = template.shape
+    t = np.zeros((rh, rw))
+    t[:th, :tw] = hamming_window(th) * (template - template.mean())
+    r = region - region.mean()
+
+    cross = fft2(r) * np.conj(fft2(t))
+    s = np.abs(cross)
+    s[s == 0] = 1
+    c = np.real(ifft2(cross / s))
+
+    # only offsets that keep the template inside the region are valid
+    c = c[:rh - th + 1, :rw - tw + 1]
+    y, x = np.unravel_index(np.argmax(c), c.shape)
+    # sub-pixel at the coarse level is several pixels at full resolution
+    fx, fy, _ = fit(c, x, y, GAUSSIAN)
+    return fx, fy, c[y, x]
+
+
+def coarse_to_fine(img_tmp, map_image_path, n_current_x, n_current_y, radius_px, count=3, n_xstep=50):
+    """
+    Locates the flight image within radius_px of the prior position by a coarse phase correlation on the base map
+     pyramid, followed by the full resolution phase matcher around the coarse estimate.
+
+    :param img_tmp: The current flight image, greyscale array
+    :param map_image_path: The reference image (base map)
+    :param n_current_x: Prior position
+    :param n_current_y: Prior position
+    :param radius_px: Search radius around the prior in base map pixels
+    :return: x, y, confidence
+    """
+    temp_size = 300
+    bank = bank_for(map_image_path)
+    level = pyramid_level(int(radius_px), temp_size)
+    pyramid = pyramid_for(map_image_path, level)
+    base = pyramid[level]
+    scale = 2 ** level
+
+    h1, w1 = img_tmp.shape
+    s1 = round(h1 / 2 - temp_size / 2)
+    s3 = round(w1 / 2 - temp_size / 2)
+    template = img_tmp[s1:s1 + temp_size, s3:s3 + temp_size]
+    for _ in range(level):
+        template = cv.pyrDown(template)
+    t_size = template.shape[0]
+
+    # coarse region covering the radius around the prior
+    half = int(np.ceil(radius_px / scale)) + t_size // 2
+    cx = int(round(n_current_x / scale))
+    cy = int(round(n_current_y / scale))
+    bh, bw = base.shape
+    x0, x1 = max(cx - half, 0), min(cx + half, bw)
+    y0, y1 = max(cy - half, 0), min(cy + half, bh)
+    region = base[y0:y1, x0:x1].astype(np.double)
+    if region.shape[0] < t_size or region.shape[1] < t_size:
+        return int(n_current_x), int(n_current_y), 0.0
+
+    dx, dy, _ = padded_phase_correlation(template.astype(np.double), region)
+    coarse_x = (x0 + dx + t_size / 2) * scale
+    coarse_y = (y0 + dy + t_size / 2) * scale
+
+    # refine at full resolution, the coarse estimate is good to a few coarse pixels
+    return phase_matching_correct(img_tmp, bank.img_src, coarse_x, coarse_y, count, n_xstep, bank)
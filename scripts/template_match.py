@@ -1,67 +1,80 @@
-import numpy as np
-
+"""
+Dense normalised cross-correlation of the flight image centre against the base map search window.
 
-def template_match(img_tmp, img_src, n_current_x, n_current_y, thresh):
-    win_y, win_x, n_count = np.atleast_3d(np.asarray(img_tmp)).shape
-
-    height = 450
-    width = 450
+Every template position is scored, the numerators of all positions come from one FFT correlation and the local
+ means and variances of the base map from its integral images, so the cost is near that of one phase correlation.
+"""
+import cv2 as cv
+import numpy as np
+from numpy.fft import irfft2, rfft2
+
+from .peak_fitting import ROBUST, fit
+
+# Positions whose base map block is this flat are not scored, their NCC is noise
+MIN_VARIANCE = 1e-3
+
+
+def ncc_surface(template, region):
+    """
+    :param template: th x tw array
+    :param region: Array at least the template size
+    :return: NCC of the template at every offset of its top left corner in the region,
+     (rh - th + 1) x (rw - tw + 1) in -1 to 1
+    """
+    th, tw = template.shape
+    rh, rw = region.shape
+    t = template.astype(np.double)
+    t = t - t.mean()
+    t_norm = np.sqrt(np.sum(t * t))
+    r = region.astype(np.double)
+
+    # numerator: correlation of the zero mean template, the block mean term vanishes as t sums to 0
+    fh, fw = cv.getOptimalDFTSize(rh), cv.getOptimalDFTSize(rw)
+    cross = irfft2(rfft2(r, (fh, fw)) * np.conj(rfft2(t, (fh, fw))), (fh, fw))
+    numerator = cross[:rh - th + 1, :rw - tw + 1]
+
+    # block sums and sums of squares from the integral images, four lookups per position
+    s, sq = cv.integral2(r, sdepth=cv.CV_64F, sqdepth=cv.CV_64F)
+    n = th * tw
+    block_sum = s[th:, tw:] - s[:-th, tw:] - s[th:, :-tw] + s[:-th, :-tw]
+    block_sq = sq[th:, tw:] - sq[:-th, tw:] - sq[th:, :-tw] + sq[:-th, :-tw]
+    variance = np.maximum(block_sq - block_sum * block_sum / n, 0)
+
+    surface = np.zeros_like(numerator)
+    valid = variance > MIN_VARIANCE * n
+    surface[valid] = numerator[valid] / (np.sqrt(variance[valid]) * max(t_norm, 1e-12))
+    return surface
+
+
+def template_match(img_tmp, img_src, n_current_x, n_current_y, window=450):
+    """
+    Drop in alternative to phase_matching_correct, searching every position of the window.
+
+    :param img_tmp: The current flight image, greyscale array
+    :param img_src: The reference image (base map), greyscale array
+    :param window: Side of the square search window in base map pixels, at least temp_size
+    :return: x, y and the NCC of the best position, from 0 (no match) to 1
+    """
     temp_size = 300
 
-    # rgb to grayscale
-    img_src = img_src.convert('L')
-
-    img_tmp = np.array(img_tmp)
-    img_src = np.array(img_src)
-
-    # input image
-    s1 = int(win_y / 2 - temp_size / 2)
-    s2 = int(win_y / 2 + temp_size / 2)
-    s3 = int(win_x / 2 - temp_size / 2)
-    s4 = int(win_x / 2 + temp_size / 2)
-    img_tmp = img_tmp[s1:s2, s3:s4]
-
-    s1 = int(n_current_y - height / 2)
-    s2 = int(n_current_y + height / 2)
-    s3 = int(n_current_x - width / 2)
-    s4 = int(n_current_x + width / 2)
-    clip_img = img_src[s1:s2, s3:s4]
-
-    # the grid per step
-    nx_step = 50
-    ny_step = 50
-
-    # total count in x direction and y direction of this loop
-    nx_count = (width - temp_size) // nx_step
-    ny_count = (height - temp_size) // ny_step
-
-    n_total_count = nx_count * ny_count
-
-    n_run = 1  # current run
-
-    # ---
-    p = np.zeros((nx_count * ny_count))
-    pos = np.zeros((nx_count * ny_count, 4))
-    for m in range(0, nx_count * nx_step, nx_step):
-        for n in range(0, ny_count * ny_step, ny_step):
-            nx_frm = m + 1
-            ny_frm = n + 1
-            nx_to = nx_frm + temp_size - 1
-            ny_to = ny_frm + temp_size - 1
-            block_img = clip_img[ny_frm:ny_to, nx_frm:nx_to]
-
-            # correlation coefficient
-            cf = np.corrcoef(img_tmp.ravel(), block_img.ravel())
-            p[n_run - 1] = cf[0, 1]
-            pos[n_run - 1, :] = np.array([nx_frm, ny_frm, temp_size, temp_size])
-            n_run += 1
-
-    pmax, n = np.max(p), np.flip(np.argmax(p))
-    win = pos[n, :]
-    nx_frm = win[0]
-    ny_frm = win[1]
-
-    nx_pos = nx_frm + temp_size * 0.5 + n_current_x - width / 2
-    ny_pos = ny_frm + temp_size * 0.5 + n_current_y - height / 2
-
-    return nx_pos, ny_pos
+    h1, w1 = img_tmp.shape
+    s1 = round(h1 / 2 - temp_size / 2)
+    s3 = round(w1 / 2 - temp_size / 2)
+    template = img_tmp[s1:s1 + temp_size, s3:s3 + temp_size]
+
+    bh, bw = img_src.shape
+    x0 = max(round(n_current_x - window / 2), 0)
+    y0 = max(round(n_current_y - window / 2), 0)
+    region = img_src[y0:min(y0 + window, bh), x0:min(x0 + window, bw)]
+    if region.shape[0] < temp_size or region.shape[1] < temp_size or template.shape != (temp_size, temp_size):
+        return int(n_current_x), int(n_current_y), 0.0
+
+    surface = ncc_surface(template, region)
+    y, x = np.unravel_index(np.argmax(surface), surface.shape)
+    peak = float(surface[y, x])
+    # the NCC peak is broad and smooth, the robust 2D fit is the most precise of the fits on it
+    fx, fy, _ = fit(surface, x, y, ROBUST)
+
+    nx_pos = x0 + fx + temp_size / 2
+    ny_pos = y0 + fy + temp_size / 2
+    return nx_pos, ny_pos, max(peak, 0.0)
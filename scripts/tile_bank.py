@@ -0,0 +1,163 @@
+import os
+import threading
+from collections import OrderedDict
+
+import numpy as np
+from PIL import Image
+
+from .phase_correlation import windowed_spectrum
+
+# Spectra are stored as complex64, a 300x300 block is ~0.7MB.
+MAX_BLOCKS = 256
+# Search windows whose blocks the bank keeps, consecutive frames mostly revisit the previous window's blocks
+WINDOWS_CACHED = 4
+# Upper bound of the cache, the largest tracker window alone visits 576 blocks
+MAX_CACHE_BYTES = 1 << 30
+
+_base_maps = {}
+# Held while a base map decodes, so concurrent first calls decode it once. Not _banks_lock, bank_for holds that
+_base_maps_lock = threading.Lock()
+_banks = {}
+_banks_lock = threading.Lock()
+
+
+def _map_key(map_image_path: str):
+    path = os.path.abspath(map_image_path)
+    return path, os.path.getmtime(path)
+
+
+def load_base_map(map_image_path: str):
+    """
+    Loads the base map as a greyscale array, reusing the previous load while the file is unchanged.
+    """
+    key = _map_key(map_image_path)
+    with _base_maps_lock:
+        img_src = _base_maps.get(key[0])
+        if img_src is None or img_src[0] != key[1]:
+            img_src = (key[1], np.array(Image.open(key[0]).convert('L')))
+            _base_maps[key[0]] = img_src
+    return img_src[1]
+
+
+def snap(value, n_xstep):
+    """Snaps a block origin to the search grid so neighbouring matches share blocks."""
+    return int(round(value / n_xstep) * n_xstep)
+
+
+def blocks_per_window(window, temp_size=300, n_xstep=50):
+    """Number of blocks phase_matching_correct visits in a square search window."""
+    return int(np.floor((window - temp_size) / n_xstep)) ** 2
+
+
+class TileBank:
+    """
+    Lazily filled cache of Hamming windowed base map block spectra, keyed by block origin.
+    Shared by the corridor prebuild and the localisation workers, the caches are only touched under the lock and
+     the spectra are computed outside it, as numpy releases the GIL while it transforms.
+    """
+
+    def __init__(self, img_src, temp_size=300, max_blocks=MAX_BLOCKS):
+        self.img_src = img_src
+        self.temp_size = temp_size
+        self.max_blocks = max_blocks
+        self.blocks = OrderedDict()
+        self.log_polars = OrderedDict()
+        self.lock = threading.Lock()
+
+    def reserve(self, window, n_xstep=50, windows=WINDOWS_CACHED):
+        """Grows the cache to hold the blocks of the last windows search windows, within MAX_CACHE_BYTES."""
+        budget = MAX_CACHE_BYTES // (self.temp_size * self.temp_size * np.dtype(np.complex64).itemsize)
+        wanted = min(windows * blocks_per_window(window, self.temp_size, n_xstep), budget)
+        with self.lock:
+            self.max_blocks = max(self.max_blocks, wanted)
+
+    def _get(self, cache, key):
+        with self.lock:
+            value = cache.get(key)
+            if value is not None:
+                cache.move_to_end(key)
+            return value
+
+    def _put(self, cache, key, value):
+        with self.lock:
+            cache[key] = value
+            cache.move_to_end(key)
+            while len(cache) > self.max_blocks:
+                cache.popitem(last=False)
+        return value
+
+    def spectrum(self, x0: int, y0: int):
+        """
+        :return: The windowed spectrum of the block with top left corner (x0, y0),
+         or None if the block is not fully inside the base map.
+        """
+        key = (x0, y0)
+        b = self._get(self.blocks, key)
+        if b is not None:
+            return b
+
+        h, w = self.img_src.shape
+        if x0 < 0 or y0 < 0 or x0 + self.temp_size > w or y0 + self.temp_size > h:
+            return None
+
+        block = self.img_src[y0:y0 + self.temp_size, x0:x0 + self.temp_size]
+        return self._put(self.blocks, key, windowed_spectrum(block, self.temp_size).astype(np.complex64))
+
+    def log_polar(self, x0: int, y0: int):
+        """
+        :return: The log-polar magnitude of the block spectrum, see fourier_mellin, or None outside the base map
+        """
+        key = (x0, y0)
+        lp = self._get(self.log_polars, key)
+        if lp is not None:
+            return lp
+
+        b = self.spectrum(x0, y0)
+        if b is None:
+            return None
+        from .fourier_mellin import log_polar_magnitude  # fourier_mellin imports this module
+        return self._put(self.log_polars, key, log_polar_magnitude(b))
+
+    def cached(self):
+        """Number of cached block spectra."""
+        with self.lock:
+            return len(self.blocks)
+
+    def prebuild(self, x, y, height=450, width=450, n_xstep=50):
+        """Computes every block that a search window centred on (x, y) would visit."""
+        x0 = snap(x - width / 2, n_xstep)
+        y0 = snap(y - height / 2, n_xstep)
+        n_xcount = int(np.floor((width - self.temp_size) / n_xstep))
+        n_ycount = int(np.floor((height - self.temp_size) / n_xstep))
+        for m in range(n_xcount):
+            for n in range(n_ycount):
+                self.spectrum(x0 + m * n_xstep, y0 + n * n_xstep)
+
+
+def bank_for(map_image_path: str, temp_size=300):
+    """
+    :return: The tile bank for the base map, a new one is created if the base map file has changed.
+    """
+    path, mtime = _map_key(map_image_path)
+    with _banks_lock:
+        bank = _banks.get((path, temp_size))
+        if bank is None or bank[0] != mtime:
+            bank = (mtime, TileBank(load_base_map(path), temp_size))
+            _banks[(path, temp_size)] = bank
+    return bank[1]
+
+
+def prebuild_corridor(map_image_path: str, points, height=450, width=450, n_xstep=50):
+    """
+    Fills the tile bank along the planned flight path, so the first match at each waypoint
+     only needs the flight image spectrum.
+
+    :param map_image_path: The base map
+    :param points: Sequence of (x, y) waypoint positions in base map pixels
+    :return: Number of cached blocks
+    """
+    bank = bank_for(map_image_path)
+    bank.reserve(max(height, width), n_xstep, len(points))
+    for x, y in points:
+        bank.prebuild(x, y, height, width, n_xstep)
+    return bank.cached()
@@ -8,6 +8,8 @@
 #include "../settings/path_settings/pathsettings.h"
 #include "../settings/dem_behaviour/dembehaviour.h"
 #include "../utility/pyscriptcaller.h"
+#include "../utility/pythonruntime.h"
+#include "../settings/geometric_settings/geometricsettings.h"
 #include <QDir>
 #include <QTimer>
 #include <QJsonObject>
@@ -42,9 +44,14 @@ DemGeneration::DemGeneration(QWidget *parent, QFileSystemModel *parent_fsModel)
         imageWidth(0), imageHeight(0), imagePairsCount(0),
         scriptLauncher(new ScriptLauncher(this)),
         imageCutter(new ImageCutter(this)),
-        completer(new QCompleter(this)) {
+        completer(new QCompleter(this)),
+        lensCorrector(nullptr) {
     ui->setupUi(this);
     ui->stopBtn->setDisabled(true);
+    // enabled once a corrector is given
+    ui->lensCorrectChkBox->setDisabled(true);
+    // a pair registered here is not registered again by the exe
+    connect(ui->preRegisterChkBox, &QCheckBox::toggled, ui->frameRegChkBox, &QCheckBox::setDisabled);
 
     ui->frameRate->setDisabled(true);
 
@@ -89,6 +96,12 @@ DemGeneration::~DemGeneration() {
     delete ui;
 }
 
+void DemGeneration::setLensCorrection(LensCorrector *corrector, std::function<bool(LensParameters &)> parameters) {
+    lensCorrector = corrector;
+    lensParametersOf = std::move(parameters);
+    ui->lensCorrectChkBox->setEnabled(lensCorrector != nullptr);
+}
+
 void DemGeneration::setInputPath(const QString &path) {
     QFileInfo info(path);
     setIOPath(ui->inputPathLineEdit, info);
@@ -148,6 +161,13 @@ void DemGeneration::setIOPath(QLineEdit *pathField, const QFileInfo &info) {
 }
 
 void DemGeneration::launchFrameShiftView() {
+    // the first frames are extracted by the scripts
+    if (formatMode == FormatMode::VIDEO and not PythonRuntime::instance()->isReady()) {
+        qInfo() << "Frame shift view opens once Python has started.";
+        PythonRuntime::instance()->whenReady(this, [this]() { launchFrameShiftView(); });
+        return;
+    }
+
     if (frameShiftModule != nullptr) frameShiftModule->deleteLater();
 
     if (imageHeight != 0 and imageWidth != 0)
@@ -323,8 +343,11 @@ QStringList DemGeneration::getStdOpts() {
 }
 
 QStringList DemGeneration::getExtraOpts() {
+    // a pair that could not be pre-registered is registered by the DEM generation instead
+    auto frameRegistration = ui->preRegisterChkBox->isChecked() ? not imageCutter->pairRegistered
+                                                                : ui->frameRegChkBox->isChecked();
     return {
-            QString("frameRegistration=%1").arg((int) ui->frameRegChkBox->isChecked()),
+            QString("frameRegistration=%1").arg((int) frameRegistration),
             QString("robustRegistration=%1").arg((int) ui->robustRegiChkBox->isChecked()),
             QString("removeBorder=%1").arg((int) ui->rmBorderChkBox->isChecked())
     };
@@ -443,6 +466,26 @@ void DemGeneration::runClicked() {
     resetOperation();
     checkIfVideo();
 
+    // video frames are extracted by the scripts, the run starts once they are imported
+    if (formatMode == FormatMode::VIDEO and not PythonRuntime::instance()->isReady()) {
+        qInfo() << "Run starts once Python has started.";
+        ui->runBtn->setDisabled(true);
+        PythonRuntime::instance()->whenReady(this, [this]() {
+            ui->runBtn->setDisabled(false);
+            runClicked();
+        });
+        return;
+    }
+
+    // asked once per run, the pairs of a folder or camera arrive long after
+    runLensParameters.reset();
+    if (ui->lensCorrectChkBox->isChecked()) {
+        LensParameters parameters;
+        if (not lensCorrector or not lensParametersOf or not lensParametersOf(parameters))
+            return;
+        runLensParameters = parameters;
+    }
+
     bool ok;
     switch (formatMode) {
         case FormatMode::FILES:
@@ -587,8 +630,14 @@ void DemGeneration::processImagePair(const QString &refImage, const QString &sec
     // the input image can be from any input directory because of this
     imageCutter->xShift = ui->xShift->value();
     imageCutter->yShift = ui->yShift->value();
-    auto[refPath_cropped, secondaryPath_cropped] = imageCutter->imageCut(refImage, secondaryImage,
-                                                                         imagePairsCount, imagePairsCount + 1);
+    imageCutter->normalisation = static_cast<RadiometricNormaliser::Method>(ui->normalisationCmbo->currentIndex());
+    imageCutter->registerPair = ui->preRegisterChkBox->isChecked();
+    auto[refPath_cropped, secondaryPath_cropped] = runLensParameters or imageCutter->registerPair
+            ? imageCutter->correctedCut(refImage, secondaryImage, imagePairsCount, imagePairsCount + 1,
+                                        runLensParameters ? lensCorrector : nullptr,
+                                        runLensParameters.value_or(LensParameters()),
+                                        GeometricSettings::getInterMethod())
+            : imageCutter->imageCut(refImage, secondaryImage, imagePairsCount, imagePairsCount + 1);
     if (refPath_cropped.empty()) {
         Messages::warning_msg(this, QString("Image file %1 could not be read").arg(refImage));
         return;
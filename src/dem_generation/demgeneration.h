@@ -12,6 +12,8 @@
 #include <QFileSystemModel>
 #include <QThread>
 #include <QProgressDialog>
+#include <functional>
+#include <optional>
 #include "../frame_shift_viewer/FrameShiftModule.h"
 #include "imagecutter.h"
 #include "../utility/scriptlauncher.h"
@@ -92,6 +94,9 @@ public:
 
     QPointer<FrameShiftModule> frameShiftModule;
 
+    /// Enables the lens correction option, parameters is asked for the lens settings when a run starts
+    void setLensCorrection(LensCorrector *corrector, std::function<bool(LensParameters &)> parameters);
+
 Q_SIGNALS:
 
     /// signal indicating the image width has changed
@@ -169,6 +174,10 @@ private:
     QPointer<WatchdogIndicatorWidget> chooseCamWidget;
     QPointer<QProgressDialog> pd;
     QCompleter *completer;
+    LensCorrector *lensCorrector;
+    std::function<bool(LensParameters &)> lensParametersOf;
+    /// settings of the current run, when its pairs are lens corrected
+    std::optional<LensParameters> runLensParameters;
     //    QPointer<VideoConverter> videoConverter;
 
 private Q_SLOTS:
@@ -4,9 +4,67 @@
 
 #include "imagecutter.h"
 #include "../utility/messages.hpp"
+#include "preregistration.h"
 #include <QImage>
-#include <QPainterPath>
-#include <QGraphicsObject>
+#include <QFile>
+#include <QtConcurrent>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/core.hpp>
+
+namespace {
+    /// EXIF orientation of an image, as QImageReader's autoTransform applies it
+    QImageIOHandler::Transformations orientationOf(const QString &path) {
+        QImageReader reader(path);
+        return reader.canRead() ? reader.transformation() : QImageIOHandler::TransformationNone;
+    }
+
+    /// The image as QImageReader shows it with autoTransform, from the orientation it was taken in
+    cv::Mat oriented(const cv::Mat &image, QImageIOHandler::Transformations transformation) {
+        if (transformation == QImageIOHandler::TransformationNone)
+            return image;
+        cv::Mat result;
+        if (transformation == QImageIOHandler::TransformationRotate270) {
+            cv::rotate(image, result, cv::ROTATE_90_COUNTERCLOCKWISE);
+            return result;
+        }
+        // mirrored first, then turned, as qt_imageTransform does
+        auto mirror = transformation.testFlag(QImageIOHandler::TransformationMirror);
+        auto flip = transformation.testFlag(QImageIOHandler::TransformationFlip);
+        if (mirror or flip)
+            cv::flip(image, result, mirror and flip ? -1 : (mirror ? 1 : 0));
+        else
+            result = image;
+        if (transformation.testFlag(QImageIOHandler::TransformationRotate90))
+            cv::rotate(result, result, cv::ROTATE_90_CLOCKWISE);
+        return result;
+    }
+
+    /// Largest upright rectangle of nonzero pixels in a mask, from the row by row histogram of run heights
+    cv::Rect largestInscribedRect(const cv::Mat &mask) {
+        std::vector<int> heights(mask.cols + 1, 0);
+        std::vector<int> stack;
+        stack.reserve(mask.cols + 1);
+        cv::Rect best;
+        for (int y = 0; y < mask.rows; y++) {
+            auto row = mask.ptr<uchar>(y);
+            for (int x = 0; x < mask.cols; x++)
+                heights[x] = row[x] ? heights[x] + 1 : 0;
+            // the sentinel 0 at the end closes every open run
+            stack.clear();
+            for (int x = 0; x <= mask.cols; x++) {
+                while (not stack.empty() and heights[stack.back()] >= heights[x]) {
+                    auto height = heights[stack.back()];
+                    stack.pop_back();
+                    auto left = stack.empty() ? 0 : stack.back() + 1;
+                    if (height * (x - left) > best.area())
+                        best = cv::Rect(left, y - height + 1, x - left, height);
+                }
+                stack.push_back(x);
+            }
+        }
+        return best;
+    }
+}
 
 void ImageCutter::setOutPrefix(const QString &prefix) {
     outPrefix = prefix;
@@ -37,32 +95,51 @@ ImageCutter::imageCut(const QString &refImagePath, const QString &secImagePath,
     QImage refImage = reader1.read();
     QImage secImage = reader2.read();
 
-    int newWidth, newHeight;
-    newWidth = refImage.width() - abs(xShift);
-    newHeight = refImage.height() - abs(yShift);
-    if (newWidth < 0 || newHeight < 0)
+    auto[newRefRect, newSecRect] = overlap(refImage.size(), secImage.size(), xShift, yShift);
+    if (newRefRect.isEmpty()) {
         Messages::warning_msg(nullptr, tr("The frame shift you entered is too large!"));
+        return std::tuple("", "");
+    }
 
-    auto rectRef = refImage.rect();
-    auto rectRefObj = scene.addRect(rectRef);
+    auto[refTmpPath, refOutPath, tarTmpPath, tarOutPath] = cropPaths(i, j);
 
-    auto rectSec = secImage.rect();
-    auto rectSecObj = scene.addRect(rectSec);
+    QImage copyRefImage = refImage.copy(newRefRect);
+    QImage copySecImage = secImage.copy(newSecRect);
+    if (normalisation != RadiometricNormaliser::None) {
+        // both crops in one 8 bit format, wrapped without copying
+        auto format = copyRefImage.allGray() and copySecImage.allGray() ? QImage::Format_Grayscale8
+                                                                        : QImage::Format_RGB888;
+        copyRefImage = copyRefImage.convertToFormat(format);
+        copySecImage = copySecImage.convertToFormat(format);
+        auto type = format == QImage::Format_Grayscale8 ? CV_8UC1 : CV_8UC3;
+        cv::Mat refPixels(copyRefImage.height(), copyRefImage.width(), type,
+                          copyRefImage.bits(), size_t(copyRefImage.bytesPerLine()));
+        cv::Mat secPixels(copySecImage.height(), copySecImage.width(), type,
+                          copySecImage.bits(), size_t(copySecImage.bytesPerLine()));
+        RadiometricNormaliser::normalise(secPixels, refPixels, normalisation);
+    }
 
-    rectSec.translate(xShift, yShift);
-    rectSecObj->moveBy(xShift, yShift);
+    copyRefImage.save(QString::fromStdString(refTmpPath.string()));
+    if (outPath != refTmpPath)
+        copyRefImage.save(QString::fromStdString(refOutPath.string()));
+    cropImgList.append(refTmpPath);
 
-    auto newRefRect = rectRef.intersected(rectSec);
-    auto newRefRectObj = scene.addRect(newRefRect);
 
-    auto newSecRect = rectSec.intersected(rectRef);
-    auto newSecRectObj = scene.addRect(newSecRect);
+    copySecImage.save(QString::fromStdString(tarTmpPath.string()));
+    if (outPath != tarTmpPath)
+        copySecImage.save(QString::fromStdString(tarOutPath.string()));
+    cropImgList.append(tarTmpPath);
+
 
-    newRefRect = newRefRectObj->mapRectToItem(rectRefObj, newRefRectObj->rect()).toRect();
-    newSecRect = newSecRectObj->mapRectToItem(rectSecObj, newSecRectObj->rect()).toRect();
-    scene.clear();
+    return {refTmpPath, tarTmpPath};
+}
 
+std::tuple<QRect, QRect> ImageCutter::overlap(const QSize &refSize, const QSize &secSize, int xShift, int yShift) {
+    auto refRect = QRect(QPoint(0, 0), refSize).intersected(QRect(QPoint(xShift, yShift), secSize));
+    return {refRect, refRect.translated(-xShift, -yShift)};
+}
 
+std::tuple<fs::path, fs::path, fs::path, fs::path> ImageCutter::cropPaths(int i, int j) {
     fs::path refOutName{QString("%1_%2_%3_Reference").arg(outPrefix).arg(i).arg(j).toStdString()};
     refOutName.replace_extension(".jpg");
 
@@ -84,19 +161,119 @@ ImageCutter::imageCut(const QString &refImagePath, const QString &secImagePath,
     if (not QFileInfo::exists(QString::fromStdString(outPath.string())))
         QDir().mkpath(QString::fromStdString(outPath.string()));
 
-    QImage copyRefImage = refImage.copy(newRefRect);
-    copyRefImage.save(QString::fromStdString(refTmpPath.string()));
-    if (outPath != refTmpPath)
-        copyRefImage.save(QString::fromStdString(refOutPath.string()));
-    cropImgList.append(refTmpPath);
+    return {refTmpPath, refOutPath, tarTmpPath, tarOutPath};
+}
 
+std::tuple<fs::path, fs::path>
+ImageCutter::correctedCut(const QString &refImagePath, const QString &secImagePath, int i, int j,
+                          LensCorrector *corrector, const LensParameters &parameters, int interMethod) {
+    cropImaPath.make_preferred();
+    if (!cropDir.exists()) {
+        create_directories(cropImaPath);
+    }
 
-    QImage copySecImage = secImage.copy(newSecRect);
-    copySecImage.save(QString::fromStdString(tarTmpPath.string()));
-    if (outPath != tarTmpPath)
-        copySecImage.save(QString::fromStdString(tarOutPath.string()));
-    cropImgList.append(tarTmpPath);
+    // the secondary is decoded on another core while the reference is decoded here. Both are decoded in the
+    // orientation they were taken in, which the lens grid is for, and turned as imageCut shows them once corrected
+    auto secFuture = QtConcurrent::run([path = secImagePath.toStdString()]() {
+        return cv::imread(path, cv::IMREAD_GRAYSCALE | cv::IMREAD_IGNORE_ORIENTATION);
+    });
+    auto refImage = cv::imread(refImagePath.toStdString(), cv::IMREAD_GRAYSCALE | cv::IMREAD_IGNORE_ORIENTATION);
+    auto secImage = secFuture.result();
+    if (refImage.empty()) {
+        qWarning() << "Could not read image:" << refImagePath;
+        return std::tuple("", "");
+    }
+    if (secImage.empty()) {
+        qWarning() << "Could not read image:" << secImagePath;
+        return std::tuple("", "");
+    }
+
+    // images of one camera share a grid, so the pair costs at most one build
+    std::shared_ptr<const RemapLUT> refGrid, secGrid;
+    if (corrector) {
+        refGrid = corrector->lut(parameters, QSize(refImage.cols, refImage.rows));
+        secGrid = corrector->lut(parameters, QSize(secImage.cols, secImage.rows));
+        if (not refGrid or not secGrid) {
+            qWarning() << "No lens correction for" << parameters.lensModel;
+            return std::tuple("", "");
+        }
+    }
+    auto correct = [&](const cv::Mat &image, const std::shared_ptr<const RemapLUT> &grid, const cv::Rect &region) {
+        return grid ? LensCorrector::undistortRegion(image, *grid, region, interMethod) : image(region).clone();
+    };
+
+    auto refOrientation = orientationOf(refImagePath);
+    auto secOrientation = orientationOf(secImagePath);
+    auto upright = refOrientation == QImageIOHandler::TransformationNone
+                   and secOrientation == QImageIOHandler::TransformationNone;
+
+    // whole corrected images, when registering or when an image has to be turned, otherwise only the crops are made
+    cv::Mat refFull, secFull;
+    if (registerPair or not upright) {
+        auto secCorrected = QtConcurrent::run([&]() {
+            return oriented(correct(secImage, secGrid, cv::Rect(0, 0, secImage.cols, secImage.rows)), secOrientation);
+        });
+        refFull = oriented(correct(refImage, refGrid, cv::Rect(0, 0, refImage.cols, refImage.rows)), refOrientation);
+        secFull = secCorrected.result();
+    }
+
+    cv::Mat refCrop, secCrop;
+    pairRegistered = false;
+    if (registerPair) {
+        // registered on the corrected images, the lens moves points more than the estimate is off
+        auto registration = PreRegistration::estimate(refFull, secFull);
+        qInfo() << "Registration of pair" << i << j << registration;
+        if (registration.ok) {
+            cv::Mat valid;
+            auto warped = PreRegistration::warp(secFull, registration.transform, refFull.size(),
+                                                interMethod, &valid);
+            // only pixels the warped secondary covers, black corners would skew the correlation and the
+            // radiometric normalisation
+            auto region = largestInscribedRect(valid);
+            if (not region.empty()) {
+                refCrop = refFull(region).clone();
+                secCrop = warped(region).clone();
+                pairRegistered = true;
+            }
+        } else
+            qWarning() << "Pair" << i << j << "could not be registered, cropping by the frame shift.";
+    }
 
+    if (refCrop.empty()) {
+        auto refSize = refFull.empty() ? refImage.size() : refFull.size();
+        auto secSize = secFull.empty() ? secImage.size() : secFull.size();
+        auto[refRect, secRect] = overlap(QSize(refSize.width, refSize.height), QSize(secSize.width, secSize.height),
+                                         xShift, yShift);
+        if (refRect.isEmpty()) {
+            Messages::warning_msg(nullptr, tr("The frame shift you entered is too large!"));
+            return std::tuple("", "");
+        }
+        auto toCvRect = [](const QRect &rect) { return cv::Rect(rect.x(), rect.y(), rect.width(), rect.height()); };
+        refCrop = refFull.empty() ? correct(refImage, refGrid, toCvRect(refRect)) : refFull(toCvRect(refRect)).clone();
+        secCrop = secFull.empty() ? correct(secImage, secGrid, toCvRect(secRect)) : secFull(toCvRect(secRect)).clone();
+    }
+
+    auto[refTmpPath, refOutPath, tarTmpPath, tarOutPath] = cropPaths(i, j);
+    auto writeCrop = [this](const cv::Mat &crop, const fs::path &tmpPath, const fs::path &outCropPath) {
+        auto tmpName = QString::fromStdString(tmpPath.string());
+        if (not cv::imwrite(tmpPath.string(), crop)) {
+            qWarning() << "Could not save crop:" << tmpName;
+            return false;
+        }
+        // the encoded crop is copied rather than encoded again
+        if (outPath != cropImaPath) {
+            auto outName = QString::fromStdString(outCropPath.string());
+            QFile::remove(outName);
+            if (not QFile::copy(tmpName, outName))
+                qWarning() << "Could not copy crop to" << outName;
+        }
+        cropImgList.append(tmpPath);
+        return true;
+    };
+
+    RadiometricNormaliser::normalise(secCrop, refCrop, normalisation);
+    if (not writeCrop(refCrop, refTmpPath, refOutPath) or not writeCrop(secCrop, tarTmpPath, tarOutPath))
+        return std::tuple("", "");
 
     return {refTmpPath, tarTmpPath};
 }
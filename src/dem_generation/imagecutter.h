@@ -11,7 +11,8 @@
 #include <QFileInfo>
 #include <QDir>
 #include <filesystem>
-#include <QGraphicsScene>
+#include "../lens_correction/lenscorrector.h"
+#include "radiometricnormaliser.h"
 
 namespace fs = std::filesystem;
 
@@ -26,7 +27,9 @@ Q_OBJECT
     fs::path cropImaPath;
     /// the directory where cropped images are saved
     QDir cropDir;
-    QGraphicsScene scene;
+
+    /// names of the crops in the temporary directory and in the output directory, which are created
+    std::tuple<fs::path, fs::path, fs::path, fs::path> cropPaths(int i, int j);
 
 public:
     explicit ImageCutter(QObject *parent = nullptr);
@@ -36,6 +39,16 @@ public:
     int xShift{0};
     /// shift in the y axis
     int yShift{0};
+    /// matching of the secondary crop to the reference crop
+    RadiometricNormaliser::Method normalisation{RadiometricNormaliser::None};
+    /// register the secondary image onto the reference before cropping, the shift is then not used
+    bool registerPair{false};
+    /// the last correctedCut registered its pair, otherwise it was cropped by the shift and is left to the
+    /// DEM generation's own frame registration
+    bool pairRegistered{false};
+
+    /// overlap of a reference and a secondary image shifted by (xShift, yShift), in the pixels of each image
+    static std::tuple<QRect, QRect> overlap(const QSize &refSize, const QSize &secSize, int xShift, int yShift);
 
 public Q_SLOTS:
     /// set the prefix used in the image name
@@ -46,6 +59,12 @@ public Q_SLOTS:
     void setTmpCropPath(const QString &path);
     /// crop the overlapping areas of the images
     std::tuple<fs::path, fs::path> imageCut(const QString& refImagePath, const QString& secImagePath, int i, int j);
+    /// crop the overlapping areas with lens correction and grayscale conversion in the same pass.
+    /// Each image is decoded straight to grayscale, only the overlap is remapped and each crop is encoded once.
+    /// Without a corrector the images are only converted, with registerPair the overlap is the registered one.
+    std::tuple<fs::path, fs::path> correctedCut(const QString &refImagePath, const QString &secImagePath, int i, int j,
+                                                LensCorrector *corrector, const LensParameters &parameters,
+                                                int interMethod);
 
 };
 
@@ -0,0 +1,123 @@
+//
+// Created by Nic on 16/06/2022.
+//
+
+#include "preregistration.h"
+#include "../utility/FourierMellin.hpp"
+#include "../utility/PhaseCorrelation.hpp"
+#include <opencv2/imgproc.hpp>
+#include <QElapsedTimer>
+#include <QtConcurrent>
+#include <cmath>
+
+namespace {
+    cv::Mat workingCopy(const cv::Mat &image, double scale) {
+        cv::Mat gray = image;
+        if (image.channels() == 3)
+            cv::cvtColor(image, gray, cv::COLOR_BGR2GRAY);
+        else if (image.channels() == 4)
+            cv::cvtColor(image, gray, cv::COLOR_BGRA2GRAY);
+        cv::Mat small = gray;
+        if (scale < 1.0)
+            cv::resize(gray, small, cv::Size(), scale, scale, cv::INTER_AREA);
+        cv::Mat values;
+        small.convertTo(values, CV_32F);
+        return values;
+    }
+}
+
+QDebug operator<<(QDebug debug, const RegistrationResult &result) {
+    QDebugStateSaver saver(debug);
+    debug.nospace() << "rotation " << result.rotation << " deg, scale " << result.scale
+                    << ", shift (" << result.shift.x << ", " << result.shift.y << ") px, response "
+                    << result.response << ", NCC " << result.ncc << ", residual " << result.residualRMS
+                    << " RMS, " << result.milliseconds << " ms";
+    return debug;
+}
+
+cv::Mat PreRegistration::logPolarSpectrum(const cv::Mat &square, const cv::Mat &window, const cv::Mat &highPass) {
+    return fm::logPolar(fm::centredMagnitude(square, window), highPass, polarSize);
+}
+
+RegistrationResult PreRegistration::tryRotation(const cv::Mat &reference, const cv::Mat &secondary,
+                                                const cv::Mat &window, double angle, double scale) {
+    RegistrationResult result;
+    result.rotation = std::remainder(angle, 360.0);
+    result.scale = scale;
+    auto size = reference.size();
+    auto transform = cv::getRotationMatrix2D(cv::Point2f(size.width / 2.0f, size.height / 2.0f), angle, scale);
+    cv::Mat rotated;
+    cv::warpAffine(secondary, rotated, transform, size);
+    auto shift = phase::correlate(reference, rotated, window, &result.response);
+    transform.at<double>(0, 2) -= shift.x;
+    transform.at<double>(1, 2) -= shift.y;
+    result.transform = transform;
+
+    cv::Mat valid;
+    auto warped = warp(secondary, transform, size, cv::INTER_LINEAR, &valid);
+    if (cv::countNonZero(valid) == 0)
+        return result;
+    cv::Scalar refMean, refDeviation, secMean, secDeviation;
+    cv::meanStdDev(reference, refMean, refDeviation, valid);
+    cv::meanStdDev(warped, secMean, secDeviation, valid);
+    cv::Mat refCentred = reference - refMean;
+    cv::Mat secCentred = warped - secMean;
+    auto covariance = cv::mean(refCentred.mul(secCentred), valid)[0];
+    result.ncc = covariance / std::max(refDeviation[0] * secDeviation[0], 1e-9);
+    cv::Mat difference = reference - warped;
+    result.residualRMS = std::sqrt(cv::mean(difference.mul(difference), valid)[0]);
+    return result;
+}
+
+RegistrationResult PreRegistration::estimate(const cv::Mat &reference, const cv::Mat &secondary) {
+    QElapsedTimer timer;
+    timer.start();
+    auto scale = std::min(1.0, double(workingSide) / std::max(reference.cols, reference.rows));
+    auto secFuture = QtConcurrent::run([&secondary, scale]() { return workingCopy(secondary, scale); });
+    auto ref = workingCopy(reference, scale);
+    // the secondary is placed on a canvas the size of the reference, pixel for pixel
+    auto secWorking = secFuture.result();
+    cv::Mat sec = cv::Mat::zeros(ref.size(), CV_32F);
+    auto common = cv::Rect(0, 0, ref.cols, ref.rows) & cv::Rect(0, 0, secWorking.cols, secWorking.rows);
+    secWorking(common).copyTo(sec(common));
+
+    // rotating a non square spectrum does not rotate its samples, so the centre square is used
+    auto side = std::min(ref.cols, ref.rows) & ~1;
+    auto square = cv::Rect((ref.cols - side) / 2, (ref.rows - side) / 2, side, side);
+    cv::Mat squareWindow, window;
+    cv::createHanningWindow(squareWindow, square.size(), CV_32F);
+    cv::createHanningWindow(window, ref.size(), CV_32F);
+    auto highPass = fm::highPassFilter(side);
+
+    auto secSpectrum = QtConcurrent::run([&]() { return logPolarSpectrum(sec(square), squareWindow, highPass); });
+    auto refSpectrum = logPolarSpectrum(ref(square), squareWindow, highPass);
+    auto similarity = fm::rotationScale(refSpectrum, secSpectrum.result(), side);
+    auto angle = similarity.angle;
+    auto scaleFactor = similarity.scale;
+
+    // the magnitude spectrum is the same half a turn round, both rotations are tried
+    auto flipped = QtConcurrent::run([&]() { return tryRotation(ref, sec, window, angle + 180.0, scaleFactor); });
+    auto result = tryRotation(ref, sec, window, angle, scaleFactor);
+    auto other = flipped.result();
+    if (other.ncc > result.ncc)
+        result = other;
+
+    // back to full resolution pixels, the linear part is unchanged
+    result.transform.at<double>(0, 2) /= scale;
+    result.transform.at<double>(1, 2) /= scale;
+    result.shift = cv::Point2d(result.transform.at<double>(0, 2), result.transform.at<double>(1, 2));
+    result.ok = result.ncc >= minNCC;
+    result.milliseconds = double(timer.nsecsElapsed()) / 1e6;
+    return result;
+}
+
+cv::Mat PreRegistration::warp(const cv::Mat &secondary, const cv::Mat &transform, const cv::Size &size,
+                              int interMethod, cv::Mat *valid) {
+    cv::Mat warped;
+    cv::warpAffine(secondary, warped, transform, size, interMethod, cv::BORDER_CONSTANT);
+    if (valid) {
+        cv::warpAffine(cv::Mat(secondary.size(), CV_8U, cv::Scalar(255)), *valid, transform, size,
+                       cv::INTER_NEAREST, cv::BORDER_CONSTANT);
+    }
+    return warped;
+}
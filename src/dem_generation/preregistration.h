@@ -0,0 +1,59 @@
+//
+// Created by Nic on 16/06/2022.
+//
+
+#ifndef REALTIME3D_PREREGISTRATION_H
+#define REALTIME3D_PREREGISTRATION_H
+
+#include <opencv2/core.hpp>
+#include <QDebug>
+
+/// Similarity between a pair, and how well the warped secondary agrees with the reference
+struct RegistrationResult {
+    bool ok = false;
+    /// Maps secondary pixels onto the reference, 2x3 CV_64F in full resolution pixels
+    cv::Mat transform;
+    /// Counter-clockwise degrees, as cv::getRotationMatrix2D takes them
+    double rotation = 0.0;
+    double scale = 1.0;
+    cv::Point2d shift;
+    /// Phase correlation peak of the translation, 0 to 1
+    double response = 0.0;
+    /// Normalised cross correlation over the pixels both images cover once warped
+    double ncc = 0.0;
+    /// RMS grey level difference over the same pixels
+    double residualRMS = 0.0;
+    double milliseconds = 0.0;
+};
+
+QDebug operator<<(QDebug debug, const RegistrationResult &result);
+
+/// Registers the secondary image of a pair onto the reference before correlation.
+/// Rotation and scale come from the phase correlation of the log-polar magnitude spectra
+/// (Fourier-Mellin) and the translation from a second phase correlation, all on downsampled copies.
+/// The two spectra, and the two rotations a spectrum cannot tell apart, are worked on in parallel.
+class PreRegistration {
+public:
+    /// Longest side of the copies the transform is estimated on
+    static constexpr int workingSide = 1024;
+    /// Angle and log-radius samples of the log-polar spectra
+    static constexpr int polarSize = 1024;
+    /// Below this the pair is reported as not registered
+    static constexpr double minNCC = 0.3;
+
+    static RegistrationResult estimate(const cv::Mat &reference, const cv::Mat &secondary);
+
+    /// Secondary in reference pixels. valid, when given, is set to the pixels the secondary covers.
+    static cv::Mat warp(const cv::Mat &secondary, const cv::Mat &transform, const cv::Size &size,
+                        int interMethod = cv::INTER_LINEAR, cv::Mat *valid = nullptr);
+
+private:
+    static cv::Mat logPolarSpectrum(const cv::Mat &square, const cv::Mat &window, const cv::Mat &highPass);
+
+    /// Translation, NCC and residual of one rotation and scale
+    static RegistrationResult tryRotation(const cv::Mat &reference, const cv::Mat &secondary,
+                                          const cv::Mat &window, double angle, double scale);
+};
+
+
+#endif //REALTIME3D_PREREGISTRATION_H
@@ -0,0 +1,113 @@
+//
+// Created by Nic on 14/06/2022.
+//
+
+#include "radiometricnormaliser.h"
+#include <opencv2/imgproc.hpp>
+#include <QDebug>
+#include <array>
+
+namespace {
+    /// Limits the contrast gain where a neighbourhood of either image is nearly flat
+    constexpr double minGain = 0.25;
+    constexpr double maxGain = 4.0;
+    /// Variance floor, in grey levels squared
+    constexpr double minVariance = 1.0;
+}
+
+bool RadiometricNormaliser::normalise(cv::Mat &secondary, const cv::Mat &reference, Method method) {
+    if (method == None)
+        return true;
+    if (secondary.depth() != CV_8U or secondary.type() != reference.type() or secondary.size() != reference.size()) {
+        qWarning() << "Pair could not be normalised, the crops differ in size or format.";
+        return false;
+    }
+    if (secondary.empty())
+        return false;
+    switch (method) {
+        case HistogramMatching:
+            matchHistograms(secondary, reference);
+            break;
+        case LocalMeanVariance:
+            matchLocalStatistics(secondary, reference);
+            break;
+        case None:
+            break;
+    }
+    return true;
+}
+
+cv::Mat RadiometricNormaliser::downsampled(const cv::Mat &image) {
+    auto scale = double(statisticsSide) / std::max(image.cols, image.rows);
+    if (scale >= 1.0)
+        return image;
+    cv::Mat small;
+    cv::resize(image, small, cv::Size(), scale, scale, cv::INTER_AREA);
+    return small;
+}
+
+void RadiometricNormaliser::matchHistograms(cv::Mat &secondary, const cv::Mat &reference) {
+    auto refSmall = downsampled(reference);
+    auto secSmall = downsampled(secondary);
+    auto channels = secondary.channels();
+
+    const int histSize = 256;
+    const float range[] = {0, 256};
+    const float *ranges[] = {range};
+    auto cumulative = [&](const cv::Mat &image, int channel) {
+        cv::Mat hist;
+        cv::calcHist(&image, 1, &channel, cv::Mat(), hist, 1, &histSize, ranges);
+        std::array<double, 256> cdf{};
+        double total = 0;
+        for (int v = 0; v < histSize; v++)
+            cdf[v] = total += hist.at<float>(v);
+        for (auto &value: cdf)
+            value /= std::max(total, 1.0);
+        return cdf;
+    };
+
+    // each secondary level goes to the reference level at the same quantile
+    cv::Mat lut(1, histSize, CV_8UC(channels));
+    for (int c = 0; c < channels; c++) {
+        auto refCdf = cumulative(refSmall, c);
+        auto secCdf = cumulative(secSmall, c);
+        int level = 0;
+        for (int v = 0; v < histSize; v++) {
+            while (level < histSize - 1 and refCdf[level] < secCdf[v])
+                level++;
+            lut.ptr<uchar>()[v * channels + c] = uchar(level);
+        }
+    }
+    cv::LUT(secondary, lut, secondary);
+}
+
+void RadiometricNormaliser::matchLocalStatistics(cv::Mat &secondary, const cv::Mat &reference) {
+    auto localStatistics = [](const cv::Mat &image, cv::Mat &mean, cv::Mat &deviation) {
+        cv::Mat values, squares;
+        downsampled(image).convertTo(values, CV_32F);
+        cv::boxFilter(values, mean, CV_32F, cv::Size(localWindow, localWindow),
+                      cv::Point(-1, -1), true, cv::BORDER_REFLECT);
+        cv::boxFilter(values.mul(values), squares, CV_32F, cv::Size(localWindow, localWindow),
+                      cv::Point(-1, -1), true, cv::BORDER_REFLECT);
+        cv::max(squares - mean.mul(mean), minVariance, deviation);
+        cv::sqrt(deviation, deviation);
+    };
+    cv::Mat refMean, refDeviation, secMean, secDeviation;
+    localStatistics(reference, refMean, refDeviation);
+    localStatistics(secondary, secMean, secDeviation);
+
+    // out = gain * secondary + offset, with gain and offset smooth enough to take at low resolution
+    cv::Mat gain, offset;
+    cv::divide(refDeviation, secDeviation, gain);
+    cv::min(cv::max(gain, minGain), maxGain, gain);
+    offset = refMean - gain.mul(secMean);
+    cv::resize(gain, gain, secondary.size(), 0, 0, cv::INTER_LINEAR);
+    cv::resize(offset, offset, secondary.size(), 0, 0, cv::INTER_LINEAR);
+
+    cv::Mat values;
+    secondary.convertTo(values, CV_32F);
+    cv::multiply(values, gain, values);
+    cv::add(values, offset, values);
+    // saturates into the original buffer
+    values.convertTo(secondary, CV_8U);
+}
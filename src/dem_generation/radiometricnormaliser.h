@@ -0,0 +1,38 @@
+//
+// Created by Nic on 14/06/2022.
+//
+
+#ifndef REALTIME3D_RADIOMETRICNORMALISER_H
+#define REALTIME3D_RADIOMETRICNORMALISER_H
+
+#include <opencv2/core.hpp>
+
+/// Matches the brightness and contrast of a secondary image to its reference before correlation.
+/// Statistics are taken from downsampled copies, so the full resolution work is one lookup table
+/// or one multiply-add over the crop, both vectorised by OpenCV.
+class RadiometricNormaliser {
+public:
+    enum Method {
+        None,
+        HistogramMatching, ///< global, for exposure and white balance differences
+        LocalMeanVariance ///< per neighbourhood, also evens out uneven lighting across the pair
+    };
+
+    /// Longest side of the copies the statistics are taken from
+    static constexpr int statisticsSide = 512;
+    /// Side of the local statistics window, in pixels of the downsampled copies
+    static constexpr int localWindow = 31;
+
+    /// Changes secondary in place. Both must be 8 bit with the same size and channels.
+    static bool normalise(cv::Mat &secondary, const cv::Mat &reference, Method method);
+
+    static void matchHistograms(cv::Mat &secondary, const cv::Mat &reference);
+
+    static void matchLocalStatistics(cv::Mat &secondary, const cv::Mat &reference);
+
+private:
+    static cv::Mat downsampled(const cv::Mat &image);
+};
+
+
+#endif //REALTIME3D_RADIOMETRICNORMALISER_H
@@ -5,14 +5,23 @@
 #include "DeviceProfile.h"
 #include <QDebug>
 
-DeviceProfile::DeviceProfile(const std::shared_ptr<lfDatabase> &ltd, QWidget *parent) :
+DeviceProfile::DeviceProfile(const std::shared_ptr<lfDatabase> &ltd, const std::shared_ptr<LensfunIndex> &index,
+                             QWidget *parent) :
         lensfunDB(ltd),
+        lensfunIndex(index),
         def_index1(QStringLiteral("Choose Profile")) {
 
 }
 
+std::shared_ptr<lfDatabase> DeviceProfile::database() const {
+    // while it is parsed in the background the database is not touched here
+    if (auto index = lensfunIndex.lock(); index and not index->isAttached())
+        return nullptr;
+    return lensfunDB.lock();
+}
+
 const lfCamera **DeviceProfile::findCameras(const QString &cameraName) {
-    auto db = lensfunDB.lock();
+    auto db = database();
     if (db.use_count() == 0) {
         qDebug() << "Database not available for findCameras(1).";
         return nullptr;
@@ -28,7 +37,7 @@ const lfCamera **DeviceProfile::findCameras(const QString &cameraName) {
 }
 
 const lfCamera **DeviceProfile::findCameras(const QString &cameraName, const QString &cameraMaker) {
-    auto db = lensfunDB.lock();
+    auto db = database();
     if (db.use_count() == 0) {
         qDebug() << "Database not available for findCameras(2).";
         return nullptr;
@@ -45,7 +54,10 @@ const lfCamera **DeviceProfile::findCameras(const QString &cameraName, const QSt
 
 const lfCamera *DeviceProfile::findCamera(const QString &cameraName) {
     if (cameraName.isEmpty() or cameraName.isNull()) return nullptr;
-    auto db = lensfunDB.lock();
+    if (auto index = lensfunIndex.lock())
+        if (auto camera = index->findCamera(cameraName))
+            return camera;
+    auto db = database();
     if (db.use_count() == 0) {
         qDebug() << "Database not available for findCamera(1).";
         return nullptr;
@@ -62,6 +74,9 @@ const lfCamera *DeviceProfile::findCamera(const QString &cameraName) {
 }
 
 const lfCamera *DeviceProfile::findCamera(const QString &cameraName, const QString &cameraMaker) {
+    if (auto index = lensfunIndex.lock())
+        if (auto camera = index->findCamera(cameraName, cameraMaker))
+            return camera;
     auto cameras = findCameras(cameraName, cameraMaker);
     if (cameras) {
         auto camera = cameras[0];
@@ -74,7 +89,7 @@ const lfCamera *DeviceProfile::findCamera(const QString &cameraName, const QStri
 
 
 const lfLens **DeviceProfile::findLenses(const QString &lensName, const QString &lensMaker) {
-    auto db = lensfunDB.lock();
+    auto db = database();
     if (db.use_count() == 0) {
         qDebug() << "Database not available for findLenses(1).";
         return nullptr;
@@ -91,7 +106,7 @@ const lfLens **DeviceProfile::findLenses(const QString &lensName, const QString
 }
 
 const lfLens **DeviceProfile::findLenses(const lfCamera *camera) {
-    auto db = lensfunDB.lock();
+    auto db = database();
     if (db.use_count() == 0) {
         qDebug() << "Database not available for findLenses(1).";
         return nullptr;
@@ -104,6 +119,9 @@ const lfLens **DeviceProfile::findLenses(const lfCamera *camera) {
 }
 
 const lfLens *DeviceProfile::findLens(const QString &lensName, const QString &lensMaker) {
+    if (auto index = lensfunIndex.lock())
+        if (auto lens = index->findLens(lensName, lensMaker))
+            return lens;
     auto lenses = findLenses(lensName, lensMaker);
     if (lenses) {
         auto lens = lenses[0];
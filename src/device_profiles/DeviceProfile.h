@@ -8,11 +8,14 @@
 #include <QWidget>
 #include <lensfun/lensfun.h>
 #include <QStringListModel>
+#include "lensfunindex.h"
 
 class DeviceProfile : public QWidget {
 Q_OBJECT
 public:
-    explicit DeviceProfile(const std::shared_ptr<lfDatabase>& ltd, QWidget *parent = nullptr);
+    explicit DeviceProfile(const std::shared_ptr<lfDatabase>& ltd,
+                           const std::shared_ptr<LensfunIndex> &index = nullptr,
+                           QWidget *parent = nullptr);
 
     ~DeviceProfile() override = default;
 
@@ -30,6 +33,11 @@ protected:
     /// has value of "Choose Profile"
     QString def_index1;
     std::weak_ptr<lfDatabase> lensfunDB;
+    /// looked up before the fuzzy searches of the database
+    std::weak_ptr<LensfunIndex> lensfunIndex;
+
+    /// The database once the index is attached to it, null before
+    [[nodiscard]] std::shared_ptr<lfDatabase> database() const;
 
     const lfCamera ** findCameras(const QString &cameraName);
     const lfCamera ** findCameras(const QString &cameraName, const QString &cameraMaker);
@@ -14,8 +14,9 @@
 #include <QFileDialog>
 #include <QDesktopServices>
 
-AircraftProfile::AircraftProfile(const std::shared_ptr<lfDatabase> &ltd, QWidget *parent) :
-        DeviceProfile(ltd, parent), ui(new Ui::AircraftProfile) {
+AircraftProfile::AircraftProfile(const std::shared_ptr<lfDatabase> &ltd, const std::shared_ptr<LensfunIndex> &index,
+                                 QWidget *parent) :
+        DeviceProfile(ltd, index, parent), ui(new Ui::AircraftProfile) {
     ui->setupUi(this);
     connect(ui->flightHeight, QOverload<double>::of(&QDoubleSpinBox::valueChanged),
             this, &AircraftProfile::flightHeightChanged);
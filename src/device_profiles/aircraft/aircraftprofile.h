@@ -17,7 +17,8 @@ class AircraftProfile : public DeviceProfile {
 Q_OBJECT
 
 public:
-    explicit AircraftProfile(const std::shared_ptr<lfDatabase>& ltd, QWidget *parent = nullptr);
+    explicit AircraftProfile(const std::shared_ptr<lfDatabase>& ltd, const std::shared_ptr<LensfunIndex> &index,
+                             QWidget *parent = nullptr);
 
     ~AircraftProfile() override;
 
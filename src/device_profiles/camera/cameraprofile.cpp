@@ -10,8 +10,9 @@
 #include <QDebug>
 
 
-CameraProfile::CameraProfile(const std::shared_ptr<lfDatabase> &ltd, QWidget *parent) :
-        DeviceProfile(ltd, parent), ui(new Ui::CameraProfile) {
+CameraProfile::CameraProfile(const std::shared_ptr<lfDatabase> &ltd, const std::shared_ptr<LensfunIndex> &index,
+                             QWidget *parent) :
+        DeviceProfile(ltd, index, parent), ui(new Ui::CameraProfile) {
     ui->setupUi(this);
 
     connect(ui->imageDimWidth, QOverload<double>::of(&QDoubleSpinBox::valueChanged),
@@ -56,18 +57,12 @@ void CameraProfile::setImageHeight(double d) {
 void CameraProfile::populateProfileList() {
     ui->chooseProfile->clear();
     qInfo() << "Camera list populated.";
-    if (auto db = lensfunDB.lock()) {
-        auto cameras = db->GetCameras();
-
-        for (auto i = 0; cameras[i]; i++) {
-            auto camera = cameras[i];
-            auto model = QString::fromLatin1(camera->Model);
-            auto maker = QString::fromLatin1(camera->Maker);
-            auto variant = QString::fromLatin1(camera->Variant);
-            ui->chooseProfile->addItem(createMakerModelStr(maker, model, variant));
-            ui->chooseProfile->setItemData(i, model, Qt::ToolTipRole);
+    // already sorted by the index
+    if (auto index = lensfunIndex.lock()) {
+        for (const auto &entry: index->cameras()) {
+            ui->chooseProfile->addItem(entry.text);
+            ui->chooseProfile->setItemData(ui->chooseProfile->count() - 1, entry.model, Qt::ToolTipRole);
         }
-        ui->chooseProfile->model()->sort(0, Qt::AscendingOrder);
     }
 
     ui->chooseProfile->insertItem(0, def_index1);
@@ -125,7 +120,7 @@ void CameraProfile::searchAndSetCamera(const QString &cameraName) {
 }
 
 QString CameraProfile::createMakerModelStr(const QString &maker, const QString &model, const QString &variant) {
-    return maker + ": " + model + " " + variant;
+    return LensfunIndex::cameraText(maker, model, variant);
 }
 
 void CameraProfile::setImageInterval(double val) {
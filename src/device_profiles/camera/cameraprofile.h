@@ -18,7 +18,8 @@ class CameraProfile : public DeviceProfile {
 Q_OBJECT
 
 public:
-    explicit CameraProfile(const std::shared_ptr<lfDatabase> &ltd, QWidget *parent = nullptr);
+    explicit CameraProfile(const std::shared_ptr<lfDatabase> &ltd, const std::shared_ptr<LensfunIndex> &index,
+                           QWidget *parent = nullptr);
 
     ~CameraProfile() override;
 
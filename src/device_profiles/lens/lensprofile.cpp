@@ -9,8 +9,9 @@
 #include <QDebug>
 
 
-LensProfile::LensProfile(const std::shared_ptr<lfDatabase> &ltd, QWidget *parent) :
-        DeviceProfile(ltd, parent), ui(new Ui::LensProfile) {
+LensProfile::LensProfile(const std::shared_ptr<lfDatabase> &ltd, const std::shared_ptr<LensfunIndex> &index,
+                         QWidget *parent) :
+        DeviceProfile(ltd, index, parent), ui(new Ui::LensProfile) {
     ui->setupUi(this);
     ui->fflenLabel->setHidden(true);
     ui->focalLen_ff->setHidden(true);
@@ -79,19 +80,12 @@ void LensProfile::loadProfile() {
 void LensProfile::populateProfileList() {
     qInfo() << "Lens list populated.";
     ui->chooseProfile->clear();
-    if (auto db = lensfunDB.lock()) {
-        auto lenses = db->GetLenses();
-
-        for (auto i = 0; lenses[i]; i++) {
-            auto lens = lenses[i];
-            auto model = QString::fromLatin1(lens->Model);
-            auto maker = QString::fromLatin1(lens->Maker);
-            ui->chooseProfile->addItem(maker + ": " + model);
-            ui->chooseProfile->setItemData(i, model,
-                                           Qt::ToolTipRole);
-
+    // already sorted by the index
+    if (auto index = lensfunIndex.lock()) {
+        for (const auto &entry: index->lenses()) {
+            ui->chooseProfile->addItem(entry.text);
+            ui->chooseProfile->setItemData(ui->chooseProfile->count() - 1, entry.model, Qt::ToolTipRole);
         }
-        ui->chooseProfile->model()->sort(0, Qt::AscendingOrder);
     }
     ui->chooseProfile->insertItem(0, def_index1);
     ui->chooseProfile->insertSeparator(1);
@@ -107,21 +101,19 @@ void LensProfile::populateProfileList(const QString &cameraName, const QString &
     }
 
     ui->chooseProfile->clear();
-    if (auto db = lensfunDB.lock()) {
+    auto db = database();
+    auto index = lensfunIndex.lock();
+    if (db and index) {
         auto camera = findCamera(cameraName, cameraMaker);
         if (camera == nullptr) {populateProfileList(); return;}
-        auto lenses = findLenses(camera);
-        if (lenses == nullptr) {populateProfileList(); return;}
-        for (auto i = 0; lenses[i]; i++) {
-            auto lens = lenses[i];
-            auto model = QString::fromLatin1(lens->Model);
-            auto maker = QString::fromLatin1(lens->Maker);
-            ui->chooseProfile->addItem(maker + ": " + model);
-            ui->chooseProfile->setItemData(i, model,
-                                           Qt::ToolTipRole);
+        // the database is searched for the camera once, switching back to it reuses the result
+        auto lenses = index->lensesFor(db.get(), camera);
+        if (lenses.isEmpty()) {populateProfileList(); return;}
+        for (auto i: lenses) {
+            const auto &entry = index->lenses()[i];
+            ui->chooseProfile->addItem(entry.text);
+            ui->chooseProfile->setItemData(ui->chooseProfile->count() - 1, entry.model, Qt::ToolTipRole);
         }
-        ui->chooseProfile->model()->sort(0, Qt::AscendingOrder);
-        lf_free(lenses);
     }
     ui->chooseProfile->insertItem(0, def_index1);
     ui->chooseProfile->insertSeparator(1);
@@ -149,7 +141,21 @@ std::tuple<QString, QString> LensProfile::parseLensText(const QString &indexText
 
 
 void LensProfile::setProfileByName(const QString &name) {
-
+    if (name.isEmpty() or name.isNull()) return;
+    auto index = lensfunIndex.lock();
+    if (not index) return;
+    auto found = index->lensesStartingWith(name);
+    if (found.size() != 1) {
+        qDebug() << "No single lens profile found for" << name;
+        return;
+    }
+    auto idx = ui->chooseProfile->findText(index->lenses()[found.first()].text);
+    if (idx < 0) {
+        qDebug() << "Lens profile" << name << "is not listed for the current camera";
+        return;
+    }
+    ui->chooseProfile->setCurrentIndex(idx);
+    loadProfile();
 }
 
 void LensProfile::setAOV(double d) {
@@ -19,7 +19,8 @@ class LensProfile : public DeviceProfile {
 Q_OBJECT
 
 public:
-    explicit LensProfile(const std::shared_ptr<lfDatabase> &ltd, QWidget *parent = nullptr);
+    explicit LensProfile(const std::shared_ptr<lfDatabase> &ltd, const std::shared_ptr<LensfunIndex> &index,
+                         QWidget *parent = nullptr);
 
     ~LensProfile() override;
 
@@ -0,0 +1,337 @@
+//
+// Created by Nic on 12/06/2022.
+//
+
+#include "lensfunindex.h"
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QtEndian>
+#include <QDebug>
+#include <algorithm>
+#include <numeric>
+
+namespace {
+    constexpr quint32 indexMagic = 0x5254494c; // "RTIL"
+    constexpr quint32 indexVersion = 1;
+    const auto indexName = QLatin1String("lensfun.index");
+
+    QString normalised(const QString &text) {
+        return text.simplified().toLower();
+    }
+
+    /// First entry with the text and nothing attached yet, so entries of equal text are taken in turn. -1 if none.
+    template<typename Entry, typename Item>
+    int freeEntry(const QVector<Entry> &entries, const QString &text, Item Entry::*item) {
+        auto it = std::lower_bound(entries.cbegin(), entries.cend(), text,
+                                   [](const Entry &entry, const QString &t) { return entry.text < t; });
+        for (; it != entries.cend() and it->text == text; ++it)
+            if (not((*it).*item))
+                return int(it - entries.cbegin());
+        return -1;
+    }
+}
+
+QDataStream &operator<<(QDataStream &out, const LensfunIndex::CameraEntry &entry) {
+    return out << entry.maker << entry.model << entry.variant << entry.text;
+}
+
+QDataStream &operator>>(QDataStream &in, LensfunIndex::CameraEntry &entry) {
+    return in >> entry.maker >> entry.model >> entry.variant >> entry.text;
+}
+
+QDataStream &operator<<(QDataStream &out, const LensfunIndex::LensEntry &entry) {
+    return out << entry.maker << entry.model << entry.text;
+}
+
+QDataStream &operator>>(QDataStream &in, LensfunIndex::LensEntry &entry) {
+    return in >> entry.maker >> entry.model >> entry.text;
+}
+
+QDataStream &operator<<(QDataStream &out, const PrefixIndex &index) {
+    return out << index.keys << index.items;
+}
+
+QDataStream &operator>>(QDataStream &in, PrefixIndex &index) {
+    return in >> index.keys >> index.items;
+}
+
+void PrefixIndex::insert(const QString &text, int item) {
+    keys.append(text);
+    items.append(item);
+}
+
+void PrefixIndex::sort() {
+    QVector<int> order(keys.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [this](int a, int b) {
+        return keys[a] < keys[b] or (keys[a] == keys[b] and items[a] < items[b]);
+    });
+    QStringList sortedKeys;
+    QVector<int> sortedItems;
+    sortedKeys.reserve(keys.size());
+    sortedItems.reserve(items.size());
+    for (auto i: order) {
+        sortedKeys.append(keys[i]);
+        sortedItems.append(items[i]);
+    }
+    keys = sortedKeys;
+    items = sortedItems;
+}
+
+QVector<int> PrefixIndex::find(const QString &prefix) const {
+    QVector<int> found;
+    // every key starting with prefix sorts at or after it, and before any other key after it
+    for (auto i = int(std::lower_bound(keys.cbegin(), keys.cend(), prefix) - keys.cbegin());
+         i < keys.size() and keys[i].startsWith(prefix); i++)
+        found.append(items[i]);
+    std::sort(found.begin(), found.end());
+    found.erase(std::unique(found.begin(), found.end()), found.end());
+    return found;
+}
+
+void PrefixIndex::clear() {
+    keys.clear();
+    items.clear();
+}
+
+QString LensfunIndex::key(const QString &maker, const QString &model) {
+    return normalised(maker) + QLatin1Char('|') + normalised(model);
+}
+
+QString LensfunIndex::cameraText(const QString &maker, const QString &model, const QString &variant) {
+    return maker + ": " + model + " " + variant;
+}
+
+QString LensfunIndex::lensText(const QString &maker, const QString &model) {
+    return maker + ": " + model;
+}
+
+quint64 LensfunIndex::fingerprint(const QString &dbPath) {
+    QFileInfo info(dbPath);
+    QStringList files;
+    if (info.isDir()) {
+        QDirIterator it(dbPath, {QStringLiteral("*.xml")}, QDir::Files, QDirIterator::Subdirectories);
+        while (it.hasNext())
+            files.append(it.next());
+    } else if (info.exists())
+        files.append(dbPath);
+    files.sort();
+
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    for (const auto &file: files) {
+        QFileInfo fileInfo(file);
+        hash.addData(QString("%1|%2|%3\n").arg(file)
+                             .arg(fileInfo.size())
+                             .arg(fileInfo.lastModified().toMSecsSinceEpoch()).toUtf8());
+    }
+    return qFromLittleEndian<quint64>(hash.result().constData());
+}
+
+bool LensfunIndex::loadIndex(const QString &cacheDir, quint64 print) {
+    // detached either way, the database is about to be loaded again
+    clear();
+    if (cacheDir.isEmpty()) return false;
+    QFile file(QDir(cacheDir).filePath(indexName));
+    if (not file.open(QIODevice::ReadOnly)) return false;
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_5_12);
+    quint32 magic = 0, version = 0;
+    quint64 madeFrom = 0;
+    in >> magic >> version >> madeFrom;
+    if (magic != indexMagic or version != indexVersion or madeFrom != print)
+        return false;
+
+    in >> cameraEntries >> lensEntries >> cameraKeys >> lensKeys >> cameraPrefixes >> lensPrefixes;
+    if (in.status() != QDataStream::Ok) {
+        qWarning() << "Lens database index" << file.fileName() << "is damaged";
+        clear();
+        return false;
+    }
+    qInfo() << "Read" << cameraEntries.size() << "cameras and" << lensEntries.size() << "lenses from"
+            << file.fileName();
+    return true;
+}
+
+bool LensfunIndex::saveIndex(const QString &cacheDir, quint64 print) const {
+    if (cacheDir.isEmpty() or not QDir().mkpath(cacheDir)) return false;
+    QSaveFile file(QDir(cacheDir).filePath(indexName));
+    if (not file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Could not save lens database index" << file.fileName();
+        return false;
+    }
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_5_12);
+    out << indexMagic << indexVersion << print;
+    out << cameraEntries << lensEntries << cameraKeys << lensKeys << cameraPrefixes << lensPrefixes;
+    if (out.status() != QDataStream::Ok or not file.commit()) {
+        qWarning() << "Could not save lens database index" << file.fileName();
+        return false;
+    }
+    return true;
+}
+
+void LensfunIndex::clear() {
+    cameraEntries.clear();
+    lensEntries.clear();
+    cameraKeys.clear();
+    lensKeys.clear();
+    lensIndex.clear();
+    cameraPrefixes.clear();
+    lensPrefixes.clear();
+    cameraLenses.clear();
+    attached = false;
+}
+
+void LensfunIndex::build(lfDatabase *db) {
+    clear();
+
+    if (auto cameras = db->GetCameras()) {
+        for (auto i = 0; cameras[i]; i++) {
+            auto camera = cameras[i];
+            CameraEntry entry;
+            entry.maker = QString::fromLatin1(camera->Maker);
+            entry.model = QString::fromLatin1(camera->Model);
+            entry.variant = QString::fromLatin1(camera->Variant);
+            entry.text = cameraText(entry.maker, entry.model, entry.variant);
+            entry.camera = camera;
+            cameraEntries.append(entry);
+        }
+    }
+    if (auto lenses = db->GetLenses()) {
+        for (auto i = 0; lenses[i]; i++) {
+            auto lens = lenses[i];
+            LensEntry entry;
+            entry.maker = QString::fromLatin1(lens->Maker);
+            entry.model = QString::fromLatin1(lens->Model);
+            entry.text = lensText(entry.maker, entry.model);
+            entry.lens = lens;
+            lensEntries.append(entry);
+        }
+    }
+    // the order the pickers sorted their items in
+    std::sort(cameraEntries.begin(), cameraEntries.end(),
+              [](const CameraEntry &a, const CameraEntry &b) { return a.text < b.text; });
+    std::sort(lensEntries.begin(), lensEntries.end(),
+              [](const LensEntry &a, const LensEntry &b) { return a.text < b.text; });
+
+    for (int i = 0; i < cameraEntries.size(); i++) {
+        const auto &entry = cameraEntries[i];
+        auto modelVariant = entry.model + " " + entry.variant;
+        // the first of equal keys wins, as the first of the sorted list
+        for (const auto &cameraKey: {key(entry.maker, modelVariant), key(entry.maker, entry.model),
+                                     key({}, modelVariant), key({}, entry.model)})
+            if (not cameraKeys.contains(cameraKey))
+                cameraKeys.insert(cameraKey, i);
+        cameraPrefixes.insert(normalised(modelVariant), i);
+        cameraPrefixes.insert(normalised(entry.maker + " " + modelVariant), i);
+    }
+    for (int i = 0; i < lensEntries.size(); i++) {
+        const auto &entry = lensEntries[i];
+        auto lensKey = key(entry.maker, entry.model);
+        if (not lensKeys.contains(lensKey))
+            lensKeys.insert(lensKey, i);
+        lensIndex.insert(entry.lens, i);
+        lensPrefixes.insert(normalised(entry.model), i);
+        lensPrefixes.insert(normalised(entry.text), i);
+    }
+    cameraPrefixes.sort();
+    lensPrefixes.sort();
+    attached = true;
+    qInfo() << "Indexed" << cameraEntries.size() << "cameras and" << lensEntries.size() << "lenses.";
+}
+
+bool LensfunIndex::attach(lfDatabase *db) {
+    lensIndex.clear();
+    cameraLenses.clear();
+    for (auto &entry: cameraEntries) entry.camera = nullptr;
+    for (auto &entry: lensEntries) entry.lens = nullptr;
+    attached = false;
+
+    int cameraCount = 0;
+    if (auto cameras = db->GetCameras()) {
+        for (; cameras[cameraCount]; cameraCount++) {
+            auto camera = cameras[cameraCount];
+            auto i = freeEntry(cameraEntries, cameraText(QString::fromLatin1(camera->Maker),
+                                                         QString::fromLatin1(camera->Model),
+                                                         QString::fromLatin1(camera->Variant)),
+                               &CameraEntry::camera);
+            if (i < 0) return false;
+            cameraEntries[i].camera = camera;
+        }
+    }
+    int lensCount = 0;
+    if (auto lenses = db->GetLenses()) {
+        for (; lenses[lensCount]; lensCount++) {
+            auto lens = lenses[lensCount];
+            auto i = freeEntry(lensEntries, lensText(QString::fromLatin1(lens->Maker),
+                                                     QString::fromLatin1(lens->Model)),
+                               &LensEntry::lens);
+            if (i < 0) return false;
+            lensEntries[i].lens = lens;
+            lensIndex.insert(lens, i);
+        }
+    }
+    if (cameraCount != cameraEntries.size() or lensCount != lensEntries.size())
+        return false;
+    attached = true;
+    return true;
+}
+
+bool LensfunIndex::isAttached() const {
+    return attached;
+}
+
+const QVector<LensfunIndex::CameraEntry> &LensfunIndex::cameras() const {
+    return cameraEntries;
+}
+
+const QVector<LensfunIndex::LensEntry> &LensfunIndex::lenses() const {
+    return lensEntries;
+}
+
+const lfCamera *LensfunIndex::findCamera(const QString &model, const QString &maker) const {
+    auto i = cameraKeys.value(key(maker, model), -1);
+    return i < 0 ? nullptr : cameraEntries[i].camera;
+}
+
+const lfCamera *LensfunIndex::findCamera(const QString &model) const {
+    if (auto camera = findCamera(model, {}))
+        return camera;
+    auto found = cameraPrefixes.find(normalised(model));
+    return found.size() == 1 ? cameraEntries[found.first()].camera : nullptr;
+}
+
+const lfLens *LensfunIndex::findLens(const QString &model, const QString &maker) const {
+    auto i = lensKeys.value(key(maker, model), -1);
+    return i < 0 ? nullptr : lensEntries[i].lens;
+}
+
+QVector<int> LensfunIndex::lensesStartingWith(const QString &text) const {
+    return lensPrefixes.find(normalised(text));
+}
+
+QVector<int> LensfunIndex::lensesFor(lfDatabase *db, const lfCamera *camera) {
+    auto cached = cameraLenses.constFind(camera);
+    if (cached != cameraLenses.constEnd())
+        return *cached;
+
+    QVector<int> found;
+    if (auto lenses = db->FindLenses(camera, nullptr, nullptr)) {
+        for (auto i = 0; lenses[i]; i++) {
+            auto index = lensIndex.value(lenses[i], -1);
+            if (index >= 0)
+                found.append(index);
+        }
+        lf_free(lenses);
+    }
+    std::sort(found.begin(), found.end());
+    found.erase(std::unique(found.begin(), found.end()), found.end());
+    cameraLenses.insert(camera, found);
+    return found;
+}
@@ -0,0 +1,117 @@
+//
+// Created by Nic on 12/06/2022.
+//
+
+#ifndef REALTIME3D_LENSFUNINDEX_H
+#define REALTIME3D_LENSFUNINDEX_H
+
+#include <QString>
+#include <QStringList>
+#include <QHash>
+#include <QDataStream>
+#include <QVector>
+#include <lensfun/lensfun.h>
+
+/// Prefix index over lower case texts, kept sorted so a lookup is one binary search and a short scan
+class PrefixIndex {
+    QStringList keys;
+    QVector<int> items;
+
+public:
+    void insert(const QString &text, int item);
+
+    /// Sorts what was inserted, needed before find
+    void sort();
+
+    /// Items with a text starting with prefix, ascending and without repeats
+    [[nodiscard]] QVector<int> find(const QString &prefix) const;
+
+    void clear();
+
+    friend QDataStream &operator<<(QDataStream &out, const PrefixIndex &index);
+    friend QDataStream &operator>>(QDataStream &in, PrefixIndex &index);
+};
+
+/// Lookup tables of the lensfun database for the profile pickers.
+/// The picker texts and their maker, model and prefix indexes are saved to a binary file, read at start in
+/// place of the XML so the pickers fill at once. The database itself is parsed apart and attached afterwards,
+/// until then the entries have no lfCamera or lfLens.
+class LensfunIndex {
+public:
+    struct CameraEntry {
+        QString maker;
+        QString model;
+        QString variant;
+        /// as shown in the picker
+        QString text;
+        const lfCamera *camera = nullptr;
+    };
+
+    struct LensEntry {
+        QString maker;
+        QString model;
+        QString text;
+        const lfLens *lens = nullptr;
+    };
+
+    /// Empties the index, then reads the one saved in cacheDir if it was made from the XML files with this fingerprint
+    bool loadIndex(const QString &cacheDir, quint64 print);
+
+    /// Saves the index to cacheDir, stamped with the fingerprint of the XML files it was made from
+    bool saveIndex(const QString &cacheDir, quint64 print) const;
+
+    /// Indexes what db holds now, the entries are attached to it
+    void build(lfDatabase *db);
+
+    /// Points the entries read by loadIndex to the cameras and lenses of db.
+    /// False when db holds other cameras or lenses than the index.
+    bool attach(lfDatabase *db);
+
+    /// The entries are attached to a loaded database
+    [[nodiscard]] bool isAttached() const;
+
+    /// Of the path, size and modification time of every XML file under dbPath
+    static quint64 fingerprint(const QString &dbPath);
+
+    static QString cameraText(const QString &maker, const QString &model, const QString &variant);
+
+    static QString lensText(const QString &maker, const QString &model);
+
+    /// Sorted by picker text
+    [[nodiscard]] const QVector<CameraEntry> &cameras() const;
+
+    /// Sorted by picker text
+    [[nodiscard]] const QVector<LensEntry> &lenses() const;
+
+    /// Exact, case insensitive, match of maker and model, the model may include the variant
+    [[nodiscard]] const lfCamera *findCamera(const QString &model, const QString &maker) const;
+
+    /// Model alone, exact or else the only camera starting with it. Null when there is no single match.
+    [[nodiscard]] const lfCamera *findCamera(const QString &model) const;
+
+    [[nodiscard]] const lfLens *findLens(const QString &model, const QString &maker) const;
+
+    /// Lenses starting with text, by model or by picker text
+    [[nodiscard]] QVector<int> lensesStartingWith(const QString &text) const;
+
+    /// Lenses the database matches to the camera, searched once per camera
+    QVector<int> lensesFor(lfDatabase *db, const lfCamera *camera);
+
+private:
+    QVector<CameraEntry> cameraEntries;
+    QVector<LensEntry> lensEntries;
+    QHash<QString, int> cameraKeys;
+    QHash<QString, int> lensKeys;
+    QHash<const lfLens *, int> lensIndex;
+    PrefixIndex cameraPrefixes;
+    PrefixIndex lensPrefixes;
+    QHash<const lfCamera *, QVector<int>> cameraLenses;
+    bool attached{false};
+
+    static QString key(const QString &maker, const QString &model);
+
+    void clear();
+};
+
+
+#endif //REALTIME3D_LENSFUNINDEX_H
@@ -13,15 +13,25 @@
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QFileDialog>
+#include <QStandardPaths>
+#include <QtConcurrent>
+
+namespace {
+    QString indexDir() {
+        return QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+    }
+}
 
 OverviewProfile::OverviewProfile(const QString &dbPath, QWidget *parent) :
         QWidget(parent), ui(new Ui::OverviewProfile),
-        lensfunDB(std::make_shared<lfDatabase>()) {
+        lensfunDB(std::make_shared<lfDatabase>()),
+        lensfunIndex(std::make_shared<LensfunIndex>()) {
     ui->setupUi(this);
+    connect(&databaseWatcher, &QFutureWatcher<bool>::finished, this, &OverviewProfile::databaseLoaded);
     setDB_path(dbPath);
-    aircraftProfile = new AircraftProfile(lensfunDB);
-    cameraProfile = new CameraProfile(lensfunDB);
-    lensProfile = new LensProfile(lensfunDB);
+    aircraftProfile = new AircraftProfile(lensfunDB, lensfunIndex);
+    cameraProfile = new CameraProfile(lensfunDB, lensfunIndex);
+    lensProfile = new LensProfile(lensfunDB, lensfunIndex);
 
     connect(aircraftProfile, &AircraftProfile::profileChosen,
             this, [this](const QString& name){
@@ -56,18 +66,53 @@ OverviewProfile::OverviewProfile(const QString &dbPath, QWidget *parent) :
 }
 
 OverviewProfile::~OverviewProfile() {
+    databaseWatcher.waitForFinished();
     delete ui;
 }
 
+std::shared_ptr<lfDatabase> OverviewProfile::database() const {
+    return lensfunDB;
+}
+
+bool OverviewProfile::isDatabaseLoaded() const {
+    return databaseReady;
+}
+
 void OverviewProfile::setDB_path(const QString &path) {
     if (not QFileInfo::exists(path)) return;
-//    lensfunDB->Load()
-    if (lensfunDB->Load(path.toStdString().c_str()) != LF_NO_ERROR) {
+    // a load still running would fill the database with the new path's profiles under it
+    databaseWatcher.waitForFinished();
+    databaseReady = false;
+    // users of the database stop reading it before the worker writes it
+    Q_EMIT dbLoadStarted();
+
+    // the pickers fill from the saved index at once, the XML is parsed in the background and attached to it after
+    databasePrint = LensfunIndex::fingerprint(path);
+    lensfunIndex->loadIndex(indexDir(), databasePrint);
+    if (cameraProfile and lensProfile) {
+        cameraProfile->populateProfileList();
+        lensProfile->populateProfileList();
+    }
+    databaseWatcher.setFuture(QtConcurrent::run([db = lensfunDB, path]() {
+        return db->Load(path.toStdString().c_str()) == LF_NO_ERROR;
+    }));
+}
+
+void OverviewProfile::databaseLoaded() {
+    if (not databaseWatcher.result()) {
         qWarning() << "ERROR: Database could not be loaded\n";
-    } else {
-        Q_EMIT dbPathUpdated();
-        qInfo() << "Path to camera and lens profiles set.";
+        return;
+    }
+    // no index saved for these files, or one that no longer matches them
+    if (not lensfunIndex->attach(lensfunDB.get())) {
+        lensfunIndex->build(lensfunDB.get());
+        lensfunIndex->saveIndex(indexDir(), databasePrint);
+        cameraProfile->populateProfileList();
+        lensProfile->populateProfileList();
     }
+    databaseReady = true;
+    Q_EMIT dbPathUpdated();
+    qInfo() << "Path to camera and lens profiles set.";
 }
 
 QJsonObject OverviewProfile::loadProjectFile(const QString &filePath) {
@@ -6,6 +6,7 @@
 #define REALTIME3D_OVERVIEWPROFILE_H
 
 #include <QWidget>
+#include <QFutureWatcher>
 #include <lensfun/lensfun.h>
 #include "aircraft/aircraftprofile.h"
 #include "camera/cameraprofile.h"
@@ -20,16 +21,20 @@ class OverviewProfile : public QWidget {
 Q_OBJECT
 
 public:
-    AircraftProfile *aircraftProfile;
-    CameraProfile *cameraProfile;
-    LensProfile *lensProfile;
+    AircraftProfile *aircraftProfile{nullptr};
+    CameraProfile *cameraProfile{nullptr};
+    LensProfile *lensProfile{nullptr};
     explicit OverviewProfile(const QString &dbPath, QWidget *parent = nullptr);
 
     ~OverviewProfile() override;
 
 Q_SIGNALS:
+    /// the database has been loaded and the pickers are attached to it
     void dbPathUpdated();
 
+    /// the database is about to be loaded again, it is written in the background until dbPathUpdated
+    void dbLoadStarted();
+
 public Q_SLOTS:
     void setDB_path(const QString& path);
 
@@ -43,8 +48,24 @@ public Q_SLOTS:
 
     bool isLensSet();
 
+public:
+    [[nodiscard]] std::shared_ptr<lfDatabase> database() const;
+
+    /// the last load has finished, false while one runs or after it failed
+    [[nodiscard]] bool isDatabaseLoaded() const;
+
+private Q_SLOTS:
+    /// attaches the index to the parsed database, or builds and saves it when it was not read
+    void databaseLoaded();
+
 private:
     std::shared_ptr<lfDatabase> lensfunDB;
+    std::shared_ptr<LensfunIndex> lensfunIndex;
+    /// parse of the XML files in the background
+    QFutureWatcher<bool> databaseWatcher;
+    /// fingerprint of the XML files being parsed, the index is saved under it
+    quint64 databasePrint{0};
+    bool databaseReady{false};
     Ui::OverviewProfile *ui;
 };
 
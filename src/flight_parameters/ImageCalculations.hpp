@@ -11,77 +11,83 @@
 namespace image {
 
     namespace diagonal {
-        double equivalent() {
+        inline double equivalent() {
             return sqrt(24 * 24 + 36 * 36);
         }
 
-        double pixels(double imageWidth, double imageHeight) {
+        inline double pixels(double imageWidth, double imageHeight) {
             return sqrt(pow(imageWidth, 2) + pow(imageHeight, 2));
         }
 
-        double degrees(double focalLength) {
+        inline double degrees(double focalLength) {
             return 180 * 2 * atan(diagonal::equivalent() / (2 * focalLength)) / std::numbers::pi;
         }
 
-        double meters(double heightAboveGround, double focalLength) {
+        inline double meters(double heightAboveGround, double focalLength) {
             return heightAboveGround * tan(std::numbers::pi * degrees(focalLength) / (2 * 180));
         }
 
     }
 
     namespace motionBlur {
-        double cm(double flightSpeed_ms, double shutterSpeed) {
+        inline double cm(double flightSpeed_ms, double shutterSpeed) {
             return 100 * flightSpeed_ms / shutterSpeed;
         }
 
-        double pixels(double flightSpeed_ms, double shutterSpeed) {
-            return (100 * flightSpeed_ms / shutterSpeed) / cm(flightSpeed_ms, shutterSpeed);
+        /// Blur length in pixels, shutterSpeed is the denominator of the exposure time
+        inline double pixels(double flightSpeed_ms, double shutterSpeed, double groundPixelSize_cm) {
+            return cm(flightSpeed_ms, shutterSpeed) / groundPixelSize_cm;
         }
 
     }
 
     namespace interval {
-        double meters(double flightSpeed_ms, double interval_s) {
+        inline double meters(double flightSpeed_ms, double interval_s) {
             return flightSpeed_ms * interval_s;
         }
     }
 
-    double angularResolution(double imageWidth, double imageHeight, double focalLength) {
+    inline double angularResolution(double imageWidth, double imageHeight, double focalLength) {
         return diagonal::degrees(focalLength) / diagonal::pixels(imageWidth, imageHeight);
     }
 
     namespace groundPixelSize {
-        double cm(double imageWidth, double imageHeight, double heightAboveGround, double focalLength) {
+        inline double cm(double imageWidth, double imageHeight, double heightAboveGround, double focalLength) {
             return diagonal::meters(heightAboveGround, focalLength) / diagonal::pixels(imageWidth, imageHeight);
         }
+
+        /// Ground sample distance in metres per pixel for a nadir image
+        inline double metres(double sensorWidth_mm, double imageWidth, double heightAboveGround, double focalLength) {
+            return sensorWidth_mm * heightAboveGround / (focalLength * imageWidth);
+        }
     }
 
     namespace groundSize {
-        double metres(double imageAxisSize, double heightAboveGround, double focalLength) {
+        inline double metres(double imageAxisSize, double heightAboveGround, double focalLength) {
             return imageAxisSize * diagonal::meters(heightAboveGround, focalLength);
         }
     }
 
     namespace overlap {
-        double meters(double imageWidth, double imageHeight, double heightAboveGround, double focalLength) {
+        inline double meters(double imageWidth, double imageHeight, double heightAboveGround, double focalLength) {
             auto widthMetres = groundSize::metres(imageWidth, heightAboveGround, focalLength);
             auto heightMetres = groundSize::metres(imageWidth, heightAboveGround, focalLength);
             return widthMetres - heightMetres;
         }
 
-        double percent(double imageWidth, double imageHeight, double heightAboveGround, double focalLength) {
+        inline double percent(double imageWidth, double imageHeight, double heightAboveGround, double focalLength) {
             auto image_meters = meters(imageWidth, imageHeight, heightAboveGround, focalLength);
             return 100 * image_meters / groundSize::metres(imageWidth, heightAboveGround, focalLength);
         }
     }
 
     namespace rotationBlur {
-        double rb1(double imageWidth, double imageHeight, double rotationLensAxis, double shutterSpeed) {
+        inline double rb1(double imageWidth, double imageHeight, double rotationLensAxis, double shutterSpeed) {
             auto diag_px = diagonal::pixels(imageWidth, imageHeight);
             return (rotationLensAxis * shutterSpeed) * diag_px * std::numbers::pi / 360;
         }
 
-        double rb2(double imageWidth, double imageHeight,
+        inline double rb2(double imageWidth, double imageHeight,
                    double focalLength, double rotationOrthogonal, double shutterSpeed) {
             auto diag_degrees = diagonal::degrees(focalLength);
             auto diag_px = diagonal::pixels(imageWidth, imageHeight);
@@ -0,0 +1,152 @@
+//
+// Created by Nic on 10/06/2022.
+//
+
+#include "batchcorrector.h"
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+#include <QThreadPool>
+#include <QtConcurrent>
+#include <QDebug>
+
+namespace {
+    const auto manifestName = QLatin1String(".rt3d_corrections.json");
+
+    bool upToDate(const QString &source, const QString &key, const QString &manifestKey) {
+        if (key != manifestKey)
+            return false;
+        QFileInfo output(LensCorrector::correctedPath(source));
+        return output.exists() and output.lastModified() >= QFileInfo(source).lastModified();
+    }
+}
+
+BatchCorrector::BatchCorrector(LensCorrector *lensCorrector, QObject *parent) :
+        QObject(parent),
+        corrector(lensCorrector),
+        corrected(0),
+        skipped(0),
+        failed(0) {
+    connect(&watcher, &QFutureWatcher<CorrectionOutcome>::resultReadyAt,
+            this, &BatchCorrector::outcomeReady);
+    connect(&watcher, &QFutureWatcher<CorrectionOutcome>::progressValueChanged,
+            this, [this](int value) { Q_EMIT progress(value, watcher.progressMaximum()); });
+    connect(&watcher, &QFutureWatcher<CorrectionOutcome>::finished,
+            this, &BatchCorrector::batchFinished);
+}
+
+QString BatchCorrector::settingsKey(const LensParameters &parameters, int interMethod) {
+    auto description = QStringList{
+            parameters.cameraMaker, parameters.cameraModel,
+            parameters.lensMaker, parameters.lensModel,
+            QString::number(parameters.focalLength, 'g', 6),
+            QString::number(parameters.aperture, 'g', 6),
+            QString::number(parameters.distance, 'g', 6),
+            QString::number(parameters.corrections),
+            QString::number(interMethod)
+    }.join('|');
+    return QCryptographicHash::hash(description.toUtf8(), QCryptographicHash::Sha1).toHex();
+}
+
+bool BatchCorrector::isRunning() const {
+    return watcher.isRunning();
+}
+
+QString BatchCorrector::manifestPath(const QString &correctedPath) {
+    return QFileInfo(correctedPath).dir().filePath(manifestName);
+}
+
+void BatchCorrector::loadManifest(const QString &path) {
+    if (manifests.contains(path))
+        return;
+    auto &entries = manifests[path];
+    QFile file(path);
+    if (not file.open(QIODevice::ReadOnly))
+        return;
+    auto object = QJsonDocument::fromJson(file.readAll()).object();
+    for (auto it = object.constBegin(); it != object.constEnd(); ++it)
+        entries.insert(it.key(), it.value().toString());
+}
+
+void BatchCorrector::saveManifests() {
+    for (auto it = manifests.constBegin(); it != manifests.constEnd(); ++it) {
+        QJsonObject object;
+        for (auto entry = it->constBegin(); entry != it->constEnd(); ++entry)
+            object.insert(entry.key(), entry.value());
+        QSaveFile file(it.key());
+        if (not file.open(QIODevice::WriteOnly) or file.write(QJsonDocument(object).toJson()) < 0 or not file.commit())
+            qWarning() << "Could not write correction manifest" << it.key();
+    }
+}
+
+bool BatchCorrector::start(const QStringList &files, const LensParameters &parameters, int interMethod) {
+    if (isRunning()) {
+        qWarning() << "A batch correction is already running.";
+        return false;
+    }
+    corrected = skipped = failed = 0;
+    manifests.clear();
+    currentKey = settingsKey(parameters, interMethod);
+
+    // looked up here, the workers only read the snapshot
+    QHash<QString, QString> previousKeys;
+    for (const auto &source: files) {
+        auto output = LensCorrector::correctedPath(source);
+        auto path = manifestPath(output);
+        loadManifest(path);
+        previousKeys.insert(source, manifests.value(path).value(QFileInfo(output).fileName()));
+    }
+
+    // mapped runs on the global pool, one image per core
+    qInfo() << "Correcting" << files.size() << "images on" << QThreadPool::globalInstance()->maxThreadCount() << "threads";
+    watcher.setFuture(QtConcurrent::mapped(files,
+            [lensCorrector = corrector, parameters, interMethod, key = currentKey, previousKeys](const QString &source) {
+                CorrectionOutcome outcome;
+                outcome.source = source;
+                if (upToDate(source, key, previousKeys.value(source)))
+                    outcome.status = CorrectionOutcome::Skipped;
+                else if (lensCorrector->correctFile(source, parameters, interMethod))
+                    outcome.status = CorrectionOutcome::Corrected;
+                return outcome;
+            }));
+    return true;
+}
+
+void BatchCorrector::cancel() {
+    if (isRunning())
+        watcher.cancel();
+}
+
+void BatchCorrector::waitForFinished() {
+    watcher.waitForFinished();
+}
+
+void BatchCorrector::outcomeReady(int index) {
+    auto outcome = watcher.resultAt(index);
+    switch (outcome.status) {
+        case CorrectionOutcome::Corrected: {
+            corrected += 1;
+            auto output = LensCorrector::correctedPath(outcome.source);
+            manifests[manifestPath(output)].insert(QFileInfo(output).fileName(), currentKey);
+            break;
+        }
+        case CorrectionOutcome::Skipped:
+            skipped += 1;
+            break;
+        case CorrectionOutcome::Failed:
+            failed += 1;
+            break;
+    }
+}
+
+void BatchCorrector::batchFinished() {
+    saveManifests();
+    if (watcher.isCanceled())
+        qInfo() << "Correction cancelled";
+    qInfo() << "Corrected" << corrected << "images, skipped" << skipped << "up to date," << failed << "failed";
+    Q_EMIT finished(corrected, skipped, failed);
+}
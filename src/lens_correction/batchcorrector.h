@@ -0,0 +1,77 @@
+//
+// Created by Nic on 10/06/2022.
+//
+
+#ifndef REALTIME3D_BATCHCORRECTOR_H
+#define REALTIME3D_BATCHCORRECTOR_H
+
+#include <QObject>
+#include <QFutureWatcher>
+#include <QHash>
+#include <QStringList>
+#include "lenscorrector.h"
+
+struct CorrectionOutcome {
+    enum Status {
+        Corrected,
+        Skipped,
+        Failed
+    };
+    QString source;
+    Status status = Failed;
+};
+
+/// Corrects a folder of images on a worker pool, with progress and cancel.
+/// Each worker decodes, remaps and encodes one image, so the stages of different images overlap
+/// across cores. Images whose correction is newer than the source and was made with the same lens
+/// settings are skipped, the settings of each correction are kept in a manifest in its folder.
+class BatchCorrector : public QObject {
+Q_OBJECT
+    LensCorrector *corrector;
+    QFutureWatcher<CorrectionOutcome> watcher;
+    QString currentKey;
+    /// manifest path to corrected file name to settings key
+    QHash<QString, QHash<QString, QString>> manifests;
+    int corrected;
+    int skipped;
+    int failed;
+
+    static QString manifestPath(const QString &correctedPath);
+
+    void loadManifest(const QString &path);
+
+    void saveManifests();
+
+    void outcomeReady(int index);
+
+    void batchFinished();
+
+public:
+    explicit BatchCorrector(LensCorrector *lensCorrector, QObject *parent = nullptr);
+
+    /// Identifies the lens settings and interpolation a correction was made with
+    static QString settingsKey(const LensParameters &parameters, int interMethod);
+
+    [[nodiscard]] bool isRunning() const;
+
+Q_SIGNALS:
+
+    void progress(int done, int total);
+
+    void finished(int corrected, int skipped, int failed);
+
+public Q_SLOTS:
+
+    /// False if a batch is already running
+    bool start(const QStringList &files, const LensParameters &parameters, int interMethod);
+
+    /// Images already being corrected are finished, the rest are left
+    void cancel();
+
+    /// Blocks until the images being corrected are done, so the LensCorrector can be destroyed after
+    void waitForFinished();
+
+};
+
+
+#endif //REALTIME3D_BATCHCORRECTOR_H
@@ -0,0 +1,375 @@
+//
+// Created by Nic on 09/06/2022.
+//
+
+#include "lenscorrector.h"
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QtEndian>
+#include <QDebug>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+#include <cstring>
+#include <numeric>
+
+namespace {
+    /// Header of a grid cached on disk, followed by the rows of each of its maps
+    struct LUTHeader {
+        char magic[4];
+        quint32 version;
+        qint32 width;
+        qint32 height;
+        qint32 corrections;
+    };
+    constexpr char lutMagic[4] = {'R', 'T', 'L', 'U'};
+    constexpr quint32 lutVersion = 2;
+
+    /// Maps of a grid with the given stages and their types, in their order on disk
+    template<class LUT>
+    auto lutLayout(LUT &lut, int corrections) {
+        std::vector<std::pair<decltype(&lut.map1), int>> layout{{&lut.map1, CV_16SC2}, {&lut.map2, CV_16UC1}};
+        if (corrections & LF_MODIFY_TCA)
+            layout.insert(layout.end(), {{&lut.redMap1,  CV_16SC2}, {&lut.redMap2,  CV_16UC1},
+                                         {&lut.blueMap1, CV_16SC2}, {&lut.blueMap2, CV_16UC1}});
+        if (corrections & LF_MODIFY_VIGNETTING)
+            layout.emplace_back(&lut.gain, CV_32FC1);
+        return layout;
+    }
+
+    /// Calls fill(first, last) in parallel over stripes of the grid's rows, each starting on a 16 byte boundary
+    /// as the SSE paths of lensfun need. The grid's own allocation is aligned, rows of an odd width are not.
+    template<typename Fill>
+    void forAlignedStripes(const cv::Mat &grid, const Fill &fill) {
+        auto rowsPerBlock = int(16 / std::gcd(grid.step[0], std::size_t(16)));
+        auto blocks = (grid.rows + rowsPerBlock - 1) / rowsPerBlock;
+        cv::parallel_for_(cv::Range(0, blocks), [&](const cv::Range &range) {
+            fill(range.start * rowsPerBlock, std::min(grid.rows, range.end * rowsPerBlock));
+        });
+    }
+
+    int sanitisedInterpolation(int interMethod) {
+        // remap only samples with these, the others of the interpolation setting fall back to the nearest one
+        switch (interMethod) {
+            case cv::INTER_NEAREST:
+            case cv::INTER_LINEAR:
+            case cv::INTER_CUBIC:
+            case cv::INTER_LANCZOS4:
+                return interMethod;
+            case cv::INTER_AREA:
+            case cv::INTER_LINEAR_EXACT:
+                return cv::INTER_LINEAR;
+            default:
+                return cv::INTER_NEAREST;
+        }
+    }
+}
+
+int RemapLUT::corrections() const {
+    return LF_MODIFY_DISTORTION
+           | (redMap1.empty() ? 0 : LF_MODIFY_TCA)
+           | (gain.empty() ? 0 : LF_MODIFY_VIGNETTING);
+}
+
+int RemapLUT::cost() const {
+    size_t bytes = 0;
+    for (const auto &map: {map1, map2, redMap1, redMap2, blueMap1, blueMap2, gain})
+        bytes += map.total() * map.elemSize();
+    return qMax(1, int(bytes / 1024));
+}
+
+LensCorrector::LensCorrector(const std::shared_ptr<lfDatabase> &db, int cacheMebibytes) :
+        lensfunDB(db),
+        luts(qMax(16, cacheMebibytes) * 1024) {
+}
+
+void LensCorrector::setDatabaseLoaded(bool loaded) {
+    QMutexLocker locker(&mutex);
+    databaseLoaded = loaded;
+}
+
+void LensCorrector::setDiskCache(const QString &dir) {
+    QMutexLocker locker(&mutex);
+    diskCacheDir = dir;
+    if (not dir.isEmpty() and not QDir().mkpath(dir)) {
+        qWarning() << "Could not create lens grid cache" << dir;
+        diskCacheDir.clear();
+    }
+}
+
+quint64 LensCorrector::lutKey(const LensParameters &parameters, const QSize &size) {
+    auto description = QStringList{
+            parameters.cameraMaker, parameters.cameraModel,
+            parameters.lensMaker, parameters.lensModel,
+            QString::number(parameters.focalLength, 'g', 6),
+            QString::number(parameters.aperture, 'g', 6),
+            QString::number(parameters.distance, 'g', 6),
+            QString::number(parameters.corrections),
+            QString::number(size.width()), QString::number(size.height())
+    }.join('|');
+    auto digest = QCryptographicHash::hash(description.toUtf8(), QCryptographicHash::Sha1);
+    return qFromLittleEndian<quint64>(digest.constData());
+}
+
+std::shared_ptr<const RemapLUT> LensCorrector::lut(const LensParameters &parameters, const QSize &size) {
+    auto key = lutKey(parameters, size);
+    // held while building, so a batch of threads waiting on the same lens builds it once
+    QMutexLocker locker(&mutex);
+    if (auto cached = luts.object(key))
+        return *cached;
+
+    auto built = readLUT(key, size);
+    if (not built) {
+        built = buildLUT(parameters, size, key);
+        if (not built)
+            return nullptr;
+        writeLUT(*built);
+    }
+    std::shared_ptr<const RemapLUT> shared = built;
+    luts.insert(key, new std::shared_ptr<const RemapLUT>(shared), shared->cost());
+    return shared;
+}
+
+std::shared_ptr<RemapLUT> LensCorrector::buildLUT(const LensParameters &parameters, const QSize &size, quint64 key) const {
+    auto db = lensfunDB.lock();
+    if (not db or not databaseLoaded) {
+        qWarning() << "Lens database not available for correction.";
+        return nullptr;
+    }
+    auto cameras = db->FindCameras(parameters.cameraMaker.toStdString().c_str(),
+                                   parameters.cameraModel.toStdString().c_str());
+    if (cameras == nullptr) {
+        qWarning() << "Could not find Camera: [maker]" << parameters.cameraMaker << "[model]" << parameters.cameraModel;
+        return nullptr;
+    }
+    auto camera = cameras[0];
+    lf_free(cameras);
+    auto lenses = db->FindLenses(camera, parameters.lensMaker.toStdString().c_str(),
+                                 parameters.lensModel.toStdString().c_str());
+    if (lenses == nullptr) {
+        qWarning() << "Could not find lens: [maker]" << parameters.lensMaker << "[model]" << parameters.lensModel;
+        return nullptr;
+    }
+    auto lens = lenses[0];
+    lf_free(lenses);
+
+    lfModifier modifier(lens, float(parameters.focalLength), camera->CropFactor,
+                        size.width(), size.height(), LF_PF_U8);
+    if (not(modifier.EnableDistortionCorrection() & LF_MODIFY_DISTORTION)) {
+        qWarning() << "No distortion model for" << lens->Model << "at" << parameters.focalLength << "mm";
+        return nullptr;
+    }
+
+    // stages the lens has no model for are left out, the grid records what it applies
+    auto tca = (parameters.corrections & LF_MODIFY_TCA) and (modifier.EnableTCACorrection() & LF_MODIFY_TCA);
+    if ((parameters.corrections & LF_MODIFY_TCA) and not tca)
+        qInfo() << "No chromatic aberration model for" << lens->Model << "at" << parameters.focalLength << "mm";
+
+    qInfo() << "Building correction grid for" << camera->Model << lens->Model << "at"
+            << parameters.focalLength << "mm," << size;
+    auto lut = std::make_shared<RemapLUT>();
+    lut->key = key;
+    lut->size = size;
+    // rows are independent and the modifier is only read, so the grids are filled in parallel
+    if (tca) {
+        // red, green and blue source coordinates of every pixel
+        cv::Mat coords(size.height(), size.width(), CV_32FC(6));
+        forAlignedStripes(coords, [&](int first, int last) {
+            modifier.ApplySubpixelGeometryDistortion(0.0f, float(first), size.width(), last - first,
+                                                     coords.ptr<float>(first));
+        });
+        cv::Mat channels[] = {cv::Mat(size.height(), size.width(), CV_32FC2),
+                              cv::Mat(size.height(), size.width(), CV_32FC2),
+                              cv::Mat(size.height(), size.width(), CV_32FC2)};
+        const int fromTo[] = {0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5};
+        cv::mixChannels(&coords, 1, channels, 3, fromTo, 6);
+        cv::convertMaps(channels[0], cv::noArray(), lut->redMap1, lut->redMap2, CV_16SC2);
+        cv::convertMaps(channels[1], cv::noArray(), lut->map1, lut->map2, CV_16SC2);
+        cv::convertMaps(channels[2], cv::noArray(), lut->blueMap1, lut->blueMap2, CV_16SC2);
+    } else {
+        cv::Mat coords(size.height(), size.width(), CV_32FC2);
+        forAlignedStripes(coords, [&](int first, int last) {
+            modifier.ApplyGeometryDistortion(0.0f, float(first), size.width(), last - first, coords.ptr<float>(first));
+        });
+        cv::convertMaps(coords, cv::noArray(), lut->map1, lut->map2, CV_16SC2);
+    }
+
+    if (parameters.corrections & LF_MODIFY_VIGNETTING) {
+        lfModifier vignetting(lens, float(parameters.focalLength), camera->CropFactor,
+                              size.width(), size.height(), LF_PF_F32);
+        if (vignetting.EnableVignettingCorrection(float(parameters.aperture), float(parameters.distance))
+            & LF_MODIFY_VIGNETTING) {
+            // the corrected value of a white image is the gain of each source pixel
+            cv::Mat sourceGain(size.height(), size.width(), CV_32FC1, cv::Scalar(1.0));
+            forAlignedStripes(sourceGain, [&](int first, int last) {
+                vignetting.ApplyColorModification(sourceGain.ptr<float>(first), 0.0f, float(first),
+                                                  size.width(), last - first, LF_CR_1(INTENSITY),
+                                                  int(sourceGain.step));
+            });
+            // moved to corrected pixels once here, so correcting an image is one multiply after its remap
+            cv::remap(sourceGain, lut->gain, lut->map1, lut->map2, cv::INTER_LINEAR, cv::BORDER_REPLICATE);
+        } else
+            qInfo() << "No vignetting model for" << lens->Model << "at f/" << parameters.aperture;
+    }
+    return lut;
+}
+
+QString LensCorrector::diskCachePath(quint64 key) const {
+    return QDir(diskCacheDir).filePath(QString("%1.lut").arg(key, 16, 16, QChar('0')));
+}
+
+std::shared_ptr<RemapLUT> LensCorrector::readLUT(quint64 key, const QSize &size) const {
+    if (diskCacheDir.isEmpty())
+        return nullptr;
+    QFile file(diskCachePath(key));
+    if (not file.open(QIODevice::ReadOnly))
+        return nullptr;
+
+    LUTHeader header{};
+    if (file.read(reinterpret_cast<char *>(&header), sizeof(header)) != qint64(sizeof(header))
+        or memcmp(header.magic, lutMagic, 4) != 0 or header.version != lutVersion
+        or header.width != size.width() or header.height != size.height())
+        return nullptr;
+
+    auto lut = std::make_shared<RemapLUT>();
+    lut->key = key;
+    lut->size = size;
+    auto layout = lutLayout(*lut, header.corrections);
+    qint64 expected = sizeof(header);
+    for (auto[map, type]: layout) {
+        map->create(size.height(), size.width(), type);
+        expected += qint64(map->total() * map->elemSize());
+    }
+    if (file.size() != expected)
+        return nullptr;
+    for (auto[map, type]: layout) {
+        auto bytes = qint64(map->total() * map->elemSize());
+        if (file.read(reinterpret_cast<char *>(map->data), bytes) != bytes) {
+            qWarning() << "Could not read cached correction grid" << file.fileName();
+            return nullptr;
+        }
+    }
+    qInfo() << "Loaded correction grid" << file.fileName();
+    return lut;
+}
+
+void LensCorrector::writeLUT(const RemapLUT &lut) const {
+    if (diskCacheDir.isEmpty())
+        return;
+    QSaveFile file(diskCachePath(lut.key));
+    if (not file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Could not cache correction grid" << file.fileName();
+        return;
+    }
+    LUTHeader header{};
+    memcpy(header.magic, lutMagic, 4);
+    header.version = lutVersion;
+    header.width = lut.size.width();
+    header.height = lut.size.height();
+    header.corrections = lut.corrections();
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    // maps from convertMaps and remap are continuous
+    for (auto[map, type]: lutLayout(lut, header.corrections))
+        file.write(reinterpret_cast<const char *>(map->data), qint64(map->total() * map->elemSize()));
+    if (not file.commit())
+        qWarning() << "Could not cache correction grid" << file.fileName();
+}
+
+cv::Mat LensCorrector::undistort(const cv::Mat &image, const RemapLUT &lut, int interMethod) {
+    return undistortRegion(image, lut, cv::Rect(0, 0, lut.size.width(), lut.size.height()), interMethod);
+}
+
+cv::Mat LensCorrector::undistortRegion(const cv::Mat &image, const RemapLUT &lut, const cv::Rect &region,
+                                       int interMethod) {
+    interMethod = sanitisedInterpolation(interMethod);
+    // the grid rows of the region still hold full image coordinates, so the whole source is sampled from
+    auto inside = region & cv::Rect(0, 0, lut.map1.cols, lut.map1.rows);
+    auto channels = image.channels();
+    // channels are blue, green, red and alpha, with TCA each colour is sampled through its own grid
+    auto tca = not lut.redMap1.empty() and channels >= 3;
+    std::vector<cv::Mat> planes;
+    if (tca)
+        cv::split(image, planes);
+    // gray and alpha, or colour and alpha, leave the alpha channel without gain
+    auto gained = channels == 2 or channels == 4 ? channels - 1 : channels;
+
+    cv::Mat corrected(inside.size(), image.type());
+    // each stripe of rows is remapped, takes the gain and is written out while it is still in cache
+    constexpr int stripeRows = 32;
+    cv::parallel_for_(cv::Range(0, inside.height), [&](const cv::Range &rows) {
+        auto gridRows = cv::Rect(inside.x, inside.y + rows.start, inside.width, rows.end - rows.start);
+        auto out = corrected.rowRange(rows.start, rows.end);
+        auto gain = lut.gain.empty() ? cv::Mat() : lut.gain(gridRows);
+        auto remap = [&](const cv::Mat &source, const cv::Mat &map1, const cv::Mat &map2, cv::Mat &destination) {
+            cv::remap(source, destination, map1(gridRows), map2(gridRows), interMethod, cv::BORDER_CONSTANT);
+        };
+
+        if (not tca) {
+            // one remap of all channels, written straight into the result
+            remap(image, lut.map1, lut.map2, out);
+            if (gain.empty())
+                return;
+            if (channels == 1) {
+                cv::multiply(out, gain, out, 1.0, out.depth());
+                return;
+            }
+            std::vector<cv::Mat> gains(channels, gain);
+            for (int c = gained; c < channels; c++)
+                gains[c] = cv::Mat::ones(gain.size(), CV_32F);
+            cv::Mat channelGains;
+            cv::merge(gains, channelGains);
+            cv::multiply(out, channelGains, out, 1.0, out.depth());
+            return;
+        }
+
+        std::vector<cv::Mat> stripe(planes.size());
+        for (int c = 0; c < channels; c++) {
+            if (c == 0)
+                remap(planes[c], lut.blueMap1, lut.blueMap2, stripe[c]);
+            else if (c == 2)
+                remap(planes[c], lut.redMap1, lut.redMap2, stripe[c]);
+            else
+                remap(planes[c], lut.map1, lut.map2, stripe[c]);
+            if (not gain.empty() and c < gained)
+                cv::multiply(stripe[c], gain, stripe[c], 1.0, stripe[c].depth());
+        }
+        cv::merge(stripe, out);
+    }, std::max(1, inside.height / stripeRows));
+    return corrected;
+}
+
+QString LensCorrector::correctedPath(const QString &imagePath) {
+    QFileInfo info(imagePath);
+    return info.dir().filePath(info.completeBaseName() + QLatin1String("_corrected.") + info.suffix());
+}
+
+bool LensCorrector::correctFile(const QString &imagePath, const LensParameters &parameters, int interMethod) {
+    // unchanged keeps 16 bit tiffs at full depth
+    auto image = cv::imread(imagePath.toStdString(), cv::IMREAD_UNCHANGED);
+    if (image.empty()) {
+        qWarning() << "Could not read" << imagePath;
+        return false;
+    }
+    auto grid = lut(parameters, QSize(image.cols, image.rows));
+    if (not grid)
+        return false;
+    // encoded in memory and written through QSaveFile, so a cancelled or failed write never leaves a partial
+    // image, nor a temporary file with an image suffix that a later batch would take as input
+    auto outputPath = correctedPath(imagePath);
+    std::vector<uchar> encoded;
+    if (not cv::imencode("." + QFileInfo(outputPath).suffix().toStdString(),
+                         undistort(image, *grid, interMethod), encoded)) {
+        qWarning() << "Correction could not be encoded." << outputPath;
+        return false;
+    }
+    QSaveFile file(outputPath);
+    if (not file.open(QIODevice::WriteOnly)
+        or file.write(reinterpret_cast<const char *>(encoded.data()), qint64(encoded.size())) != qint64(encoded.size())
+        or not file.commit()) {
+        qWarning() << "Correction could not be saved." << outputPath << file.errorString();
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,105 @@
+//
+// Created by Nic on 09/06/2022.
+//
+
+#ifndef REALTIME3D_LENSCORRECTOR_H
+#define REALTIME3D_LENSCORRECTOR_H
+
+#include <QString>
+#include <QSize>
+#include <QCache>
+#include <QMutex>
+#include <lensfun/lensfun.h>
+#include <opencv2/core.hpp>
+#include <memory>
+
+/// Camera, lens and shot settings a correction is computed for
+struct LensParameters {
+    QString cameraMaker;
+    QString cameraModel;
+    QString lensMaker;
+    QString lensModel;
+    double focalLength = 0.0;
+    double aperture = 0.0;
+    double distance = 0.0;
+    /// LF_MODIFY_ flags of the stages wanted, the lens may lack a model for some
+    int corrections = LF_MODIFY_DISTORTION;
+};
+
+/// Source pixel of every corrected pixel, for one lens setting and image size.
+/// Stored as the fixed point maps of cv::convertMaps, which cv::remap reads without converting.
+/// With chromatic aberration corrected, map1 and map2 are the green channel and red and blue have their own maps.
+struct RemapLUT {
+    quint64 key = 0;
+    QSize size;
+    cv::Mat map1;
+    cv::Mat map2;
+    cv::Mat redMap1;
+    cv::Mat redMap2;
+    cv::Mat blueMap1;
+    cv::Mat blueMap2;
+    /// Vignetting gain of every corrected pixel, CV_32FC1, empty without vignetting correction
+    cv::Mat gain;
+
+    /// LF_MODIFY_ flags of the stages the grid applies
+    [[nodiscard]] int corrections() const;
+
+    /// KiB held by the maps
+    [[nodiscard]] int cost() const;
+};
+
+/// Native lensfun distortion correction.
+/// The remap grid is built once per lens setting and image size and kept in memory, and optionally
+/// on disk, so a flight of images from the same camera costs one grid build and one remap per image.
+class LensCorrector {
+    std::weak_ptr<lfDatabase> lensfunDB;
+    /// the database is parsed in the background, grids are built only once it is done. Guarded by mutex.
+    bool databaseLoaded{false};
+    QString diskCacheDir;
+    QMutex mutex;
+    /// cost in KiB
+    QCache<quint64, std::shared_ptr<const RemapLUT>> luts;
+
+    std::shared_ptr<RemapLUT> buildLUT(const LensParameters &parameters, const QSize &size, quint64 key) const;
+
+    [[nodiscard]] QString diskCachePath(quint64 key) const;
+
+    [[nodiscard]] std::shared_ptr<RemapLUT> readLUT(quint64 key, const QSize &size) const;
+
+    void writeLUT(const RemapLUT &lut) const;
+
+public:
+    explicit LensCorrector(const std::shared_ptr<lfDatabase> &db, int cacheMebibytes = 1024);
+
+    /// Set once the database has been loaded, cleared before it is loaded again.
+    /// Clearing waits for a grid being built, so nothing reads the database while it is written.
+    void setDatabaseLoaded(bool loaded);
+
+    /// Folder the grids are also saved to, empty keeps them in memory only
+    void setDiskCache(const QString &dir);
+
+    /// Stable across runs, it names the grids cached on disk
+    static quint64 lutKey(const LensParameters &parameters, const QSize &size);
+
+    /// Grid for the setting and size, built on the first request. Null if the lens is not in the database,
+    /// or the grid is not cached and the database is still loading.
+    /// Safe to call from several threads, concurrent requests for the same grid build it once.
+    std::shared_ptr<const RemapLUT> lut(const LensParameters &parameters, const QSize &size);
+
+    /// Remaps image through the grid in stripes of rows spread across cores. Each stripe is remapped, takes the
+    /// vignetting gain and is written out before the next, with one remap of all channels unless TCA is corrected.
+    static cv::Mat undistort(const cv::Mat &image, const RemapLUT &lut, int interMethod);
+
+    /// Corrected pixels of region only, the rest of the image is never remapped
+    static cv::Mat undistortRegion(const cv::Mat &image, const RemapLUT &lut, const cv::Rect &region, int interMethod);
+
+    /// Path the corrected image of imagePath is written to
+    static QString correctedPath(const QString &imagePath);
+
+    /// Writes the corrected copy of the image next to it as <stem>_corrected.<ext>
+    bool correctFile(const QString &imagePath, const LensParameters &parameters, int interMethod);
+
+};
+
+
+#endif //REALTIME3D_LENSCORRECTOR_H
@@ -7,7 +7,9 @@
 #include "main_window.h"
 #include "ui_mainwindow.h"
 #include "../utility/pyscriptcaller.h"
+#include "../utility/pythonruntime.h"
 #include "WatchdogIndicator.h"
+#include "../flight_parameters/ImageCalculations.hpp"
 #include <QDebug>
 #include <QProcess>
 #include <QDesktopServices>
@@ -19,6 +21,8 @@
 #include <QPlainTextEdit>
 #include <QTemporaryFile>
 #include <QFormLayout>
+#include <QStandardPaths>
+#include <QProgressDialog>
 
 
 MainWindow::MainWindow(QPlainTextEdit *consoleWidget, QWidget *parent) :
@@ -60,6 +64,14 @@ MainWindow::MainWindow(QPlainTextEdit *consoleWidget, QWidget *parent) :
     fileModel->setReadOnly(false);
 
     overviewProfile = new OverviewProfile(PathSettings::getCamerasPath());
+    lensCorrector = std::make_unique<LensCorrector>(overviewProfile->database());
+    // the database is parsed in the background, no grid is built from it before that finishes
+    lensCorrector->setDatabaseLoaded(overviewProfile->isDatabaseLoaded());
+    connect(overviewProfile, &OverviewProfile::dbLoadStarted,
+            this, [this]() { lensCorrector->setDatabaseLoaded(false); });
+    connect(overviewProfile, &OverviewProfile::dbPathUpdated,
+            this, [this]() { lensCorrector->setDatabaseLoaded(true); });
+    batchCorrector = new BatchCorrector(lensCorrector.get(), this);
 
     setupProfiles();
 
@@ -191,6 +203,9 @@ MainWindow::MainWindow(QPlainTextEdit *consoleWidget, QWidget *parent) :
 }
 
 MainWindow::~MainWindow() {
+    // the batch's workers use lensCorrector, which is destroyed before the batchCorrector child
+    batchCorrector->cancel();
+    batchCorrector->waitForFinished();
     delete ui;
 }
 
@@ -364,6 +379,10 @@ void MainWindow::launchDemGeneration() {
     connect(demGeneration, &DemGeneration::cameraFound,
             overviewProfile->cameraProfile, &CameraProfile::searchAndSetCamera);
 
+    demGeneration->setLensCorrection(lensCorrector.get(), [this](LensParameters &parameters) {
+        return currentLensParameters(parameters);
+    });
+
     connect(demGeneration, &DemGeneration::destroyed,
             this, [=, this]() {
                 ui->toolBarTop->removeAction(chooseCameraAction);
@@ -524,10 +543,12 @@ void MainWindow::runDat2Tiff(const QString &input) {
     } else
         inputInfo.setFile(input);
     // extra: ask file replacement with context menu
+    // queued until the scripts are imported
+    auto path = inputInfo.filePath().toUtf8().toStdString();
     if (inputInfo.suffix().toLower() == "dat") { // check correct file extension
-        pycall::dat2tiff(inputInfo.filePath().toUtf8().toStdString());
+        PythonRuntime::instance()->whenReady(this, [path]() { pycall::dat2tiff(path); });
     } else if (inputInfo.isDir()) {
-        pycall::dat2tiff_dir(inputInfo.filePath().toUtf8().toStdString());
+        PythonRuntime::instance()->whenReady(this, [path]() { pycall::dat2tiff_dir(path); });
     }
 }
 
@@ -559,6 +580,25 @@ void MainWindow::launchNavigation() {
     navigationApp->setZ(overviewProfile->aircraftProfile->getHeight());
     connect(overviewProfile->aircraftProfile, &AircraftProfile::flightHeightChanged,
             navigationApp, &MainInterface::setZ);
+
+    // flight images are matched at base map scale, so their GSD converts search distances to pixels
+    auto updateGroundSampleDistance = [this]() {
+        auto camera = overviewProfile->cameraProfile;
+        navigationApp->setGroundSampleDistance(image::groundPixelSize::metres(
+                camera->getSensorWidth(),
+                camera->getImageWidth(),
+                overviewProfile->aircraftProfile->getHeight(),
+                overviewProfile->lensProfile->getFocalLen()));
+    };
+    updateGroundSampleDistance();
+    connect(overviewProfile->aircraftProfile, &AircraftProfile::flightHeightChanged,
+            navigationApp, updateGroundSampleDistance);
+    connect(overviewProfile->cameraProfile, &CameraProfile::sensorWidthChanged,
+            navigationApp, updateGroundSampleDistance);
+    connect(overviewProfile->cameraProfile, &CameraProfile::imageWidthChanged,
+            navigationApp, updateGroundSampleDistance);
+    connect(overviewProfile->lensProfile, &LensProfile::focalLengthChanged,
+            navigationApp, updateGroundSampleDistance);
 }
 
 [[maybe_unused]] void MainWindow::runNewCameraCalibration() {
@@ -567,8 +607,8 @@ void MainWindow::launchNavigation() {
 }
 
 
-// apply geometric correction
-void MainWindow::runGeometricCorrection(const QString &input) {
+// lens settings of the current profiles, asking for any that are not set
+bool MainWindow::currentLensParameters(LensParameters &parameters) {
     // aircraft must have a height
     auto distanceToSubject = overviewProfile->aircraftProfile->getHeight();
     bool ok = false;
@@ -581,20 +621,20 @@ void MainWindow::runGeometricCorrection(const QString &input) {
                                                     ~Qt::WindowMinMaxButtonsHint);
         if (not ok) {
             qWarning() << "Aircraft height could not be determined";
-            return;
+            return false;
         }
         overviewProfile->aircraftProfile->setHeight(distanceToSubject);
     }
     if (not overviewProfile->isCameraSet()) {
         Messages::warning_msg(this, QLatin1String("A camera profile must be set to apply correction."));
         cameraDock->raise();
-        return;
+        return false;
     }
     auto[lensModel, lensMaker] = overviewProfile->lensProfile->currentTextToLens();
     if (not overviewProfile->isLensSet()) {
         Messages::warning_msg(this, QLatin1String("A lens profile must be set to apply correction."));
         lensDock->raise();
-        return;
+        return false;
     }
     auto focalLength = overviewProfile->lensProfile->getFocalLen();
     if (focalLength == 0.0) {
@@ -606,7 +646,7 @@ void MainWindow::runGeometricCorrection(const QString &input) {
                                               ~Qt::WindowMinMaxButtonsHint);
         if (not ok) {
             qWarning() << "Focal length could not be determined";
-            return;
+            return false;
         }
         overviewProfile->lensProfile->setFocalLen(focalLength);
     }
@@ -622,11 +662,42 @@ void MainWindow::runGeometricCorrection(const QString &input) {
                                            ~Qt::WindowMinMaxButtonsHint);
         if (not ok) {
             qWarning() << "Focal length could not be determined";
-            return;
+            return false;
         }
         overviewProfile->lensProfile->setAperture(aperture);
     }
 
+    parameters.cameraMaker = cameraMaker;
+    parameters.cameraModel = cameraModel;
+    parameters.lensMaker = lensMaker;
+    parameters.lensModel = lensModel;
+    parameters.focalLength = focalLength;
+    parameters.aperture = aperture;
+    parameters.distance = distanceToSubject;
+    parameters.corrections = LF_MODIFY_DISTORTION
+                             | (GeometricSettings::getVignettingCorrection() ? LF_MODIFY_VIGNETTING : 0)
+                             | (GeometricSettings::getTcaCorrection() ? LF_MODIFY_TCA : 0);
+    lensCorrector->setDiskCache(GeometricSettings::getLutDiskCache()
+                                ? QDir(QStandardPaths::writableLocation(QStandardPaths::CacheLocation))
+                                        .filePath(QLatin1String("lens_grids"))
+                                : QString());
+    return true;
+}
+
+// apply geometric correction
+void MainWindow::runGeometricCorrection(const QString &input) {
+    if (batchCorrector->isRunning()) {
+        Messages::warning_msg(this, QLatin1String("A correction is already running."));
+        return;
+    }
+    if (not overviewProfile->isDatabaseLoaded()) {
+        Messages::warning_msg(this, QLatin1String("The lens database is still loading."));
+        return;
+    }
+    LensParameters lensParameters;
+    if (not currentLensParameters(lensParameters))
+        return;
+
     QFileInfo inputInfo;
     if (input.isEmpty() or input.isNull()) {
         fileOrDirDialog.setOption(QFileDialog::DontUseNativeDialog, true);
@@ -660,26 +731,50 @@ void MainWindow::runGeometricCorrection(const QString &input) {
     if (inputInfo.isDir()) {
         auto imageTypes = DemGeneration::imageMimes();
         imageTypes.append(".dat");
-        files = QDir(inputInfo.filePath()).entryList(imageTypes);
+        auto inputDir = QDir(inputInfo.filePath());
+        for (const auto &name: inputDir.entryList(imageTypes)) {
+            // earlier results, and partial ones left by older versions, are not corrected again
+            auto baseName = QFileInfo(name).completeBaseName();
+            if (baseName.endsWith(QLatin1String("_corrected")) or baseName.endsWith(QLatin1String("_corrected.part")))
+                continue;
+            files.append(inputDir.filePath(name));
+        }
     } else
         files.append(inputInfo.filePath());
 
-    for (auto f: files) {
+    for (auto &f: files) {
         if (QFileInfo(f).suffix() == "dat") {
             runDat2Tiff(f);
             f = QFileInfo(f).path() + "/" + QFileInfo(f).completeBaseName() + ".tiff";
         }
-        pycall::correctDistortion(f.toStdString(),
-                                  cameraMaker.toStdString(),
-                                  cameraModel.toStdString(),
-                                  lensMaker.toStdString(),
-                                  lensModel.toStdString(),
-                                  focalLength,
-                                  aperture,
-                                  distanceToSubject,
-                                  GeometricSettings::getInterMethod());
     }
 
+    // the grid is built for the first image, every other image of the same size is only remapped
+    auto progressDialog = new QProgressDialog(QLatin1String("Correcting lens distortion"), QLatin1String("Stop"),
+                                              0, int(files.size()), this,
+                                              windowFlags() &
+                                              ~Qt::WindowContextHelpButtonHint &
+                                              ~Qt::WindowMaximizeButtonHint);
+    progressDialog->setWindowTitle(QLatin1String("Geometric Correction"));
+    progressDialog->setAttribute(Qt::WA_DeleteOnClose);
+    progressDialog->setMinimumDuration(500);
+    progressDialog->setValue(0);
+    connect(progressDialog, &QProgressDialog::canceled,
+            batchCorrector, &BatchCorrector::cancel);
+    connect(batchCorrector, &BatchCorrector::progress,
+            progressDialog, [progressDialog](int done, int total) {
+                progressDialog->setMaximum(total);
+                progressDialog->setValue(done);
+            });
+    connect(batchCorrector, &BatchCorrector::finished,
+            progressDialog, [this, progressDialog](int corrected, int skipped, int failed) {
+                progressDialog->close();
+                statusBar()->showMessage(QString("Corrected %1 images, %2 up to date, %3 failed.")
+                                                 .arg(corrected).arg(skipped).arg(failed), 5000);
+            });
+    if (not batchCorrector->start(files, lensParameters, GeometricSettings::getInterMethod()))
+        progressDialog->close();
+
 }
 
 void MainWindow::createNewCameraProfile() {
@@ -16,6 +16,9 @@
 #include "../device_profiles/overviewprofile.h"
 #include "../flight_parameters/FlightParameters.h"
 #include "../navigation/maininterface.h"
+#include "../lens_correction/lenscorrector.h"
+#include "../lens_correction/batchcorrector.h"
+#include <memory>
 
 QT_BEGIN_NAMESPACE
 namespace Ui { class MainWindow; }
@@ -43,6 +46,9 @@ private:
     Ui::MainWindow *ui;
     SettingsMenu *settingsMenu;
     OverviewProfile *overviewProfile;
+    /// keeps the distortion grids between corrections
+    std::unique_ptr<LensCorrector> lensCorrector;
+    BatchCorrector *batchCorrector;
     QPointer<DemGeneration> demGeneration;
     QPointer<FlightParameters> parameterCalculator;
     QPointer<MainInterface> navigationApp;
@@ -79,6 +85,9 @@ private Q_SLOTS:
 
     [[maybe_unused]] void runNewCameraCalibration();
 
+    /// False if a setting was not given
+    bool currentLensParameters(LensParameters &parameters);
+
     void runGeometricCorrection(const QString &input = QString());
 
     void createNewCameraProfile();
@@ -3,7 +3,6 @@
 //
 
 #include "missionscene.h"
-#include <QPainterPath>
 #include <QGraphicsSceneMouseEvent>
 #include "toolmode.h"
 
@@ -65,40 +64,20 @@ void MissionScene::mouseReleaseEvent(QGraphicsSceneMouseEvent *event) {
     QGraphicsScene::mouseReleaseEvent(event);
 }
 
-QPainterPath MissionScene::makeMask() {
-    auto mask = QPainterPath();
-    mask.setFillRule(Qt::WindingFill);
-    return mask;
+void MissionScene::indexPoint(Waypoint *waypoint) {
+    pointIndex.insert(waypoint);
 }
 
-ControlPoint *MissionScene::controlPointAt(const QPointF &point) {
-    auto mask = makeMask();
-    for (auto item: items(point)) {
-        if (mask.contains(point))
-            return nullptr;
-        auto ctrlPoint = qgraphicsitem_cast<ControlPoint *>(item);
-        if (ctrlPoint != nullptr)
-            return ctrlPoint;
+void MissionScene::unindexPoint(Waypoint *waypoint) {
+    pointIndex.remove(waypoint);
+}
 
-        auto connection = qgraphicsitem_cast<ConnectionLine *>(item);
-        if (connection == nullptr)
-            mask.addPath(item->shape().translated(item->scenePos()));
-    }
-    return nullptr;
+ControlPoint *MissionScene::controlPointAt(const QPointF &point) {
+    auto waypoint = waypointAt(point);
+    return waypoint != nullptr ? waypoint->control : nullptr;
 }
 
 Waypoint *MissionScene::waypointAt(const QPointF &point) {
-    auto mask = makeMask();
-    for (auto item: items(point)) {
-        if (mask.contains(point))
-            return nullptr;
-        auto pWaypoint = qgraphicsitem_cast<Waypoint *>(item);
-        if (pWaypoint != nullptr)
-            return pWaypoint;
-
-        auto connection = qgraphicsitem_cast<ConnectionLine *>(item);
-        if (connection == nullptr)
-            mask.addPath(item->shape().translated(item->scenePos()));
-    }
-    return nullptr;
+    // waypoints sit above the map layers, the closest centre wins where they overlap
+    return pointIndex.nearest(point, hitRadius);
 }
@@ -9,6 +9,7 @@
 #include <QGraphicsScene>
 #include <QPointer>
 #include "waypoint.h"
+#include "pointindex.h"
 
 class ToolModes;
 
@@ -17,9 +18,18 @@ class MissionScene : public QGraphicsScene {
     ControlPoint *startItem;
     ConnectionLine* newConnection;
     ToolModes *toolMode;
+    PointIndex pointIndex;
 public:
     explicit MissionScene(QObject *parent, ToolModes* pToolModes);
 
+    /// Distance from a waypoint centre that still hits it, the radius of its control point
+    static constexpr qreal hitRadius = 15;
+
+    /// Called by waypoints as they enter, move in and leave the scene
+    void indexPoint(Waypoint *waypoint);
+
+    void unindexPoint(Waypoint *waypoint);
+
 public Q_SLOTS:
 
     ControlPoint *controlPointAt(const QPointF& point);
@@ -33,9 +43,6 @@ protected:
 
     void mouseReleaseEvent(QGraphicsSceneMouseEvent *event) override;
 
-private Q_SLOTS:
-    static QPainterPath makeMask();
-
 };
 
 
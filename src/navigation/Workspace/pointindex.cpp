@@ -0,0 +1,73 @@
+//
+// Created by Nic on 06/06/2022.
+//
+
+#include "pointindex.h"
+#include "waypoint.h"
+#include <QtMath>
+#include <limits>
+
+PointIndex::PointIndex(qreal cellSize) : cellSize(cellSize) {}
+
+quint64 PointIndex::cellKey(int col, int row) const {
+    return (quint64(quint32(col)) << 32) | quint32(row);
+}
+
+quint64 PointIndex::cellKey(const QPointF &point) const {
+    return cellKey(qFloor(point.x() / cellSize), qFloor(point.y() / cellSize));
+}
+
+void PointIndex::insert(Waypoint *waypoint) {
+    auto key = cellKey(waypoint->scenePos());
+    auto previous = cellOf.constFind(waypoint);
+    if (previous != cellOf.constEnd()) {
+        if (*previous == key)
+            return;
+        cells[*previous].removeOne(waypoint);
+    }
+    cells[key].append(waypoint);
+    cellOf.insert(waypoint, key);
+}
+
+void PointIndex::remove(Waypoint *waypoint) {
+    auto previous = cellOf.find(waypoint);
+    if (previous == cellOf.end())
+        return;
+    auto cell = cells.find(*previous);
+    cell->removeOne(waypoint);
+    if (cell->isEmpty())
+        cells.erase(cell);
+    cellOf.erase(previous);
+}
+
+void PointIndex::clear() {
+    cells.clear();
+    cellOf.clear();
+}
+
+int PointIndex::size() const {
+    return static_cast<int>(cellOf.size());
+}
+
+Waypoint *PointIndex::nearest(const QPointF &point, qreal radius) const {
+    Waypoint *closest = nullptr;
+    auto closestDistance = radius * radius;
+    auto firstCol = qFloor((point.x() - radius) / cellSize), lastCol = qFloor((point.x() + radius) / cellSize);
+    auto firstRow = qFloor((point.y() - radius) / cellSize), lastRow = qFloor((point.y() + radius) / cellSize);
+    for (int col = firstCol; col <= lastCol; ++col) {
+        for (int row = firstRow; row <= lastRow; ++row) {
+            auto cell = cells.constFind(cellKey(col, row));
+            if (cell == cells.constEnd())
+                continue;
+            for (auto waypoint: *cell) {
+                auto delta = waypoint->scenePos() - point;
+                auto distance = QPointF::dotProduct(delta, delta);
+                if (distance <= closestDistance) {
+                    closestDistance = distance;
+                    closest = waypoint;
+                }
+            }
+        }
+    }
+    return closest;
+}
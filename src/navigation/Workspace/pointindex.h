@@ -0,0 +1,46 @@
+//
+// Created by Nic on 06/06/2022.
+//
+
+#ifndef REALTIME3D_POINTINDEX_H
+#define REALTIME3D_POINTINDEX_H
+
+
+#include <QHash>
+#include <QVector>
+#include <QPointF>
+
+class Waypoint;
+
+/// Uniform grid over the scene positions of the waypoints.
+/// A radius query only visits the cells it overlaps, so hit testing does not depend on the
+/// number of items in the scene.
+class PointIndex {
+    qreal cellSize;
+    QHash<quint64, QVector<Waypoint *>> cells;
+    QHash<Waypoint *, quint64> cellOf;
+
+    [[nodiscard]] quint64 cellKey(int col, int row) const;
+
+    [[nodiscard]] quint64 cellKey(const QPointF &point) const;
+
+public:
+    /// cellSize should be about the hit radius, larger cells hold more points per query
+    explicit PointIndex(qreal cellSize = 64);
+
+    /// Adds the waypoint, or moves it to the cell of its current scene position
+    void insert(Waypoint *waypoint);
+
+    void remove(Waypoint *waypoint);
+
+    void clear();
+
+    [[nodiscard]] int size() const;
+
+    /// Closest waypoint within radius of point, nullptr if none
+    [[nodiscard]] Waypoint *nearest(const QPointF &point, qreal radius) const;
+
+};
+
+
+#endif //REALTIME3D_POINTINDEX_H
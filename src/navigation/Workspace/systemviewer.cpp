@@ -3,7 +3,8 @@
 //
 
 #include <QScrollBar>
-#include <QProgressDialog>
+#include <QtConcurrent>
+#include <QThread>
 #include "systemviewer.h"
 #include "toolmode.h"
 #include "waypoint.h"
@@ -46,8 +47,15 @@ SystemViewer::SystemViewer(QWidget *parent,
         m_dragMode(NoDrag),
         lastWaypointPlaced(nullptr),
         lastWaypointSelected(nullptr),
-        lastMouseEvent(nullptr) {
+        lastMouseEvent(nullptr),
+        nextLocalisation(0),
+        appliedLocalisation(0) {
     setObjectName("System Viewer");
+
+    // matching is GIL bound for part of each job, a few workers keep the FFTs overlapped
+    localisationPool.setMaxThreadCount(qBound(2, QThread::idealThreadCount() / 2, 4));
+    connect(this, &SystemViewer::localisationReady,
+            this, &SystemViewer::queueLocalisation, Qt::QueuedConnection);
     setMouseTracking(true);
 
     setBackgroundBrush(QBrush(QColor(30, 30, 30)));
@@ -214,7 +222,7 @@ void SystemViewer::mousePressEvent(QMouseEvent *event) {
                     lastWaypointPlaced->connectTo(waypoint);
             } else {
                 auto baseMapItem = layerPanel->currentBaseMap;
-                if (baseMapItem->pixmap().isNull()){
+                if (not baseMapItem->hasImage()){
                     QMessageBox::warning(dynamic_cast<QWidget *>(parent()),
                                          "Warning", "Base map must be set.", QMessageBox::Ok);
                     return;
@@ -240,7 +248,6 @@ void SystemViewer::mouseMoveEvent(QMouseEvent *event) {
         storeMouseEvent(event);
         lastMouseEvent->setAccepted(false);
     }
-    auto item = itemAt(event->pos());
 
     if (event->modifiers() == Qt::AltModifier) {
         try {
@@ -346,6 +353,26 @@ Waypoint *SystemViewer::addWaypoint(QVector3D point3d) {
     return waypoint;
 }
 
+QVector<Waypoint *> SystemViewer::addWaypoints(const QVector<QVector3D> &points, bool connectSequence) {
+    if (points.isEmpty()) return {};
+    auto waypoints = coordinatePanel->generateWaypoints(points);
+    auto previous = lastWaypointPlaced;
+    for (int i = 0; i < waypoints.size(); ++i) {
+        auto point = waypoints.at(i);
+        Q_EMIT waypointAdded(point);
+        point->setPos(points.at(i).toPointF());
+        point->setZ(qIntCast(points.at(i).z()));
+        point->setPointType(PointType::Waypoint);
+        scene()->addItem(point);
+        if (connectSequence and previous != nullptr)
+            point->connectTo(previous);
+        previous = point;
+    }
+    lastWaypointPlaced = previous;
+    qInfo() << waypoints.size() << "waypoints added.";
+    return waypoints;
+}
+
 Waypoint *SystemViewer::addTargetpoint(QVector3D point3d) {
     auto waypoint = addMapPoint(point3d, PointType::TargetPoint);
     return waypoint;
@@ -387,7 +414,7 @@ Waypoint *SystemViewer::addMapPoint(QVector3D point3d, PointType pointType) {
 }
 
 bool SystemViewer::removeMapPoint(Waypoint *waypoint) {
-    QStandardItemModel *pointList;
+    WaypointTableModel *pointList;
     switch (waypoint->getPointType()) {
         case PointType::Waypoint:
             pointList = coordinatePanel->waypointsTable;
@@ -423,6 +450,17 @@ void SystemViewer::setBasemap(const QPixmap &pixmap, const QString &filePath) {
     setBasemap(pixmap);
 }
 
+bool SystemViewer::setBasemap(const QString &filePath) {
+    auto baseMapData = layerPanel->currentBaseMap;
+    zoom = 0;
+    if (not baseMapData->setTiledImage(filePath, false))
+        return false;
+    empty = false;
+    scene()->addItem(baseMapData->graphicsItem);
+    fitInView();
+    return true;
+}
+
 void SystemViewer::setBasemap(const QPixmap &pixmap) {
     auto baseMapData = layerPanel->currentBaseMap;
     zoom = 0;
@@ -438,32 +476,52 @@ void SystemViewer::setBasemap(const QPixmap &pixmap) {
     fitInView();
 }
 
-void SystemViewer::addPhoto(LayerData *imageLayerData, QPointF waypointPosition, bool connectPrev) {
-    auto progress = QProgressDialog(QLatin1String("Processing Image"),
-                                    nullptr,
-                                    0, 4,
-                                    this);
-    progress.setWindowModality(Qt::WindowModal);
-    progress.show();
-    progress.setValue(0);
-    progress.setValue(1);
-    QApplication::processEvents();
-
-    auto baseLayerData = layerPanel->currentBaseMap;
-
-    auto pos = pycall::matchAerialToMap(imageLayerData->imagePath.toStdString(),
-                                        baseLayerData->imagePath.toStdString(),
-                                        waypointPosition.toPoint().x(), waypointPosition.toPoint().y());
-
-    progress.setValue(2);
-    auto newPos = QPoint(std::get<0>(pos), std::get<1>(pos));
-    progress.setValue(3);
-
+void SystemViewer::addPhoto(LayerData *imageLayerData, QPointF waypointPosition, bool connectPrev,
+                            int searchWindow, int searchRadius, int matcher) {
+    // placeholder at the prior position until the match lands
     auto m_scene = dynamic_cast<MissionScene *>(scene());
     m_scene->addItem(imageLayerData->graphicsItem);
+    imageLayerData->graphicsItem->setPos(waypointPosition);
+    imageLayerData->graphicsItem->setOpacity(placeholderOpacity);
+    imageLayerData->graphicsItem->setToolTip(QLatin1String("Localising..."));
+
+    auto sequence = nextLocalisation++;
+    auto aerialImage = imageLayerData->imagePath.toStdString();
+    auto baseMap = layerPanel->currentBaseMap->imagePath.toStdString();
+    auto prior = waypointPosition.toPoint();
+    pendingLocalisations.insert(sequence, {imageLayerData, connectPrev, false, prior, 0.0});
+
+    QtConcurrent::run(&localisationPool, [=]() {
+        auto pos = searchRadius > 0
+                   ? pycall::matchAerialToMapPyramid(aerialImage, baseMap, prior.x(), prior.y(), searchRadius)
+                   : pycall::matchAerialToMap(aerialImage, baseMap, prior.x(), prior.y(), searchWindow, matcher);
+        // queued to the GUI thread
+        Q_EMIT localisationReady(sequence, QPoint(std::get<0>(pos), std::get<1>(pos)), std::get<2>(pos));
+    });
+}
+
+void SystemViewer::queueLocalisation(quint64 sequence, const QPoint &position, double confidence) {
+    auto pending = pendingLocalisations.find(sequence);
+    if (pending == pendingLocalisations.end()) return;
+    pending->matched = true;
+    pending->position = position;
+    pending->confidence = confidence;
+
+    // applied in submission order so target points connect in capture order
+    while (not pendingLocalisations.isEmpty() and pendingLocalisations.first().matched) {
+        auto result = pendingLocalisations.take(pendingLocalisations.firstKey());
+        appliedLocalisation += 1;
+        if (result.layer.isNull()) continue;
+        applyLocalisation(result.layer, result.position, result.confidence, result.connectPrev);
+    }
+}
+
+void SystemViewer::applyLocalisation(LayerData *imageLayerData, const QPoint &newPos, double confidence,
+                                     bool connectPrev) {
     imageLayerData->graphicsItem->setPos(newPos);
+    imageLayerData->graphicsItem->setOpacity(imageLayerData->isChecked() ? imageLayerData->getOpacity() / 100 : 0);
+    imageLayerData->graphicsItem->setToolTip(QString());
     auto targetPoint = addTargetpoint(QVector3D(newPos));
-    progress.setValue(4);
     if (connectPrev) {
         if (coordinatePanel->targetsTable->rowCount() > 1) {
             auto prevPoint = coordinatePanel->retrieveWaypoint(
@@ -471,6 +529,11 @@ void SystemViewer::addPhoto(LayerData *imageLayerData, QPointF waypointPosition,
             prevPoint->connectTo(targetPoint);
         }
     }
+    Q_EMIT photoLocalised(imageLayerData, newPos, confidence);
+}
+
+int SystemViewer::localisationsInFlight() const {
+    return static_cast<int>(nextLocalisation - appliedLocalisation);
 }
 
 void SystemViewer::storeMouseEvent(QMouseEvent *event) {
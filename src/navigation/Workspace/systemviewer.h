@@ -8,6 +8,8 @@
 #include <QPointer>
 #include <QGraphicsView>
 #include <QMouseEvent>
+#include <QThreadPool>
+#include <QMap>
 #include "toolmode.h"
 
 class LayerPanel;
@@ -30,6 +32,20 @@ Q_OBJECT
     double factor;
     bool empty;
 
+    /// Localisation jobs run on their own pool, results are applied in submission order
+    struct Localisation {
+        QPointer<LayerData> layer;
+        bool connectPrev;
+        bool matched;
+        QPoint position;
+        double confidence;
+    };
+    QThreadPool localisationPool;
+    quint64 nextLocalisation;
+    quint64 appliedLocalisation;
+    QMap<quint64, Localisation> pendingLocalisations;
+    static constexpr double placeholderOpacity = 0.35;
+
 public:
     explicit SystemViewer(QWidget *parent,
                           ToolModes *parent_toolModes,
@@ -58,6 +74,12 @@ Q_SIGNALS:
 
     void targetPointAdded(Waypoint *waypoint);
 
+    /// Flight image has been matched to the base map, confidence is the correlation peak (0 to 1)
+    void photoLocalised(LayerData *imageLayerData, const QPointF &position, double confidence);
+
+    /// Emitted from the localisation worker, connected queued to the GUI thread
+    void localisationReady(quint64 sequence, const QPoint &position, double confidence);
+
 public Q_SLOTS:
 
     void fitInView(bool rescale = true);
@@ -74,6 +96,10 @@ public Q_SLOTS:
 
     Waypoint *addWaypoint(QVector3D point3d);
 
+    /// Adds the points as waypoints with a single table insertion,
+    /// connectSequence links each to the one before, starting from the last waypoint placed
+    QVector<Waypoint *> addWaypoints(const QVector<QVector3D> &points, bool connectSequence = true);
+
     Waypoint *addTargetpoint(QVector3D point3d);
 
     Waypoint *addMapPoint(QVector3D point3d, PointType pointType);
@@ -86,7 +112,17 @@ public Q_SLOTS:
 
     void setBasemap(const QPixmap &pixmap, const QString &filePath);
 
-    void addPhoto(LayerData *imageLayerData, QPointF waypointPosition, bool connectPrev = true);
+    /// Shows the image file as a tiled base map, false if it cannot be read
+    bool setBasemap(const QString &filePath);
+
+    /// Shows the image at waypointPosition and queues it for matching to the base map,
+    /// it is moved and added as a target point once matched.
+    /// A searchRadius in pixels above 0 uses the coarse to fine matcher instead of the searchWindow,
+    /// otherwise the window is searched with matcher, a NavigationSettings::Matcher.
+    void addPhoto(LayerData *imageLayerData, QPointF waypointPosition, bool connectPrev = true,
+                  int searchWindow = 450, int searchRadius = 0, int matcher = 0);
+
+    [[nodiscard]] int localisationsInFlight() const;
 
     void keyPressEvent(QKeyEvent *event) override;
 
@@ -108,6 +144,10 @@ protected:
 private:
     void storeMouseEvent(QMouseEvent *event);
 
+    void queueLocalisation(quint64 sequence, const QPoint &position, double confidence);
+
+    void applyLocalisation(LayerData *imageLayerData, const QPoint &newPos, double confidence, bool connectPrev);
+
 };
 
 
@@ -0,0 +1,360 @@
+//
+// Created by Nic on 05/06/2022.
+//
+
+#include "tiledimageitem.h"
+#include <QImageReader>
+#include <QPainter>
+#include <QStyleOptionGraphicsItem>
+#include <QtConcurrent>
+#include <QCoreApplication>
+#include <QPointer>
+#include <QThread>
+#include <QtMath>
+#include <QDebug>
+#include <atomic>
+#include <cmath>
+
+namespace {
+    std::atomic<quint32> nextItemId{0};
+    /// Key level of the thumbnail, never reached by the pyramid
+    constexpr int thumbnailLevel = 0xFF;
+
+    QImage decodeTile(TileStore *store, const QString &filePath, quint32 itemId, bool clipDecoding,
+                      const QRect &source, const QSize &scaled) {
+        if (not clipDecoding) {
+            auto image = store->source(itemId, filePath);
+            if (image->isNull())
+                return {};
+            auto tile = image->copy(source);
+            if (scaled == source.size())
+                return tile;
+            return tile.scaled(scaled, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+        }
+        // only the clipped region is decoded, jpeg also decodes straight at the reduced size
+        QImageReader reader(filePath);
+        reader.setClipRect(source);
+        if (scaled != source.size())
+            reader.setScaledSize(scaled);
+        auto tile = reader.read();
+        if (tile.isNull())
+            qWarning() << "Could not decode tile" << source << "of" << filePath << reader.errorString();
+        return tile;
+    }
+}
+
+TileStore::TileStore(QObject *parent) :
+        QObject(parent),
+        sources(128 * 1024),
+        tiles(256 * 1024) {
+    pool.setMaxThreadCount(qBound(2, QThread::idealThreadCount() - 1, 8));
+    connect(this, &TileStore::tileDecoded, this, &TileStore::deliver, Qt::QueuedConnection);
+    connect(QCoreApplication::instance(), &QCoreApplication::aboutToQuit, this, &TileStore::shutDown);
+}
+
+TileStore::~TileStore() {
+    shutDown();
+}
+
+TileStore *TileStore::instance() {
+    static QPointer<TileStore> store;
+    if (store.isNull() and QCoreApplication::instance() != nullptr)
+        store = new TileStore(QCoreApplication::instance());
+    return store;
+}
+
+void TileStore::add(quint32 itemId, TiledImageItem *item) {
+    items.insert(itemId, item);
+}
+
+void TileStore::remove(quint32 itemId) {
+    items.remove(itemId);
+}
+
+TileStore::Source TileStore::source(quint32 itemId, const QString &filePath) {
+    std::unique_lock lock(sourceMutex);
+    if (auto cached = sources.object(itemId))
+        return *cached;
+    // another tile of the item is already decoding it
+    if (auto running = decoding.constFind(itemId); running != decoding.constEnd()) {
+        auto future = *running;
+        lock.unlock();
+        return future.get();
+    }
+    std::promise<Source> decoded;
+    decoding.insert(itemId, decoded.get_future().share());
+    lock.unlock();
+
+    QImageReader reader(filePath);
+    auto image = std::make_shared<const QImage>(reader.read());
+    if (image->isNull())
+        qWarning() << "Could not decode" << filePath << reader.errorString();
+
+    lock.lock();
+    decoding.remove(itemId);
+    if (not image->isNull())
+        sources.insert(itemId, new Source(image), qMax(1, int(image->sizeInBytes() / 1024)));
+    lock.unlock();
+    decoded.set_value(image);
+    return image;
+}
+
+void TileStore::dropSource(quint32 itemId) {
+    std::lock_guard lock(sourceMutex);
+    sources.remove(itemId);
+}
+
+void TileStore::setBudget(int mebibytes) {
+    tiles.setMaxCost(qMax(16, mebibytes) * 1024);
+    std::lock_guard lock(sourceMutex);
+    sources.setMaxCost(tiles.maxCost() / 2);
+}
+
+void TileStore::shutDown() {
+    pool.clear();
+    pool.waitForDone();
+    tiles.clear();
+    std::lock_guard lock(sourceMutex);
+    sources.clear();
+}
+
+void TileStore::deliver(quint64 key, const QImage &tile) {
+    if (auto item = items.value(quint32(key >> 40)))
+        item->insertTile(key, tile);
+}
+
+TiledImageItem::TiledImageItem(const QString &fileName, QGraphicsItem *parent) :
+        QGraphicsPixmapItem(parent),
+        filePath(fileName),
+        levels(0),
+        itemId(nextItemId++ & 0xFFFFFFu),
+        clipDecoding(false) {
+    setFlag(QGraphicsItem::ItemUsesExtendedStyleOption);
+    setShapeMode(QGraphicsPixmapItem::BoundingRectShape);
+    setTransformationMode(Qt::SmoothTransformation);
+
+    // the size comes from the header, nothing is decoded on the GUI thread
+    QImageReader reader(filePath);
+    imageSize = reader.size();
+    clipDecoding = reader.supportsOption(QImageIOHandler::ClipRect);
+    if (imageSize.isEmpty()) {
+        qWarning() << "Could not read" << filePath << reader.errorString();
+        imageSize = QSize();
+        return;
+    }
+    TileStore::instance()->add(itemId, this);
+
+    auto longest = qMax(imageSize.width(), imageSize.height());
+    levels = 1;
+    while ((tileSize << (levels - 1)) < longest)
+        levels += 1;
+
+    requestThumbnail();
+    qInfo() << "Tiled" << filePath << imageSize << "in" << levels << "levels,"
+            << (clipDecoding ? "decoding per tile" : "cut from the whole image");
+}
+
+TiledImageItem::~TiledImageItem() {
+    if (auto store = TileStore::instance())
+        store->remove(itemId);
+    releasePixels();
+}
+
+void TiledImageItem::setCacheBudget(int mebibytes) {
+    if (auto store = TileStore::instance())
+        store->setBudget(mebibytes);
+}
+
+bool TiledImageItem::isNull() const {
+    return imageSize.isEmpty();
+}
+
+QSize TiledImageItem::size() const {
+    return imageSize;
+}
+
+int TiledImageItem::levelCount() const {
+    return levels;
+}
+
+QString TiledImageItem::fileName() const {
+    return filePath;
+}
+
+QRectF TiledImageItem::boundingRect() const {
+    if (isNull())
+        return {};
+    return {offset(), QSizeF(imageSize)};
+}
+
+QPainterPath TiledImageItem::shape() const {
+    QPainterPath path;
+    path.addRect(boundingRect());
+    return path;
+}
+
+bool TiledImageItem::contains(const QPointF &point) const {
+    return boundingRect().contains(point);
+}
+
+quint64 TiledImageItem::tileKey(int level, int row, int col) const {
+    return (quint64(itemId) << 40) | (quint64(level & 0xFF) << 32) | (quint64(row & 0xFFFF) << 16) | quint64(col & 0xFFFF);
+}
+
+QRect TiledImageItem::tileRect(int level, int row, int col) const {
+    auto span = tileSize << level;
+    return QRect(col * span, row * span, span, span).intersected(QRect(QPoint(0, 0), imageSize));
+}
+
+int TiledImageItem::levelFor(qreal levelOfDetail) const {
+    if (levelOfDetail >= 1.0 or levelOfDetail <= 0.0)
+        return 0;
+    // finest level still at or above screen resolution
+    auto level = qFloor(std::log2(1.0 / levelOfDetail));
+    return qBound(0, level, levels - 1);
+}
+
+void TiledImageItem::requestTile(int level, int row, int col) {
+    auto key = tileKey(level, row, col);
+    if (pending.contains(key))
+        return;
+
+    auto source = tileRect(level, row, col);
+    auto scale = 1 << level;
+    auto scaled = QSize(qMax(1, (source.width() + scale - 1) / scale),
+                        qMax(1, (source.height() + scale - 1) / scale));
+    auto store = TileStore::instance();
+    if (store == nullptr)
+        return;
+    pending.insert(key);
+    // the store waits for its jobs before it is destroyed
+    QtConcurrent::run(&store->pool, [store, path = filePath, id = itemId, clip = clipDecoding, key, source, scaled]() {
+        Q_EMIT store->tileDecoded(key, decodeTile(store, path, id, clip, source, scaled));
+    });
+}
+
+void TiledImageItem::requestThumbnail() {
+    auto key = tileKey(thumbnailLevel, 0, 0);
+    if (pending.contains(key))
+        return;
+
+    auto source = QRect(QPoint(0, 0), imageSize);
+    auto scaled = imageSize;
+    if (qMax(imageSize.width(), imageSize.height()) > thumbnailSize)
+        scaled = imageSize.scaled(thumbnailSize, thumbnailSize, Qt::KeepAspectRatio).expandedTo(QSize(1, 1));
+    auto store = TileStore::instance();
+    if (store == nullptr)
+        return;
+    pending.insert(key);
+    // the store waits for its jobs before it is destroyed
+    QtConcurrent::run(&store->pool, [store, path = filePath, id = itemId, clip = clipDecoding, key, source, scaled]() {
+        Q_EMIT store->tileDecoded(key, decodeTile(store, path, id, clip, source, scaled));
+    });
+}
+
+bool TiledImageItem::isHidden() const {
+    return not isVisible() or qFuzzyIsNull(effectiveOpacity());
+}
+
+void TiledImageItem::releasePixels() {
+    thumbnail = QPixmap();
+    auto store = TileStore::instance();
+    if (store == nullptr)
+        return;
+    for (auto key: store->tiles.keys())
+        if ((key >> 40) == itemId)
+            store->tiles.remove(key);
+    store->dropSource(itemId);
+}
+
+QVariant TiledImageItem::itemChange(GraphicsItemChange change, const QVariant &value) {
+    if ((change == ItemVisibleHasChanged or change == ItemOpacityHasChanged) and isHidden())
+        releasePixels();
+    return QGraphicsPixmapItem::itemChange(change, value);
+}
+
+void TiledImageItem::insertTile(quint64 key, const QImage &tile) {
+    pending.remove(key);
+    // hidden while decoding, it is requested again once shown
+    if (tile.isNull() or isHidden())
+        return;
+    if (((key >> 32) & 0xFF) == thumbnailLevel) {
+        thumbnail = QPixmap::fromImage(tile);
+        update();
+        return;
+    }
+    auto pixmap = new QPixmap(QPixmap::fromImage(tile));
+    auto cost = qMax(1, pixmap->width() * pixmap->height() * pixmap->depth() / 8 / 1024);
+    TileStore::instance()->tiles.insert(key, pixmap, cost);
+
+    auto level = int((key >> 32) & 0xFF), row = int((key >> 16) & 0xFFFF), col = int(key & 0xFFFF);
+    update(QRectF(tileRect(level, row, col)).translated(offset()));
+}
+
+bool TiledImageItem::paintFallback(QPainter *painter, int level, const QRect &target) const {
+    auto &cache = TileStore::instance()->tiles;
+    for (int coarser = level + 1; coarser < levels; ++coarser) {
+        auto span = tileSize << coarser;
+        auto row = target.top() / span, col = target.left() / span;
+        auto tile = cache.object(tileKey(coarser, row, col));
+        if (tile == nullptr)
+            continue;
+        auto scale = qreal(1 << coarser);
+        auto origin = tileRect(coarser, row, col).topLeft();
+        auto source = QRectF(QPointF(target.topLeft() - origin) / scale, QSizeF(target.size()) / scale);
+        painter->drawPixmap(QRectF(target), *tile, source);
+        return true;
+    }
+    if (thumbnail.isNull())
+        return false;
+    auto scale = qreal(thumbnail.width()) / imageSize.width();
+    painter->drawPixmap(QRectF(target), thumbnail, QRectF(QPointF(target.topLeft()) * scale, QSizeF(target.size()) * scale));
+    return true;
+}
+
+void TiledImageItem::paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget) {
+    Q_UNUSED(widget)
+    if (isNull())
+        return;
+    auto exposed = option->exposedRect.translated(-offset()).intersected(QRectF(QPointF(0, 0), QSizeF(imageSize)));
+    if (exposed.isEmpty())
+        return;
+
+    if (thumbnail.isNull())
+        requestThumbnail();
+    auto levelOfDetail = option->levelOfDetailFromTransform(painter->worldTransform());
+    painter->save();
+    painter->translate(offset());
+    painter->setRenderHint(QPainter::SmoothPixmapTransform, transformationMode() == Qt::SmoothTransformation);
+
+    // small on screen, the thumbnail has all the detail that can be seen
+    if (levelOfDetail * qMax(imageSize.width(), imageSize.height()) <= thumbnailSize) {
+        if (not thumbnail.isNull())
+            painter->drawPixmap(QRectF(QPointF(0, 0), QSizeF(imageSize)), thumbnail, QRectF(thumbnail.rect()));
+        painter->restore();
+        return;
+    }
+
+    auto level = levelFor(levelOfDetail);
+    auto span = tileSize << level;
+    auto cols = (imageSize.width() + span - 1) / span;
+    auto rows = (imageSize.height() + span - 1) / span;
+    auto firstCol = qBound(0, qFloor(exposed.left() / span), cols - 1);
+    auto lastCol = qBound(firstCol, qCeil(exposed.right() / span) - 1, cols - 1);
+    auto firstRow = qBound(0, qFloor(exposed.top() / span), rows - 1);
+    auto lastRow = qBound(firstRow, qCeil(exposed.bottom() / span) - 1, rows - 1);
+
+    auto &cache = TileStore::instance()->tiles;
+    for (int row = firstRow; row <= lastRow; ++row) {
+        for (int col = firstCol; col <= lastCol; ++col) {
+            auto target = tileRect(level, row, col);
+            if (auto tile = cache.object(tileKey(level, row, col))) {
+                painter->drawPixmap(QRectF(target), *tile, QRectF(tile->rect()));
+                continue;
+            }
+            requestTile(level, row, col);
+            paintFallback(painter, level, target);
+        }
+    }
+    painter->restore();
+}
@@ -0,0 +1,149 @@
+//
+// Created by Nic on 05/06/2022.
+//
+
+#ifndef REALTIME3D_TILEDIMAGEITEM_H
+#define REALTIME3D_TILEDIMAGEITEM_H
+
+
+#include <QObject>
+#include <QGraphicsPixmapItem>
+#include <QCache>
+#include <QHash>
+#include <QSet>
+#include <QImage>
+#include <QThreadPool>
+#include <future>
+#include <memory>
+#include <mutex>
+
+class TiledImageItem;
+
+/// Owns the tile cache and decode pool shared by every tiled item. Created with the first item as a child of the
+/// application, it stops the pool and drops the tiles when the application quits, while the GUI is still up.
+/// Decoded tiles reach their item on the GUI thread, and only if the item still exists.
+class TileStore : public QObject {
+Q_OBJECT
+    QHash<quint32, TiledImageItem *> items;
+
+    using Source = std::shared_ptr<const QImage>;
+    /// Whole images of the formats without clip decoding, by item, cost in KiB. Used from the decode pool.
+    std::mutex sourceMutex;
+    QCache<quint32, Source> sources;
+    QHash<quint32, std::shared_future<Source>> decoding;
+
+    explicit TileStore(QObject *parent);
+
+public:
+    /// Cost in KiB
+    QCache<quint64, QPixmap> tiles;
+    QThreadPool pool;
+
+    ~TileStore() override;
+
+    /// Null once the application is gone
+    static TileStore *instance();
+
+    void add(quint32 itemId, TiledImageItem *item);
+
+    void remove(quint32 itemId);
+
+    /// The whole image of an item, decoded once while it stays within the source budget. Thread safe.
+    Source source(quint32 itemId, const QString &filePath);
+
+    void dropSource(quint32 itemId);
+
+    /// Tile budget, the whole images get half of it on top
+    void setBudget(int mebibytes);
+
+Q_SIGNALS:
+
+    /// Emitted from the decode pool
+    void tileDecoded(quint64 key, const QImage &tile);
+
+public Q_SLOTS:
+
+    /// Waits for the decode jobs and drops the cached tiles
+    void shutDown();
+
+private Q_SLOTS:
+
+    void deliver(quint64 key, const QImage &tile);
+};
+
+/// Image item that paints from a pyramid of tiles instead of a single pixmap.
+/// Only the tiles visible at the current zoom are decoded, on worker threads, and kept in a cache
+/// shared by every tiled item, so very large base maps load instantly and pan and zoom smoothly.
+/// Level n of the pyramid is the image downscaled by 2^n, the top level fits in a single tile.
+/// A small thumbnail is the only resident pixel data, it is drawn while the item is small on screen
+/// and under tiles still decoding. A hidden item releases its thumbnail and tiles.
+/// Formats that cannot decode a clip are decoded whole into a bounded cache, so they stay within the budget too.
+class TiledImageItem : public QGraphicsPixmapItem {
+    QString filePath;
+    QSize imageSize;
+    int levels;
+    quint32 itemId;
+    /// decodes a clip of the file per tile, otherwise tiles are cut from the whole image in the store
+    bool clipDecoding;
+    QPixmap thumbnail;
+    QSet<quint64> pending;
+
+    friend class TileStore;
+
+    [[nodiscard]] quint64 tileKey(int level, int row, int col) const;
+
+    /// Source image pixels covered by a tile
+    [[nodiscard]] QRect tileRect(int level, int row, int col) const;
+
+    [[nodiscard]] int levelFor(qreal levelOfDetail) const;
+
+    void requestTile(int level, int row, int col);
+
+    void requestThumbnail();
+
+    [[nodiscard]] bool isHidden() const;
+
+    /// Drops the thumbnail and the cached tiles of this item
+    void releasePixels();
+
+    void insertTile(quint64 key, const QImage &tile);
+
+    /// Draws the part of a coarser cached tile, or of the thumbnail, covering target.
+    /// False if neither is loaded.
+    bool paintFallback(QPainter *painter, int level, const QRect &target) const;
+
+public:
+    explicit TiledImageItem(const QString &fileName, QGraphicsItem *parent = nullptr);
+
+    ~TiledImageItem() override;
+
+    static constexpr int tileSize = 512;
+    /// Longest side of the resident thumbnail
+    static constexpr int thumbnailSize = 256;
+
+    /// Budget of the shared tile cache
+    static void setCacheBudget(int mebibytes);
+
+    [[nodiscard]] bool isNull() const;
+
+    [[nodiscard]] QSize size() const;
+
+    [[nodiscard]] int levelCount() const;
+
+    [[nodiscard]] QString fileName() const;
+
+    [[nodiscard]] QRectF boundingRect() const override;
+
+    [[nodiscard]] QPainterPath shape() const override;
+
+    [[nodiscard]] bool contains(const QPointF &point) const override;
+
+    void paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget) override;
+
+protected:
+    QVariant itemChange(GraphicsItemChange change, const QVariant &value) override;
+
+};
+
+
+#endif //REALTIME3D_TILEDIMAGEITEM_H
@@ -3,6 +3,7 @@
 //
 
 #include "waypoint.h"
+#include "missionscene.h"
 #include <QPainter>
 #include <QGraphicsScene>
 #include <utility>
@@ -34,6 +35,11 @@ Waypoint::Waypoint(QPersistentModelIndex index) : Waypoint(nullptr, std::move(in
 
 }
 
+Waypoint::~Waypoint() {
+    if (auto missionScene = dynamic_cast<MissionScene *>(scene()))
+        missionScene->unindexPoint(this);
+}
+
 int Waypoint::x() {
     return scenePos().toPoint().x();
 }
@@ -135,12 +141,21 @@ void Waypoint::paint(QPainter *painter, const QStyleOptionGraphicsItem *option,
 }
 
 QVariant Waypoint::itemChange(QGraphicsItem::GraphicsItemChange change, const QVariant &value) {
-    if (change == ItemPositionChange){
+    // after the move, so the new position is read back
+    if (change == ItemScenePositionHasChanged){
         Q_EMIT signals->itemMoved(index);
     }
     if (change == ItemSelectedChange)
             Q_EMIT signals->itemSelected(index);
 
+    // keep the scene's hit testing index current
+    if (change == ItemSceneChange)
+        if (auto missionScene = dynamic_cast<MissionScene *>(scene()))
+            missionScene->unindexPoint(this);
+    if (change == ItemSceneHasChanged or change == ItemScenePositionHasChanged)
+        if (auto missionScene = dynamic_cast<MissionScene *>(scene()))
+            missionScene->indexPoint(this);
+
     return QGraphicsItem::itemChange(change, value);
 }
 
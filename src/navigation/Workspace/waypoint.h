@@ -43,6 +43,8 @@ public:
 
     explicit Waypoint(QPersistentModelIndex index);
 
+    ~Waypoint() override;
+
     QColor brushColor;
     QPen pen;
     QBrush brush;
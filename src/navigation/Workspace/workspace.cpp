@@ -62,12 +62,6 @@ void Workspace::setCoordView(const QVector3D &pos) const {
 }
 
 void Workspace::connectWaypointSignals(Waypoint *waypoint) {
-    connect(waypoint->signals, &WayPointSignals::itemMoved,
-            this, [this]() {
-                coordinatePanel->waypointView->viewport()->update();
-            });
-    connect(waypoint->signals, &WayPointSignals::itemMoved,
-            this, [this]() { coordinatePanel->targetView->viewport()->update(); });
     connect(waypoint->signals, &WayPointSignals::itemSelected, this, &Workspace::highlightRow);
 }
 
@@ -19,75 +19,36 @@ CoordinatePanel::CoordinatePanel(QObject *parent,
                                  QLineEdit *ui_coordLineEdit,
                                  QTabWidget *ui_editorTabs) :
         QObject(parent),
-        waypointsTable(new QStandardItemModel(0, 3, this)),
-        targetsTable(new QStandardItemModel(0, 3, this)),
+        waypointsTable(new WaypointTableModel(this, true)),
+        targetsTable(new WaypointTableModel(this)),
         waypointView(ui_waypointView),
         targetView(ui_targetView),
         addCoordBtn(ui_addCoordsBtn),
         coordLineEdit(ui_coordLineEdit),
         editorTabs(ui_editorTabs) {
 
-    waypointView->setModel(waypointsTable);
-    waypointsTable->setHorizontalHeaderLabels({QLatin1String("X"),
-                                               QLatin1String("Y"),
-                                               QLatin1String("Z")});
-    waypointView->setSelectionMode(QAbstractItemView::ExtendedSelection);
-    waypointView->setSelectionBehavior(QAbstractItemView::SelectRows);
-    waypointView->setDragDropMode(QAbstractItemView::NoDragDrop);
-    waypointView->setDragDropOverwriteMode(false);
-    auto selectionModel = waypointView->selectionModel();
-    connect(selectionModel, &QItemSelectionModel::selectionChanged,
-            this, &CoordinatePanel::selectWaypoint);
+    waypointsTable->setObjectName(QLatin1String("WaypointList"));
+    targetsTable->setObjectName(QLatin1String("TargetPointList"));
+    setupView(waypointView, waypointsTable);
+    setupView(targetView, targetsTable);
     connect(addCoordBtn, &QPushButton::clicked, this, qOverload<>(&CoordinatePanel::getWaypointLine));
+}
 
-    auto header = waypointView->horizontalHeader();
-    for (int i = 0; i < header->count(); ++i) {
-        header->setSectionResizeMode(i, header->Stretch);
-    }
-
-    targetView->setModel(targetsTable);
-    targetsTable->setHorizontalHeaderLabels({QLatin1String("X"),
-                                             QLatin1String("Y"),
-                                             QLatin1String("Z")});
-    targetView->setSelectionMode(QAbstractItemView::ExtendedSelection);
-    targetView->setSelectionBehavior(QAbstractItemView::SelectRows);
-    targetView->setDragDropMode(QAbstractItemView::NoDragDrop);
-    targetView->setDragDropOverwriteMode(false);
-    selectionModel = targetView->selectionModel();
-    connect(selectionModel, &QItemSelectionModel::selectionChanged,
+void CoordinatePanel::setupView(QTableView *view, WaypointTableModel *model) {
+    view->setModel(model);
+    view->setSelectionMode(QAbstractItemView::ExtendedSelection);
+    view->setSelectionBehavior(QAbstractItemView::SelectRows);
+    view->setDragDropMode(QAbstractItemView::NoDragDrop);
+    view->setDragDropOverwriteMode(false);
+    connect(view->selectionModel(), &QItemSelectionModel::selectionChanged,
             this, &CoordinatePanel::selectWaypoint);
-    header = targetView->horizontalHeader();
+
+    auto header = view->horizontalHeader();
     for (int i = 0; i < header->count(); ++i) {
         header->setSectionResizeMode(i, header->Stretch);
     }
-}
-
-QList<QStandardItem *> CoordinatePanel::createTargetPointRow(const QVector3D &pos) const {
-    editorTabs->setCurrentIndex(1);
-    auto xItem = new QStandardItem(QString().setNum(pos.x()));
-    auto yItem = new QStandardItem(QString().setNum(pos.y()));
-    auto zItem = new QStandardItem(QString().setNum(pos.z()));
-
-    QList<QStandardItem *>itemList{xItem, yItem, zItem};
-    for (auto item : itemList){
-        item->setFlags(item->flags() & ~Qt::ItemIsEditable);
-        item->setFlags(item->flags() & ~(Qt::ItemIsDropEnabled));
-    }
-    targetsTable->appendRow({xItem, yItem, zItem});
-    return itemList;
-}
-
-QList<QStandardItem *> CoordinatePanel::createWaypointRow(const QVector3D &pos) const {
-    editorTabs->setCurrentIndex(0);
-    auto xItem = new QStandardItem(QString().setNum(pos.x()));
-    auto yItem = new QStandardItem(QString().setNum(pos.y()));
-    auto zItem = new QStandardItem(QString().setNum(pos.z()));
-    QList<QStandardItem *>itemList{xItem, yItem, zItem};
-    for (auto item : itemList){
-        item->setFlags(item->flags() & ~(Qt::ItemIsDropEnabled));
-    }
-    waypointsTable->appendRow(itemList);
-    return itemList;
+    // rows are all one height, skips measuring every row on large missions
+    view->verticalHeader()->setSectionResizeMode(QHeaderView::Fixed);
 }
 
 void CoordinatePanel::addWaypoint(const QVector3D &pos, bool connectPrev) {
@@ -113,55 +74,49 @@ void CoordinatePanel::getWaypointLine() {
 
 
 Waypoint *CoordinatePanel::generateWaypoint(const QVector3D &pos, bool isTargetPoint) const {
-    QList<QStandardItem *> rowItems;
-    Waypoint *waypoint;
-
-    if (isTargetPoint) {
-        rowItems = createTargetPointRow(pos);
-        waypoint = new Waypoint(QPersistentModelIndex(targetsTable->indexFromItem(rowItems.at(0))));
-    } else {
-        rowItems = createWaypointRow(pos);
-        waypoint = new Waypoint(QPersistentModelIndex(waypointsTable->indexFromItem(rowItems.at(0))));
-    }
-
-    connect(waypoint->signals, &WayPointSignals::itemMoved, this, [=]() {
-        rowItems[0]->setText(QString().setNum(waypoint->x()));
-        rowItems[1]->setText(QString().setNum(waypoint->y()));
-        rowItems[2]->setText(QString().setNum(waypoint->z()));
-    });
+    return generateWaypoints({pos}, isTargetPoint).constFirst();
+}
 
-    rowItems.at(0)->setData(QVariant::fromValue((void *) waypoint));
-    return waypoint;
+QVector<Waypoint *> CoordinatePanel::generateWaypoints(const QVector<QVector3D> &points, bool isTargetPoint) const {
+    editorTabs->setCurrentIndex(isTargetPoint ? 1 : 0);
+    auto model = isTargetPoint ? targetsTable : waypointsTable;
+    auto first = model->appendPoints(points);
+
+    QVector<Waypoint *> created;
+    created.reserve(points.size());
+    for (int row = first; row < model->rowCount(); ++row) {
+        auto waypoint = new Waypoint(QPersistentModelIndex(model->index(row, WaypointTableModel::X)));
+        model->setWaypoint(row, waypoint);
+        auto updateRow = [model, waypoint]() {
+            model->setPoint(waypoint->index.row(), waypoint->coord());
+        };
+        connect(waypoint->signals, &WayPointSignals::itemMoved, model, updateRow);
+        connect(waypoint->signals, &WayPointSignals::zUpdated, model, updateRow);
+        created.append(waypoint);
+    }
+    return created;
 }
 
 Waypoint *CoordinatePanel::retrieveWaypoint(int row, bool fromTargets) const {
-    QStandardItem *leftItem;
     if (fromTargets)
-        leftItem = targetsTable->item(row, 0);
-    else
-        leftItem = waypointsTable->item(row, 0);
-
-    return static_cast<Waypoint *>(leftItem->data().value<void *>());
-
+        return targetsTable->waypoint(row);
+    return waypointsTable->waypoint(row);
 }
 
 
 void CoordinatePanel::selectWaypoint(const QItemSelection &selected, const QItemSelection &deselected) {
     if (auto focusedTable = dynamic_cast<QTableView *>(QApplication::focusWidget())) {
-        auto model = dynamic_cast<QStandardItemModel *>(focusedTable->model());
+        auto model = dynamic_cast<WaypointTableModel *>(focusedTable->model());
+        if (model == nullptr) return;
         for (auto index: selected.indexes()) {
-            if (index.column() == 0) {
-                auto item = model->itemFromIndex(index);
-                auto wp = static_cast<Waypoint *>(item->data().value<void *>());
-                wp->setSelected(true);
-            }
+            if (index.column() == 0)
+                if (auto wp = model->waypoint(index.row()))
+                    wp->setSelected(true);
         }
         for (auto index: deselected.indexes()) {
-            if (index.column() == 0) {
-                auto item = model->itemFromIndex(index);
-                auto wp = static_cast<Waypoint *>(item->data().value<void *>());
-                wp->setSelected(false);
-            }
+            if (index.column() == 0)
+                if (auto wp = model->waypoint(index.row()))
+                    wp->setSelected(false);
         }
     }
 }
@@ -7,9 +7,9 @@
 
 
 #include <QObject>
-#include <QStandardItemModel>
 #include <QTableView>
 #include <QPushButton>
+#include "waypointtablemodel.h"
 
 class Waypoint;
 
@@ -23,8 +23,8 @@ public:
                              QLineEdit *ui_coordLineEdit,
                              QTabWidget *ui_editorTabs);
 
-    QStandardItemModel *waypointsTable;
-    QStandardItemModel *targetsTable;
+    WaypointTableModel *waypointsTable;
+    WaypointTableModel *targetsTable;
 
     QTableView *waypointView;
     QTableView *targetView;
@@ -43,6 +43,9 @@ public Q_SLOTS:
     /// Creates row in table, and makes a new Waypoint graphics item
     Waypoint *generateWaypoint(const QVector3D &pos, bool isTargetPoint = false) const;
 
+    /// Creates the rows in a single insertion, and makes a Waypoint graphics item per row
+    QVector<Waypoint *> generateWaypoints(const QVector<QVector3D> &points, bool isTargetPoint = false) const;
+
     Waypoint *retrieveWaypoint(int row, bool fromTargets = false) const;
 
     /// Creates row in table and makes new Waypoint graphics item,
@@ -54,12 +57,7 @@ public Q_SLOTS:
     void getWaypointLine();
 
 private:
-    /// Creates the row for waypoint data
-    QList<QStandardItem *> createWaypointRow(const QVector3D &pos) const;
-
-    /// Creates the row for target point data
-    QList<QStandardItem *> createTargetPointRow(const QVector3D &pos) const;
-
+    void setupView(QTableView *view, WaypointTableModel *model);
 
 };
 
@@ -0,0 +1,445 @@
+//
+// Created by Nic on 08/06/2022.
+//
+
+#include "flightsimulator.h"
+#include "../flight_parameters/ImageCalculations.hpp"
+#include <QCheckBox>
+#include <QDialogButtonBox>
+#include <QDateTime>
+#include <QDir>
+#include <QDoubleSpinBox>
+#include <QFileDialog>
+#include <QFileInfo>
+#include <QFormLayout>
+#include <QHBoxLayout>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QLabel>
+#include <QLineEdit>
+#include <QPushButton>
+#include <QSpinBox>
+#include <QtConcurrent>
+#include <QtMath>
+#include <QDebug>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    /// Frames are written here first and renamed into the output folder once complete
+    const auto stagingDir = QLatin1String(".staging");
+
+    double percentile(QVector<double> values, double fraction) {
+        if (values.isEmpty())
+            return 0.0;
+        std::sort(values.begin(), values.end());
+        auto rank = qBound(0, qCeil(fraction * values.size()) - 1, int(values.size()) - 1);
+        return values.at(rank);
+    }
+
+    /// Clockwise from north, in image coordinates where y points down
+    double bearing(const QPointF &from, const QPointF &to) {
+        auto delta = to - from;
+        return qRadiansToDegrees(std::atan2(delta.x(), -delta.y()));
+    }
+}
+
+double SimulationParameters::blurPixels() const {
+    if (shutterSpeed <= 0 or frameGsd <= 0)
+        return 0.0;
+    return image::motionBlur::pixels(flightSpeed, shutterSpeed, frameGsd);
+}
+
+FlightSimulator::FlightSimulator(QObject *parent) :
+        QObject(parent),
+        nextFrame(0),
+        failures(0),
+        lastLocalisedMs(0) {
+    connect(&timer, &QTimer::timeout, this, &FlightSimulator::step);
+    connect(&renderWatcher, &QFutureWatcher<SimulatedFrame>::finished, this, &FlightSimulator::frameRendered);
+}
+
+QVector<QPointF> FlightSimulator::samplePath(const QVector<QPointF> &waypoints, double spacing, QVector<double> *headings) {
+    QVector<QPointF> samples;
+    if (waypoints.size() < 2 or spacing <= 0)
+        return samples;
+    // distance still to fly before the next sample
+    double toNext = 0.0;
+    for (int i = 1; i < waypoints.size(); ++i) {
+        auto from = waypoints.at(i - 1), to = waypoints.at(i);
+        auto length = std::hypot(to.x() - from.x(), to.y() - from.y());
+        if (length <= 0)
+            continue;
+        auto heading = bearing(from, to);
+        for (auto along = toNext; along <= length; along += spacing) {
+            samples.append(from + (to - from) * (along / length));
+            if (headings)
+                headings->append(heading);
+        }
+        toNext = length < toNext ? toNext - length : spacing - std::fmod(length - toNext, spacing);
+    }
+    return samples;
+}
+
+cv::Mat FlightSimulator::renderFrame(const cv::Mat &baseMap, const QPointF &centre, double heading,
+                                     double flightDirection, const SimulationParameters &parameters, cv::RNG &rng) {
+    auto w = parameters.frameSize.width(), h = parameters.frameSize.height();
+    // base map pixels per frame pixel
+    auto scale = parameters.frameGsd / parameters.baseMapGsd;
+    auto theta = qDegreesToRadians(heading);
+    auto c = scale * std::cos(theta), s = scale * std::sin(theta);
+
+    // frame to base map, the top of the frame points along the heading
+    cv::Matx23d frameToMap(c, -s, centre.x() - (c * w / 2.0 - s * h / 2.0),
+                           s, c, centre.y() - (s * w / 2.0 + c * h / 2.0));
+    cv::Mat frame;
+    // warpAffine has no area filter, so a coarser frame is area averaged from its footprint first and then
+    // only rotated. Clipped sides of the footprint are the map's edges, which the warp reflects as before.
+    auto radius = 0.5 * scale * std::hypot(w, h) + 2.0 * scale;
+    auto footprint = cv::Rect(cvFloor(centre.x() - radius), cvFloor(centre.y() - radius),
+                              cvCeil(2.0 * radius) + 1, cvCeil(2.0 * radius) + 1)
+                     & cv::Rect(0, 0, baseMap.cols, baseMap.rows);
+    if (scale > 1.0 and footprint.width > scale and footprint.height > scale) {
+        cv::Mat ground;
+        cv::resize(baseMap(footprint), ground, cv::Size(), 1.0 / scale, 1.0 / scale, cv::INTER_AREA);
+        // map pixel to ground pixel, as resize places the pixel centres
+        auto sx = double(footprint.width) / ground.cols, sy = double(footprint.height) / ground.rows;
+        cv::Matx23d frameToGround(
+                frameToMap(0, 0) / sx, frameToMap(0, 1) / sx, (frameToMap(0, 2) - footprint.x + 0.5) / sx - 0.5,
+                frameToMap(1, 0) / sy, frameToMap(1, 1) / sy, (frameToMap(1, 2) - footprint.y + 0.5) / sy - 0.5);
+        cv::warpAffine(ground, frame, frameToGround, cv::Size(w, h),
+                       cv::INTER_LINEAR | cv::WARP_INVERSE_MAP, cv::BORDER_REFLECT);
+    } else
+        cv::warpAffine(baseMap, frame, frameToMap, cv::Size(w, h),
+                       cv::INTER_LINEAR | cv::WARP_INVERSE_MAP, cv::BORDER_REFLECT);
+
+    // exposure smears the ground along the direction of flight as seen in the frame
+    auto blur = parameters.blurPixels();
+    if (blur >= 1.0) {
+        auto size = 2 * qCeil(blur / 2.0) + 1;
+        auto direction = qDegreesToRadians(flightDirection - heading);
+        auto dx = 0.5 * blur * std::sin(direction), dy = -0.5 * blur * std::cos(direction);
+        cv::Mat kernel = cv::Mat::zeros(size, size, CV_32F);
+        auto mid = size / 2;
+        cv::line(kernel, cv::Point(qRound(mid - dx), qRound(mid - dy)), cv::Point(qRound(mid + dx), qRound(mid + dy)),
+                 cv::Scalar(1.0), 1, cv::LINE_AA);
+        kernel /= cv::sum(kernel)[0];
+        cv::filter2D(frame, frame, -1, kernel, cv::Point(-1, -1), 0, cv::BORDER_REFLECT);
+    }
+
+    if (parameters.gain == 1.0 and parameters.bias == 0.0 and parameters.noiseSigma <= 0)
+        return frame;
+    cv::Mat radiance;
+    frame.convertTo(radiance, CV_32F, parameters.gain, parameters.bias);
+    if (parameters.noiseSigma > 0) {
+        cv::Mat noise(radiance.size(), radiance.type());
+        rng.fill(noise, cv::RNG::NORMAL, 0.0, parameters.noiseSigma);
+        radiance += noise;
+    }
+    radiance.convertTo(frame, CV_8U);
+    return frame;
+}
+
+bool FlightSimulator::isRunning() const {
+    return not baseMap.empty() and nextFrame < centres.size();
+}
+
+int FlightSimulator::framesLeft() const {
+    return qMax(0, int(centres.size()) - nextFrame);
+}
+
+std::optional<QPointF> FlightSimulator::priorFor(const QString &filePath) const {
+    auto frame = frames.constFind(QFileInfo(filePath).absoluteFilePath());
+    if (frame == frames.constEnd())
+        return std::nullopt;
+    return frame->prior;
+}
+
+bool FlightSimulator::start(const QString &baseMapPath, const QVector<QPointF> &waypoints,
+                            const SimulationParameters &parameters) {
+    stop();
+    if (parameters.baseMapGsd <= 0 or parameters.frameGsd <= 0 or parameters.frameSize.isEmpty()) {
+        qWarning() << "Simulation needs positive ground sample distances and frame size";
+        return false;
+    }
+    QDir output(parameters.outputDir);
+    if (parameters.outputDir.isEmpty() or not output.mkpath(stagingDir)) {
+        qWarning() << "Could not create simulation output folder" << parameters.outputDir;
+        return false;
+    }
+    baseMap = cv::imread(baseMapPath.toStdString(), cv::IMREAD_COLOR);
+    if (baseMap.empty()) {
+        qWarning() << "Could not read base map" << baseMapPath;
+        return false;
+    }
+
+    params = parameters;
+    headings.clear();
+    centres = samplePath(waypoints, params.spacing, &headings);
+    if (centres.isEmpty()) {
+        qWarning() << "Waypoint path too short to simulate";
+        baseMap.release();
+        return false;
+    }
+    nextFrame = 0;
+    rng = cv::RNG(params.seed);
+    frames.clear();
+    errors.clear();
+    latencies.clear();
+    ingestDelays.clear();
+    runPrefix = QDateTime::currentDateTime().toString(QLatin1String("yyyyMMdd_HHmmss"));
+    failures = 0;
+    lastLocalisedMs = 0;
+
+    groundTruth.setFileName(output.filePath(QLatin1String("ground_truth.csv")));
+    if (groundTruth.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text))
+        groundTruth.write("file,x,y,heading,prior_x,prior_y\n");
+    else
+        qWarning() << "Could not write" << groundTruth.fileName();
+
+    qInfo() << "Simulating" << centres.size() << "frames of" << params.frameSize << "at"
+            << params.frameGsd << "cm/px, blur" << params.blurPixels() << "px";
+    clock.start();
+    if (params.rate > 0) {
+        timer.start(qMax(1, qRound(1000.0 / params.rate)));
+        step();
+    }
+    return true;
+}
+
+void FlightSimulator::stop() {
+    timer.stop();
+    renderWatcher.waitForFinished();
+    if (groundTruth.isOpen())
+        groundTruth.close();
+    if (not baseMap.empty() and nextFrame > 0)
+        reportSummary();
+    baseMap.release();
+    centres.clear();
+    nextFrame = 0;
+}
+
+void FlightSimulator::step() {
+    if (not isRunning())
+        return;
+    // a slow render drops ticks rather than queueing them
+    if (renderWatcher.isRunning())
+        return;
+
+    auto index = nextFrame++;
+    auto heading = params.followPath ? headings.at(index) + params.headingOffset : params.headingOffset;
+    auto stagingPath = QDir(params.outputDir).filePath(
+            QString("%1/sim_%2_%3.jpg").arg(stagingDir, runPrefix).arg(index, 5, 10, QChar('0')));
+    // rng is only touched by the one render in flight
+    renderWatcher.setFuture(QtConcurrent::run([this, index, heading, stagingPath]() {
+        SimulatedFrame frame;
+        frame.index = index;
+        frame.truth = centres.at(index);
+        frame.heading = heading;
+        frame.prior = frame.truth;
+        if (params.priorError > 0)
+            frame.prior += QPointF(rng.gaussian(params.priorError), rng.gaussian(params.priorError));
+        auto image = renderFrame(baseMap, frame.truth, heading, headings.at(index), params, rng);
+        if (cv::imwrite(stagingPath.toStdString(), image, {cv::IMWRITE_JPEG_QUALITY, 95}))
+            frame.filePath = stagingPath;
+        return frame;
+    }));
+}
+
+void FlightSimulator::frameRendered() {
+    auto frame = renderWatcher.result();
+    if (frame.filePath.isEmpty()) {
+        qWarning() << "Could not write simulated frame" << frame.index;
+    } else {
+        // renamed in one step, so the watched folder never shows a partial frame
+        auto finalPath = QDir(params.outputDir).absoluteFilePath(QFileInfo(frame.filePath).fileName());
+        QFile::remove(finalPath);
+        if (QFile::rename(frame.filePath, finalPath)) {
+            frame.filePath = finalPath;
+            frame.writtenMs = clock.elapsed();
+            frames.insert(finalPath, frame);
+            if (groundTruth.isOpen())
+                groundTruth.write(QString("%1,%2,%3,%4,%5,%6\n")
+                                          .arg(QFileInfo(finalPath).fileName())
+                                          .arg(frame.truth.x()).arg(frame.truth.y()).arg(frame.heading)
+                                          .arg(frame.prior.x()).arg(frame.prior.y()).toUtf8());
+            Q_EMIT frameReady(finalPath, frame.prior, frame.truth);
+        } else {
+            qWarning() << "Could not move" << frame.filePath << "to" << finalPath;
+        }
+    }
+    if (nextFrame >= centres.size()) {
+        timer.stop();
+        if (groundTruth.isOpen())
+            groundTruth.close();
+        Q_EMIT finished();
+    }
+}
+
+void FlightSimulator::recordSubmitted(const QString &filePath) {
+    auto frame = frames.find(QFileInfo(filePath).absoluteFilePath());
+    if (frame == frames.end() or frame->submittedMs >= 0)
+        return;
+    frame->submittedMs = clock.elapsed();
+    ingestDelays.append(double(frame->submittedMs - frame->writtenMs));
+}
+
+void FlightSimulator::recordLocalisation(const QString &filePath, const QPointF &position, double confidence) {
+    auto frame = frames.constFind(QFileInfo(filePath).absoluteFilePath());
+    if (frame == frames.constEnd())
+        return;
+    lastLocalisedMs = clock.elapsed();
+    // matching latency, the wait for the watched folder to settle is reported as the ingest delay
+    latencies.append(double(lastLocalisedMs - (frame->submittedMs >= 0 ? frame->submittedMs : frame->writtenMs)));
+    auto error = std::hypot(position.x() - frame->truth.x(), position.y() - frame->truth.y());
+    if (error > failureDistance)
+        failures += 1;
+    else
+        errors.append(error);
+    qInfo() << "Simulated frame" << frame->index << "error" << error << "px, confidence" << confidence
+            << "latency" << latencies.last() << "ms";
+    // every frame is in, the run can be scored without waiting for stop()
+    if (not isRunning() and latencies.size() == frames.size())
+        reportSummary();
+}
+
+void FlightSimulator::reportSummary() {
+    auto localised = int(latencies.size());
+    double rms = 0.0;
+    for (auto error: errors)
+        rms += error * error;
+    rms = errors.isEmpty() ? 0.0 : std::sqrt(rms / errors.size());
+    auto seconds = lastLocalisedMs / 1000.0;
+
+    QJsonObject summary;
+    summary[QLatin1String("frames")] = frames.size();
+    summary[QLatin1String("localised")] = localised;
+    summary[QLatin1String("matches_per_second")] = seconds > 0 ? localised / seconds : 0.0;
+    summary[QLatin1String("latency_p50_ms")] = percentile(latencies, 0.50);
+    summary[QLatin1String("latency_p95_ms")] = percentile(latencies, 0.95);
+    summary[QLatin1String("latency_p99_ms")] = percentile(latencies, 0.99);
+    summary[QLatin1String("ingest_p50_ms")] = percentile(ingestDelays, 0.50);
+    summary[QLatin1String("ingest_p95_ms")] = percentile(ingestDelays, 0.95);
+    summary[QLatin1String("rms_error_px")] = rms;
+    summary[QLatin1String("failure_rate")] = localised > 0 ? double(failures) / localised : 0.0;
+    summary[QLatin1String("frame_gsd_cm")] = params.frameGsd;
+    summary[QLatin1String("blur_px")] = params.blurPixels();
+    summary[QLatin1String("noise_sigma")] = params.noiseSigma;
+
+    qInfo() << "Simulation summary" << summary;
+    QFile file(QDir(params.outputDir).filePath(QLatin1String("summary.json")));
+    if (file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        file.write(QJsonDocument(summary).toJson());
+    else
+        qWarning() << "Could not write" << file.fileName();
+}
+
+SimulationDialog::SimulationDialog(const SimulationParameters &defaults, QWidget *parent) :
+        QDialog(parent),
+        outputDir(new QLineEdit(defaults.outputDir)),
+        frameWidth(new QSpinBox()),
+        frameHeight(new QSpinBox()),
+        baseMapGsd(new QDoubleSpinBox()),
+        frameGsd(new QDoubleSpinBox()),
+        spacing(new QDoubleSpinBox()),
+        rate(new QDoubleSpinBox()),
+        followPath(new QCheckBox()),
+        headingOffset(new QDoubleSpinBox()),
+        flightSpeed(new QDoubleSpinBox()),
+        shutterSpeed(new QSpinBox()),
+        noiseSigma(new QDoubleSpinBox()),
+        gain(new QDoubleSpinBox()),
+        bias(new QDoubleSpinBox()),
+        priorError(new QDoubleSpinBox()),
+        directFeed(new QCheckBox()) {
+    setWindowModality(Qt::ApplicationModal);
+    setWindowTitle(QLatin1String("Simulate Flight Images"));
+    auto form = new QFormLayout();
+
+    auto outputLayout = new QHBoxLayout();
+    auto outputSelect = new QPushButton(QLatin1String("Select"));
+    connect(outputSelect, &QPushButton::released,
+            this, [this]() {
+                auto dir = QFileDialog::getExistingDirectory(parentWidget(), QLatin1String("Output Folder"),
+                                                             outputDir->text());
+                if (not dir.isEmpty())
+                    outputDir->setText(dir);
+            });
+    outputLayout->addWidget(outputDir);
+    outputLayout->addWidget(outputSelect);
+    form->addRow(QLatin1String("Output Folder:"), outputLayout);
+
+    auto sizeLayout = new QHBoxLayout();
+    frameWidth->setRange(16, 8192);
+    frameWidth->setValue(defaults.frameSize.width());
+    frameHeight->setRange(16, 8192);
+    frameHeight->setValue(defaults.frameSize.height());
+    sizeLayout->addWidget(frameWidth);
+    sizeLayout->addWidget(new QLabel(QLatin1String("x")));
+    sizeLayout->addWidget(frameHeight);
+    form->addRow(QLatin1String("Frame Size:"), sizeLayout);
+
+    auto setup = [](QDoubleSpinBox *box, double min, double max, double value, const QString &suffix) {
+        box->setRange(min, max);
+        box->setValue(value);
+        box->setSuffix(suffix);
+    };
+    setup(baseMapGsd, 0.1, 1000, defaults.baseMapGsd, QLatin1String(" cm/px"));
+    setup(frameGsd, 0.1, 1000, defaults.frameGsd, QLatin1String(" cm/px"));
+    setup(spacing, 1, 10000, defaults.spacing, QLatin1String(" px"));
+    setup(rate, 0, 100, defaults.rate, QLatin1String(" fps"));
+    setup(headingOffset, -360, 360, defaults.headingOffset, QLatin1String(" °"));
+    setup(flightSpeed, 0, 100, defaults.flightSpeed, QLatin1String(" m/s"));
+    setup(noiseSigma, 0, 100, defaults.noiseSigma, QString());
+    setup(gain, 0.1, 4, defaults.gain, QString());
+    setup(bias, -128, 128, defaults.bias, QString());
+    setup(priorError, 0, 1000, defaults.priorError, QLatin1String(" px"));
+    rate->setSpecialValueText(QLatin1String("Manual"));
+    shutterSpeed->setRange(1, 32000);
+    shutterSpeed->setValue(defaults.shutterSpeed);
+    shutterSpeed->setPrefix(QLatin1String("1/"));
+    followPath->setChecked(defaults.followPath);
+    directFeed->setChecked(defaults.directFeed);
+
+    form->addRow(QLatin1String("Base Map GSD:"), baseMapGsd);
+    form->addRow(QLatin1String("Frame GSD:"), frameGsd);
+    form->addRow(QLatin1String("Frame Spacing:"), spacing);
+    form->addRow(QLatin1String("Rate:"), rate);
+    form->addRow(QLatin1String("Heading Follows Path:"), followPath);
+    form->addRow(QLatin1String("Heading Offset:"), headingOffset);
+    form->addRow(QLatin1String("Flight Speed:"), flightSpeed);
+    form->addRow(QLatin1String("Shutter Speed:"), shutterSpeed);
+    form->addRow(QLatin1String("Noise Sigma:"), noiseSigma);
+    form->addRow(QLatin1String("Gain:"), gain);
+    form->addRow(QLatin1String("Bias:"), bias);
+    form->addRow(QLatin1String("Prior Error:"), priorError);
+    form->addRow(QLatin1String("Feed Matcher Directly:"), directFeed);
+
+    auto buttons = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel);
+    connect(buttons, &QDialogButtonBox::accepted, this, &QDialog::accept);
+    connect(buttons, &QDialogButtonBox::rejected, this, &QDialog::reject);
+    form->addRow(buttons);
+    setLayout(form);
+}
+
+SimulationParameters SimulationDialog::parameters() const {
+    SimulationParameters parameters;
+    parameters.outputDir = outputDir->text();
+    parameters.frameSize = QSize(frameWidth->value(), frameHeight->value());
+    parameters.baseMapGsd = baseMapGsd->value();
+    parameters.frameGsd = frameGsd->value();
+    parameters.spacing = spacing->value();
+    parameters.rate = rate->value();
+    parameters.followPath = followPath->isChecked();
+    parameters.headingOffset = headingOffset->value();
+    parameters.flightSpeed = flightSpeed->value();
+    parameters.shutterSpeed = shutterSpeed->value();
+    parameters.noiseSigma = noiseSigma->value();
+    parameters.gain = gain->value();
+    parameters.bias = bias->value();
+    parameters.priorError = priorError->value();
+    parameters.directFeed = directFeed->isChecked();
+    return parameters;
+}
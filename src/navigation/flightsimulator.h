@@ -0,0 +1,172 @@
+//
+// Created by Nic on 08/06/2022.
+//
+
+#ifndef REALTIME3D_FLIGHTSIMULATOR_H
+#define REALTIME3D_FLIGHTSIMULATOR_H
+
+
+#include <QObject>
+#include <QDialog>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QFutureWatcher>
+#include <QFile>
+#include <QHash>
+#include <QPointF>
+#include <QSize>
+#include <opencv2/core.hpp>
+#include <optional>
+
+class QSpinBox;
+
+class QDoubleSpinBox;
+
+class QCheckBox;
+
+class QLineEdit;
+
+struct SimulationParameters {
+    QSize frameSize{550, 500};
+    /// Ground sample distances in cm per pixel, their ratio scales the base map into the frames
+    double baseMapGsd = 5.0;
+    double frameGsd = 5.0;
+    /// Base map pixels flown between frames
+    double spacing = 100.0;
+    /// Frames per second, 0 only renders frames on step()
+    double rate = 1.0;
+    /// Rotates the frames with the direction of flight, otherwise frames are north up
+    bool followPath = false;
+    /// Degrees clockwise added to the heading
+    double headingOffset = 0.0;
+    double flightSpeed = 15.0;
+    /// Denominator of the exposure time
+    int shutterSpeed = 1000;
+    /// Standard deviation of the sensor noise in grey levels
+    double noiseSigma = 2.0;
+    /// Illumination change, value * gain + bias
+    double gain = 1.0;
+    double bias = 0.0;
+    /// Standard deviation in pixels of the prior given with each frame
+    double priorError = 0.0;
+    /// Frames go straight to the matcher with their prior, instead of only through the watched folder
+    bool directFeed = false;
+    QString outputDir;
+    quint64 seed = 1;
+
+    /// Motion blur length in frame pixels
+    [[nodiscard]] double blurPixels() const;
+};
+
+struct SimulatedFrame {
+    int index = -1;
+    QString filePath;
+    QPointF truth;
+    QPointF prior;
+    double heading = 0.0;
+    /// Simulation clock when the frame became visible
+    qint64 writtenMs = 0;
+    /// Simulation clock when the frame was handed to the matcher, after the folder's settle delay
+    qint64 submittedMs = -1;
+};
+
+/// Renders synthetic flight frames from the base map along the waypoint path, with ground truth,
+/// and scores the localisations made from them for throughput, latency and accuracy.
+class FlightSimulator : public QObject {
+Q_OBJECT
+    SimulationParameters params;
+    cv::Mat baseMap;
+    QVector<QPointF> centres;
+    QVector<double> headings;
+    int nextFrame;
+    QTimer timer;
+    QElapsedTimer clock;
+    cv::RNG rng;
+    QFutureWatcher<SimulatedFrame> renderWatcher;
+    QHash<QString, SimulatedFrame> frames;
+    QFile groundTruth;
+    /// Frame names are unique per run, so a run into the folder of an earlier one is seen as new images
+    QString runPrefix;
+
+    QVector<double> errors;
+    QVector<double> latencies;
+    QVector<double> ingestDelays;
+    int failures;
+    qint64 lastLocalisedMs;
+
+    void frameRendered();
+
+public:
+    explicit FlightSimulator(QObject *parent = nullptr);
+
+    /// Localisations further than this from the truth count as failures, base map pixels
+    static constexpr double failureDistance = 30.0;
+
+    /// Frame centres every spacing pixels along the polyline, with the heading of their segment
+    static QVector<QPointF> samplePath(const QVector<QPointF> &waypoints, double spacing, QVector<double> *headings);
+
+    /// Renders the frame seen at centre, heading in degrees clockwise from north
+    static cv::Mat renderFrame(const cv::Mat &baseMap, const QPointF &centre, double heading,
+                               double flightDirection, const SimulationParameters &parameters, cv::RNG &rng);
+
+    [[nodiscard]] bool isRunning() const;
+
+    [[nodiscard]] int framesLeft() const;
+
+    /// Position given with a simulated frame, none for other images
+    [[nodiscard]] std::optional<QPointF> priorFor(const QString &filePath) const;
+
+Q_SIGNALS:
+
+    /// Frame written to disk, prior is the position given to the matcher
+    void frameReady(const QString &filePath, const QPointF &prior, const QPointF &truth);
+
+    void finished();
+
+public Q_SLOTS:
+
+    bool start(const QString &baseMapPath, const QVector<QPointF> &waypoints, const SimulationParameters &parameters);
+
+    void stop();
+
+    /// Renders the next frame, unless one is still rendering
+    void step();
+
+    /// Marks a frame as handed to the matcher, its latency is counted from here
+    void recordSubmitted(const QString &filePath);
+
+    /// Scores a localised frame against its ground truth
+    void recordLocalisation(const QString &filePath, const QPointF &position, double confidence);
+
+    /// Logs the scores and writes them to summary.json in the output folder
+    void reportSummary();
+
+};
+
+class SimulationDialog : public QDialog {
+Q_OBJECT
+    QLineEdit *outputDir;
+    QSpinBox *frameWidth;
+    QSpinBox *frameHeight;
+    QDoubleSpinBox *baseMapGsd;
+    QDoubleSpinBox *frameGsd;
+    QDoubleSpinBox *spacing;
+    QDoubleSpinBox *rate;
+    QCheckBox *followPath;
+    QDoubleSpinBox *headingOffset;
+    QDoubleSpinBox *flightSpeed;
+    QSpinBox *shutterSpeed;
+    QDoubleSpinBox *noiseSigma;
+    QDoubleSpinBox *gain;
+    QDoubleSpinBox *bias;
+    QDoubleSpinBox *priorError;
+    QCheckBox *directFeed;
+
+public:
+    explicit SimulationDialog(const SimulationParameters &defaults, QWidget *parent = nullptr);
+
+    [[nodiscard]] SimulationParameters parameters() const;
+};
+
+
+#endif //REALTIME3D_FLIGHTSIMULATOR_H
@@ -7,11 +7,19 @@
 #include <QAction>
 #include <QDebug>
 #include <QMessageBox>
-#include <QProgressDialog>
 #include "waypointer_io/images.hpp"
 #include <QApplication>
+#include <QtConcurrent>
+#include <QFutureWatcher>
+#include <QImageReader>
 #include "layerpanel.h"
+#include "flighttracker.h"
+#include "imageprocessing.h"
+#include "imagedirectoryindex.h"
+#include "flightsimulator.h"
+#include "waypointtablemodel.h"
 #include "../settings/path_settings/pathsettings.h"
+#include "../settings/navigation_settings/navigationsettings.h"
 #include "../utility/pyscriptcaller.h"
 
 
@@ -20,17 +28,24 @@ FlightTools::FlightTools(QWidget *parent,
                          QAction *actionSimulateImage,
                          QAction *actionSimulateFlightImages,
                          QAction *actionConnectToCamera,
+                         QAction *actionTrackingMode,
                          QStatusBar *ui_statusBar,
                          QTabWidget *ui_editorTabs,
                          Workspace *parent_workspace,
                          LayerPanel *parent_layerPanel) :
         QObject(parent),
+        statusBar(ui_statusBar),
         workspace(parent_workspace),
         layerPanel(parent_layerPanel),
         editorTabs(ui_editorTabs),
+        tracker(new FlightTracker(this)),
+        trackingMode(false),
         imageCount(0),
+        groundSampleDistance(0.0),
         imagesDirLabel(new QLabel("None")),
-        watcher(new QFileSystemWatcher(this)),
+        imageIndex(new ImageDirectoryIndex(NameFilters(), this)),
+        simulator(new FlightSimulator(this)),
+        simulationDirect(false),
         imageDirIsSet(false) {
 
     connect(actionImageViewMatching, &QAction::triggered,
@@ -39,6 +54,13 @@ FlightTools::FlightTools(QWidget *parent,
     connect(actionConnectToCamera, &QAction::triggered,
             this, &FlightTools::connectToCamera);
 
+    connect(actionTrackingMode, &QAction::toggled,
+            this, &FlightTools::setTrackingMode);
+    connect(workspace->systemViewer, &SystemViewer::photoLocalised,
+            this, &FlightTools::handleLocalised);
+    connect(tracker, &FlightTracker::trackLost,
+            this, []() { qWarning() << "Tracking lost, search window at maximum"; });
+
     connect(actionSimulateFlightImages, &QAction::triggered,
             this, [this]() { simulateFlightImages(); });
     connect(actionSimulateImage, &QAction::triggered,
@@ -47,10 +69,24 @@ FlightTools::FlightTools(QWidget *parent,
     ui_statusBar->addPermanentWidget(new QLabel(QLatin1String("Folder Watched")));
     ui_statusBar->addPermanentWidget(imagesDirLabel);
 
-    connect(watcher, &QFileSystemWatcher::fileChanged,
-            this, &FlightTools::fn_fileChanged);
-    connect(watcher, &QFileSystemWatcher::directoryChanged,
-            this, &FlightTools::fn_DirChanged);
+    // every new image is queued for localisation in capture order
+    connect(imageIndex, &ImageDirectoryIndex::imageAdded,
+            this, [this](const QString &filePath) {
+                if (not imageDirIsSet)
+                    return;
+                if (auto prior = simulator->priorFor(filePath))
+                    addFlightImage(filePath, qRound(prior->x()), qRound(prior->y()));
+                else
+                    addFlightImage(filePath, 0, 0);
+            });
+
+    connect(simulator, &FlightSimulator::frameReady,
+            this, [this](const QString &filePath, const QPointF &prior) {
+                if (simulationDirect)
+                    addFlightImage(filePath, qRound(prior.x()), qRound(prior.y()));
+            });
+    connect(simulator, &FlightSimulator::finished,
+            this, [this]() { statusBar->showMessage(QLatin1String("Flight simulation complete."), 3000); });
 
 }
 
@@ -65,29 +101,8 @@ QStringList FlightTools::NameFilters() {
             QStringLiteral("*.ARW")};
 }
 
-void FlightTools::fn_fileChanged(const QString &path) {
-//    qDebug() << "file changed:" << path;
-}
-
-void FlightTools::fn_DirChanged(const QString &path) {
-    if (not QFileInfo::exists(path)) return;
-    qInfo() << "Change in folder:" << path;
-    if (imageDirIsSet) {
-        auto imagesDir = QDir(imagesDirectory);
-        imagesDir.setNameFilters(NameFilters());
-        imagesDir.setSorting(QDir::Time);
-        auto files = imagesDir.entryList();
-        if (files.isEmpty()) return;
-        auto newImage = imagesDir.filePath(files.at(0));
-        addFlightImage(newImage, 0, 0);
-    }
-}
-
 bool FlightTools::baseMapItemOk() {
-    auto basePixmap = layerPanel->currentBaseMap->pixmap();
-    if (basePixmap.isNull())
-        return false;
-    return true;
+    return layerPanel->currentBaseMap->hasImage();
 }
 
 bool FlightTools::imageDirSet() const {
@@ -96,8 +111,52 @@ bool FlightTools::imageDirSet() const {
     return true;
 }
 
+QVector<QPointF> FlightTools::waypointPath() const {
+    QVector<QPointF> path;
+    auto waypointView = parent()->findChild<QTableView *>("waypointView");
+    auto waypointModel = dynamic_cast<WaypointTableModel *>(waypointView->model());
+    if (waypointModel == nullptr)
+        return path;
+    path.reserve(waypointModel->rowCount());
+    for (int row = 0; row < waypointModel->rowCount(); ++row)
+        path.append(QPointF(waypointModel->x(row), waypointModel->y(row)));
+    return path;
+}
+
 void FlightTools::simulateFlightImages(int w, int h) {
-    // extra
+    if (not baseMapItemOk()) {
+        QMessageBox::warning(dynamic_cast<QWidget *>(parent()),
+                             "Warning", "Base map must be set.", QMessageBox::Ok);
+        return;
+    }
+    auto path = waypointPath();
+    if (path.size() < 2) {
+        QMessageBox::warning(dynamic_cast<QWidget *>(parent()),
+                             "Warning", "At least two waypoints are needed to fly.", QMessageBox::Ok);
+        return;
+    }
+
+    SimulationParameters defaults;
+    defaults.frameSize = QSize(w, h);
+    defaults.outputDir = QDir(PathSettings::default_tigerOutputDir()).filePath("SimulatedFlight");
+    if (groundSampleDistance > 0)
+        defaults.frameGsd = defaults.baseMapGsd = 100 * groundSampleDistance;
+    SimulationDialog dialog(defaults, dynamic_cast<QWidget *>(parent()));
+    if (dialog.exec() != QDialog::Accepted)
+        return;
+    auto parameters = dialog.parameters();
+
+    // frames already in the folder from an earlier run are indexed before the new ones are written
+    simulationDirect = parameters.directFeed;
+    if (simulationDirect)
+        imageIndex->stopWatch();
+    else if (QDir().mkpath(parameters.outputDir))
+        watchDirectory(parameters.outputDir);
+    if (not simulator->start(layerPanel->currentBaseMap->imagePath, path, parameters)) {
+        statusBar->showMessage(QLatin1String("Flight simulation could not start."), 5000);
+        return;
+    }
+    statusBar->showMessage(QString("Simulating %1 frames...").arg(simulator->framesLeft()), 3000);
 }
 
 void FlightTools::addFlightImage(const QString &filePath, int xPos, int yPos) {
@@ -106,37 +165,55 @@ void FlightTools::addFlightImage(const QString &filePath, int xPos, int yPos) {
                              "Warning", "Base map must be set.", QMessageBox::Ok);
         return;
     }
-    auto [flightImage, imageFilePath] = waypointer::io::readPhoto(filePath);
-    if (not flightImage.isNull()) {
+    auto imageFilePath = waypointer::io::photoPath(filePath);
+    if (QImageReader(imageFilePath).canRead()) {
         editorTabs->setCurrentIndex(1);
         if (layerPanel->targetLayer == nullptr)
             layerPanel->targetLayer = layerPanel->addLayer("Target Points Layer");
 
-        if (xPos == 0 or yPos == 0) {
+        int searchWindow = FlightTracker::minWindow + 2 * FlightTracker::searchStep;
+        if (trackingMode and tracker->isTracking() and xPos == 0 and yPos == 0) {
+            // the track only advances when a match is applied, frames still being matched come first
+            auto frames = workspace->systemViewer->localisationsInFlight() + 1;
+            auto predicted = tracker->predicted(frames).toPoint();
+            xPos = predicted.x();
+            yPos = predicted.y();
+            searchWindow = tracker->searchWindow(frames);
+        } else if (xPos == 0 or yPos == 0) {
             // get waypoints
             auto current_idx = layerPanel->targetLayer->rowCount();
             auto waypointView = parent()->findChild<QTableView *>("waypointView");
-            auto waypointModel = dynamic_cast<QStandardItemModel *>(waypointView->model());
-            QStandardItem *item;
-            if (xPos == 0) {
-                item = waypointModel->item(current_idx, 0);
-                xPos = item->data(Qt::DisplayRole).toInt();
+            auto waypointModel = dynamic_cast<WaypointTableModel *>(waypointView->model());
+            // images past the last waypoint take its position as their prior
+            if (waypointModel != nullptr and waypointModel->rowCount() > 0) {
+                auto row = qMin(current_idx, waypointModel->rowCount() - 1);
+                if (xPos == 0)
+                    xPos = qRound(waypointModel->x(row));
+                if (yPos == 0)
+                    yPos = qRound(waypointModel->y(row));
             }
-            if (yPos == 0) {
-                item = waypointModel->item(current_idx, 1);
-                yPos = item->data(Qt::DisplayRole).toInt();
-            }
-            auto z = waypointModel->item(current_idx, 2);
         }
 
         auto imageItem = layerPanel->addItemToLayer(layerPanel->targetLayer, filePath);
         auto imageItemData = LayerPanel::getLayerData(imageItem);
         // extra: maker function to add image and path at once to both layers and scene
-        imageItemData->setImage(flightImage);
-        imageItemData->imagePath = imageFilePath;
+        // only a thumbnail stays in memory, full resolution tiles are decoded when zoomed in
+        imageItemData->setTiledImage(imageFilePath);
+
+        // coarse to fine search when the prior is too uncertain for the search window
+        int searchRadius = 0;
+        if (NavigationSettings::getPyramidSearch() or (trackingMode and tracker->isLost())) {
+            if (groundSampleDistance > 0)
+                searchRadius = qRound(NavigationSettings::getSearchRadius() / groundSampleDistance);
+            else
+                qWarning() << "Ground sample distance unknown, set the aircraft height and camera profile"
+                              " to use the coarse to fine search";
+        }
 
         auto position = QPoint(xPos, yPos);
-        workspace->systemViewer->addPhoto(imageItemData, position);
+        simulator->recordSubmitted(filePath);
+        workspace->systemViewer->addPhoto(imageItemData, position, true, searchWindow, searchRadius,
+                                          NavigationSettings::getMatcher());
 
         Q_EMIT layerPanel->layerModel->layoutChanged();
         imageCount += 1;
@@ -144,8 +221,7 @@ void FlightTools::addFlightImage(const QString &filePath, int xPos, int yPos) {
 }
 
 void FlightTools::imageViewMatching(const QString &imageFileName) {
-    auto basePixmap = layerPanel->currentBaseMap->pixmap();
-    if (basePixmap.isNull()) {
+    if (not baseMapItemOk()) {
         QMessageBox::warning(dynamic_cast<QWidget *>(parent()),
                              "Warning", "Base map must be set.", QMessageBox::Ok);
         return;
@@ -154,56 +230,50 @@ void FlightTools::imageViewMatching(const QString &imageFileName) {
     if (image.isNull())
         return;
 
-    auto progressDialog = QProgressDialog("Operation in progress.", nullptr, 0, 4,
-                                          dynamic_cast<QWidget *>(parent()));
-    progressDialog.setWindowModality(Qt::WindowModal);
-    progressDialog.show();
-    progressDialog.setValue(0);
-
-    progressDialog.setWindowTitle("Generating files...");
-    progressDialog.setValue(1);
-    QApplication::processEvents();
-
     auto matchingLayer = layerPanel->matchingLayer;
     auto obliqueImageItem = layerPanel->addItemToLayer(
             matchingLayer,
             QFileInfo(imageFilePath).fileName() + QLatin1String("(Oblique View)")
     );
     auto obliqueImageData = LayerPanel::getLayerData(obliqueImageItem);
-    obliqueImageData->setImage(imageFilePath, false);
+    obliqueImageData->setImage(image, false);
+    obliqueImageData->imagePath = imageFilePath;
     workspace->systemViewer->scene()->addItem(obliqueImageData->graphicsItem);
     workspace->systemViewer->fitInView();
     workspace->systemViewer->scene()->update();
-    progressDialog.setValue(2);
-    QApplication::processEvents();
-
-    progressDialog.setLabelText(QLatin1String("Performing perspective match..."));
-    QApplication::processEvents();
 
-    auto matchedImageItem = layerPanel->addItemToLayer(matchingLayer, "Matched Image");
-    auto matchedImageData = LayerPanel::getLayerData(matchedImageItem);
     if (outputDir.isNull() or outputDir.isEmpty())
         outputDir = QDir(PathSettings::default_tigerOutputDir()).filePath("PerspectiveMatches");
+    if (not imageMatcher)
+        imageMatcher = std::make_shared<ImageMatcher>(outputDir);
 
     auto baseImageFile = layerPanel->currentBaseMap->imagePath;
-
-    auto outImagePath = QString::fromStdString(pycall::perspectiveMatching(
-            outputDir.toStdString(),
-            baseImageFile.toStdString(),
-            imageFilePath.toStdString(),
-            false));
-
-    if (outImagePath.isEmpty() or outImagePath.isNull()) return;
-    matchedImageData->setImage(outImagePath, false);
-    workspace->systemViewer->scene()->addItem(matchedImageData->graphicsItem);
-    workspace->systemViewer->fitInView();
-
-    progressDialog.setValue(3);
-    QApplication::processEvents();
-
-    progressDialog.setLabelText("Complete.");
-    progressDialog.setValue(4);
-    QApplication::processEvents();
+    statusBar->showMessage(QLatin1String("Performing perspective match..."));
+
+    // matched on a worker, the result is applied to the layer back on the GUI thread
+    auto watcher = new QFutureWatcher<MatchResult>(this);
+    connect(watcher, &QFutureWatcher<MatchResult>::finished,
+            this, [this, watcher, imageFilePath]() {
+                watcher->deleteLater();
+                auto result = watcher->result();
+                if (not result.ok()) {
+                    statusBar->showMessage(result.error, 5000);
+                    return;
+                }
+                auto matchedImageItem = layerPanel->addItemToLayer(
+                        layerPanel->matchingLayer,
+                        QFileInfo(imageFilePath).fileName() + QLatin1String("(Matched Image)"));
+                auto matchedImageData = LayerPanel::getLayerData(matchedImageItem);
+                matchedImageData->setImage(result.image, false);
+                matchedImageData->homography = result.homography;
+                workspace->systemViewer->scene()->addItem(matchedImageData->graphicsItem);
+                workspace->systemViewer->fitInView();
+                Q_EMIT layerPanel->layerModel->layoutChanged();
+                statusBar->showMessage(QLatin1String("Perspective match complete."), 3000);
+            });
+    watcher->setFuture(QtConcurrent::run([matcher = imageMatcher, baseImageFile, imageFilePath]() {
+        return matcher->matchImages(baseImageFile, imageFilePath);
+    }));
 }
 
 void FlightTools::connectToCamera() {
@@ -214,15 +284,66 @@ void FlightTools::connectToCamera() {
                                                       "Open Directory",
                                                       startDir.absolutePath(),
                                                       QFileDialog::ShowDirsOnly | QFileDialog::DontResolveSymlinks);
-    if (not imageDir.isEmpty() and not imageDir.isNull()) {
-        imagesDirectory = imageDir;
-        imagesDirLabel->setText(imageDir);
-        watcher->addPath(imageDir);
-        imageDirIsSet = true;
+    if (not imageDir.isEmpty() and not imageDir.isNull())
+        watchDirectory(imageDir);
+}
+
+void FlightTools::watchDirectory(const QString &dir) {
+    imagesDirectory = dir;
+    imagesDirLabel->setText(dir);
+    imageIndex->setDirectory(dir);
+    imageDirIsSet = true;
+    prebuildWaypointCorridor();
+}
+
+void FlightTools::prebuildWaypointCorridor() {
+    if (not baseMapItemOk()) return;
+    auto waypointView = parent()->findChild<QTableView *>("waypointView");
+    auto waypointModel = dynamic_cast<WaypointTableModel *>(waypointView->model());
+    if (waypointModel == nullptr or waypointModel->rowCount() == 0) return;
+
+    std::vector<std::tuple<int, int>> points;
+    points.reserve(waypointModel->rowCount());
+    for (int row = 0; row < waypointModel->rowCount(); ++row)
+        points.emplace_back(qRound(waypointModel->x(row)), qRound(waypointModel->y(row)));
+
+    auto baseImageFile = layerPanel->currentBaseMap->imagePath.toStdString();
+    QtConcurrent::run([baseImageFile, points = std::move(points)]() {
+        auto blocks = pycall::prebuildTileBank(baseImageFile, points);
+        qInfo() << "Cached" << blocks << "base map blocks along waypoint corridor";
+    });
+}
+
+
+void FlightTools::setTrackingMode(bool enabled) {
+    trackingMode = enabled;
+    tracker->reset();
+    if (not enabled) return;
+
+    // replay the accepted target points so tracking picks up mid flight
+    auto targetView = parent()->findChild<QTableView *>("targetpointView");
+    auto targetModel = dynamic_cast<WaypointTableModel *>(targetView->model());
+    if (targetModel == nullptr) return;
+    for (int row = 0; row < targetModel->rowCount(); ++row) {
+        tracker->predict();
+        tracker->update(QPointF(targetModel->x(row), targetModel->y(row)), 1.0);
     }
 }
 
+void FlightTools::handleLocalised(LayerData *imageLayerData, const QPointF &position, double confidence) {
+    simulator->recordLocalisation(imageLayerData->imagePath, position, confidence);
+    if (not trackingMode) return;
+    // matches are applied in submission order, one predict and update per frame
+    tracker->predict();
+    if (tracker->update(position, confidence))
+        qInfo() << "Tracked" << QFileInfo(imageLayerData->imagePath).fileName()
+                << "at" << position << "next window" << tracker->searchWindow();
+}
 
 void FlightTools::addSimulatedImage() {
-    // extra
+    if (simulator->isRunning()) {
+        simulator->step();
+        return;
+    }
+    simulateFlightImages();
 }
@@ -7,25 +7,48 @@
 
 
 #include <QWidget>
-#include <QFileSystemWatcher>
 #include <QStatusBar>
 #include <QDir>
 #include <QLabel>
 #include <QTabWidget>
 #include <QPointer>
+#include <memory>
 
 class Workspace;
 
 class LayerPanel;
 
+class LayerData;
+
+class FlightTracker;
+
+class ImageMatcher;
+
+class ImageDirectoryIndex;
+
+class FlightSimulator;
+
 class FlightTools : public QObject {
     Q_OBJECT
     bool imageDirIsSet;
+    QStatusBar *statusBar;
     Workspace *workspace;
     LayerPanel *layerPanel;
-    QFileSystemWatcher *watcher;
+    ImageDirectoryIndex *imageIndex;
+    FlightSimulator *simulator;
+    /// simulated frames go straight to the matcher instead of through the watched folder
+    bool simulationDirect;
     QTabWidget *editorTabs;
+    FlightTracker *tracker;
+    bool trackingMode;
+    /// shared with running match jobs, keeps the base map features between matches
+    std::shared_ptr<ImageMatcher> imageMatcher;
+
+    /// Localises every new image in dir
+    void watchDirectory(const QString &dir);
 
+    /// Points of the waypoint table in flight order
+    [[nodiscard]] QVector<QPointF> waypointPath() const;
 
 public:
     explicit FlightTools(QWidget *parent,
@@ -33,6 +56,7 @@ public:
                          QAction *actionSimulateImage,
                          QAction *actionSimulateFlightImages,
                          QAction *actionConnectToCamera,
+                         QAction *actionTrackingMode,
                          QStatusBar *ui_statusBar,
                          QTabWidget *ui_editorTabs,
                          Workspace *parent_workspace,
@@ -44,12 +68,10 @@ public:
     QString imagesDirectory;
     QLabel *imagesDirLabel;
     QString outputDir;
+    /// Metres per pixel of the flight images, 0 if unknown
+    double groundSampleDistance;
 
 public Q_SLOTS:
-    static void fn_fileChanged(const QString& path);
-
-    void fn_DirChanged(const QString& path);
-
     bool baseMapItemOk();
 
     [[nodiscard]] bool imageDirSet() const;
@@ -60,8 +82,20 @@ public Q_SLOTS:
 
     void connectToCamera();
 
+    /// Caches the base map spectra along the planned waypoints on a worker thread,
+    /// so live matches only transform the flight image.
+    void prebuildWaypointCorridor();
+
+    /// Enables seeding matches from the motion model of the target points
+    void setTrackingMode(bool enabled);
+
+    /// Feeds a localised flight image into the tracker
+    void handleLocalised(LayerData *imageLayerData, const QPointF &position, double confidence);
+
 private Q_SLOTS:
+    /// Renders frames along the waypoints from the base map, with ground truth to score the localisation
     void simulateFlightImages(int w=550, int h=500);
+    /// Next frame of a manually stepped simulation
     void addSimulatedImage();
 
 
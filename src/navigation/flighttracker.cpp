@@ -0,0 +1,167 @@
+//
+// Created by Nic on 02/06/2022.
+//
+
+#include "flighttracker.h"
+#include <QDebug>
+#include <QtMath>
+
+namespace {
+    /// Initial velocity standard deviation, px per frame
+    constexpr double initialSpeedSigma = 50.0;
+    /// Chi-square 99.9% bound for 2 degrees of freedom
+    constexpr double innovationGate = 13.82;
+    constexpr int lostAfterMisses = 5;
+}
+
+FlightTracker::FlightTracker(QObject *parent) :
+        QObject(parent),
+        initialised(false),
+        misses(0),
+        minConfidence(0.08),
+        processNoise(10.0),
+        measurementNoise(3.0) {
+    reset();
+}
+
+void FlightTracker::reset() {
+    x.fill(0.0);
+    P.setToIdentity();
+    initialised = false;
+    misses = 0;
+}
+
+bool FlightTracker::isTracking() const {
+    return initialised;
+}
+
+QPointF FlightTracker::position() const {
+    return {x(0, 0), x(1, 0)};
+}
+
+QPointF FlightTracker::velocity() const {
+    return {x(2, 0), x(3, 0)};
+}
+
+int FlightTracker::missedFrames() const {
+    return misses;
+}
+
+bool FlightTracker::isLost() const {
+    return misses >= lostAfterMisses;
+}
+
+int FlightTracker::searchWindow() const {
+    return windowFor(P);
+}
+
+int FlightTracker::windowFor(const Covariance &covariance) const {
+    if (not initialised)
+        return minWindow + 2 * searchStep;
+    auto sigma = qSqrt(qMax(covariance(0, 0), covariance(1, 1)));
+    // 2 sigma either side of the prediction, in whole candidate steps
+    auto window = minWindow + qCeil(4 * sigma / searchStep) * searchStep;
+    return qBound(minWindow, window, maxWindow);
+}
+
+QPointF FlightTracker::predicted(int frames) const {
+    auto state = x;
+    auto covariance = P;
+    for (int frame = 0; initialised and frame < frames; ++frame)
+        propagate(state, covariance);
+    return {state(0, 0), state(1, 0)};
+}
+
+int FlightTracker::searchWindow(int frames) const {
+    auto state = x;
+    auto covariance = P;
+    for (int frame = 0; initialised and frame < frames; ++frame)
+        propagate(state, covariance);
+    return windowFor(covariance);
+}
+
+QPointF FlightTracker::predict() {
+    if (not initialised)
+        return position();
+    propagate(x, P);
+    return position();
+}
+
+void FlightTracker::propagate(State &state, Covariance &covariance) const {
+    Covariance F;
+    F(0, 2) = 1.0;
+    F(1, 3) = 1.0;
+
+    // white acceleration noise over one frame
+    auto q = processNoise * processNoise;
+    Covariance Q;
+    Q.fill(0.0);
+    for (int axis = 0; axis < 2; ++axis) {
+        Q(axis, axis) = 0.25 * q;
+        Q(axis, axis + 2) = 0.5 * q;
+        Q(axis + 2, axis) = 0.5 * q;
+        Q(axis + 2, axis + 2) = q;
+    }
+
+    state = F * state;
+    covariance = F * covariance * F.transposed() + Q;
+}
+
+bool FlightTracker::update(const QPointF &measured, double confidence) {
+    auto r = measurementNoise / qMax(confidence, minConfidence);
+    auto r2 = r * r;
+
+    if (isLost() and confidence >= minConfidence)
+        initialised = false;
+
+    if (not initialised) {
+        if (confidence < minConfidence)
+            return false;
+        x.fill(0.0);
+        x(0, 0) = measured.x();
+        x(1, 0) = measured.y();
+        P.fill(0.0);
+        P(0, 0) = P(1, 1) = r2;
+        P(2, 2) = P(3, 3) = initialSpeedSigma * initialSpeedSigma;
+        initialised = true;
+        misses = 0;
+        Q_EMIT trackUpdated(position(), searchWindow());
+        return true;
+    }
+
+    // innovation and its covariance, the measurement only observes position
+    double y0 = measured.x() - x(0, 0);
+    double y1 = measured.y() - x(1, 0);
+    double s00 = P(0, 0) + r2, s01 = P(0, 1), s10 = P(1, 0), s11 = P(1, 1) + r2;
+    double det = s00 * s11 - s01 * s10;
+    double i00 = s11 / det, i01 = -s01 / det, i10 = -s10 / det, i11 = s00 / det;
+    double d2 = y0 * (i00 * y0 + i01 * y1) + y1 * (i10 * y0 + i11 * y1);
+
+    if (confidence < minConfidence or d2 > innovationGate) {
+        misses += 1;
+        qInfo() << "Tracker rejected match" << measured << "confidence" << confidence << "distance" << qSqrt(d2);
+        if (misses == lostAfterMisses)
+            Q_EMIT trackLost();
+        return false;
+    }
+
+    // K = P H' S^-1, a 4x2 gain
+    double K[4][2];
+    for (int row = 0; row < 4; ++row) {
+        K[row][0] = P(row, 0) * i00 + P(row, 1) * i10;
+        K[row][1] = P(row, 0) * i01 + P(row, 1) * i11;
+    }
+    for (int row = 0; row < 4; ++row)
+        x(row, 0) += K[row][0] * y0 + K[row][1] * y1;
+
+    // P = (I - K H) P
+    Covariance updated = P;
+    for (int row = 0; row < 4; ++row)
+        for (int col = 0; col < 4; ++col)
+            updated(row, col) -= K[row][0] * P(0, col) + K[row][1] * P(1, col);
+    P = updated;
+
+    misses = 0;
+    Q_EMIT trackUpdated(position(), searchWindow());
+    return true;
+}
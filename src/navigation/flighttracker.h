@@ -0,0 +1,89 @@
+//
+// Created by Nic on 02/06/2022.
+//
+
+#ifndef REALTIME3D_FLIGHTTRACKER_H
+#define REALTIME3D_FLIGHTTRACKER_H
+
+
+#include <QObject>
+#include <QPointF>
+#include <QGenericMatrix>
+
+/// Constant velocity Kalman filter over the accepted target points, one step per flight image.
+/// Used to seed navigation matching and size its search window from the position uncertainty.
+class FlightTracker : public QObject {
+Q_OBJECT
+    using State = QGenericMatrix<1, 4, double>;
+    using Covariance = QGenericMatrix<4, 4, double>;
+
+    State x;
+    Covariance P;
+    bool initialised;
+    int misses;
+
+    /// Advances a state and its covariance by one frame
+    void propagate(State &state, Covariance &covariance) const;
+
+    [[nodiscard]] int windowFor(const Covariance &covariance) const;
+
+public:
+    explicit FlightTracker(QObject *parent = nullptr);
+
+    /// Side of the flight image block that is correlated against the base map
+    static constexpr int templateSize = 300;
+    /// Grid step of the correlation candidates
+    static constexpr int searchStep = 50;
+    static constexpr int minWindow = templateSize + searchStep;
+    static constexpr int maxWindow = 1500;
+
+    /// Matches with a correlation peak below this are not used to update the track
+    double minConfidence;
+    /// Acceleration noise, px per frame^2
+    double processNoise;
+    /// Position noise of a match with confidence 1, px
+    double measurementNoise;
+
+    [[nodiscard]] bool isTracking() const;
+
+    [[nodiscard]] QPointF position() const;
+
+    [[nodiscard]] QPointF velocity() const;
+
+    /// Number of consecutive frames without an accepted match
+    [[nodiscard]] int missedFrames() const;
+
+    /// Too many consecutive misses for the search window to cover the position uncertainty
+    [[nodiscard]] bool isLost() const;
+
+    /// Search window side in pixels covering 2 standard deviations either side of the predicted position
+    [[nodiscard]] int searchWindow() const;
+
+    /// Position the given number of frames ahead, on a copy of the state, for priors of frames whose
+    /// earlier frames are still being matched
+    [[nodiscard]] QPointF predicted(int frames) const;
+
+    /// Search window of the prediction the given number of frames ahead
+    [[nodiscard]] int searchWindow(int frames) const;
+
+Q_SIGNALS:
+
+    void trackUpdated(const QPointF &position, int searchWindow);
+
+    void trackLost();
+
+public Q_SLOTS:
+
+    void reset();
+
+    /// Advances the state by one frame and returns the predicted position
+    QPointF predict();
+
+    /// Corrects the state with a matched position, returns false if the match was rejected
+    /// for low confidence or for being too far from the prediction. Once lost, a confident match restarts the track.
+    bool update(const QPointF &measured, double confidence);
+
+};
+
+
+#endif //REALTIME3D_FLIGHTTRACKER_H
@@ -0,0 +1,153 @@
+//
+// Created by Nic on 04/06/2022.
+//
+
+#include "imagedirectoryindex.h"
+#include "../utility/DirectoryWatchdog.hpp"
+#include <QDir>
+#include <QFileInfo>
+#include <QDebug>
+#include <algorithm>
+
+ImageDirectoryIndex::ImageDirectoryIndex(const QStringList &nameFilters, QObject *parent) :
+        QObject(parent),
+        // filters may hold several space separated patterns each
+        nameFilters(QDir::nameFiltersFromString(nameFilters.join(QLatin1Char(' ')))),
+        fileWatcher(std::make_unique<efsw::FileWatcher>()),
+        listener(std::make_shared<UpdateListener>()),
+        watchId(0) {
+    settleTimer.setSingleShot(true);
+    settleTimer.setInterval(settleMs);
+    connect(&settleTimer, &QTimer::timeout,
+            this, &ImageDirectoryIndex::reportSettled);
+
+    // efsw reports from its own thread
+    auto fileEvent = [this](const QString &dir, const QString &filename, const QString &) {
+        handleFileEvent(dir, filename);
+    };
+    connect(&listener->listenerSignals, &ListenerSignals::fileAdded,
+            this, fileEvent, Qt::QueuedConnection);
+    connect(&listener->listenerSignals, &ListenerSignals::fileModified,
+            this, fileEvent, Qt::QueuedConnection);
+    connect(&listener->listenerSignals, &ListenerSignals::fileDeleted,
+            this, fileEvent, Qt::QueuedConnection);
+    // a rename is a removal of the old name
+    connect(&listener->listenerSignals, &ListenerSignals::fileMoved,
+            this, [this](const QString &dir, const QString &filename, const QString &oldFilename) {
+                if (not oldFilename.isEmpty())
+                    handleFileEvent(dir, oldFilename);
+                handleFileEvent(dir, filename);
+            }, Qt::QueuedConnection);
+}
+
+ImageDirectoryIndex::~ImageDirectoryIndex() {
+    stopWatch();
+}
+
+ImageDirectoryIndex::FileStamp ImageDirectoryIndex::stamp(const QString &filePath) {
+    auto info = QFileInfo(filePath);
+    return {info.size(), info.lastModified()};
+}
+
+QString ImageDirectoryIndex::watchedDirectory() const {
+    return directory;
+}
+
+int ImageDirectoryIndex::imageCount() const {
+    return static_cast<int>(seen.size());
+}
+
+void ImageDirectoryIndex::setDirectory(const QString &dir) {
+    stopWatch();
+    seen.clear();
+    settling.clear();
+    directory = dir;
+    if (not QFileInfo::exists(dir)) return;
+
+    // images present before the watch started are not flight images
+    auto entries = QDir(dir).entryInfoList(nameFilters, QDir::Files);
+    seen.reserve(static_cast<int>(entries.size()));
+    for (const auto &entry: entries)
+        seen.insert(entry.fileName(), {entry.size(), entry.lastModified()});
+
+    watchId = fileWatcher->addWatch(QDir::toNativeSeparators(dir).toStdString(), listener.get(), false);
+    if (watchId < 0) {
+        qWarning() << "Could not watch" << dir << QString::fromStdString(efsw::Errors::Log::getLastErrorLog());
+        return;
+    }
+    fileWatcher->watch();
+    qInfo() << "Watching" << dir << "with" << seen.size() << "existing images";
+}
+
+void ImageDirectoryIndex::stopWatch() {
+    if (watchId > 0)
+        fileWatcher->removeWatch(watchId);
+    watchId = 0;
+    settleTimer.stop();
+}
+
+void ImageDirectoryIndex::rescan() {
+    if (directory.isEmpty()) return;
+    for (const auto &entry: QDir(directory).entryInfoList(nameFilters, QDir::Files))
+        handleFileEvent(directory, entry.fileName());
+    for (const auto &filename: seen.keys())
+        handleFileEvent(directory, filename);
+}
+
+void ImageDirectoryIndex::handleFileEvent(const QString &dir, const QString &filename) {
+    if (QDir::cleanPath(dir) != QDir::cleanPath(directory)) return;
+    if (not QDir::match(nameFilters, filename)) return;
+
+    auto filePath = QDir(directory).filePath(filename);
+    if (not QFileInfo::exists(filePath)) {
+        seen.remove(filename);
+        settling.remove(filename);
+        return;
+    }
+
+    auto current = stamp(filePath);
+    auto known = seen.constFind(filename);
+    if (known != seen.constEnd() and *known == current) return;
+
+    settling.insert(filename, current);
+    settleTimer.start();
+}
+
+void ImageDirectoryIndex::reportSettled() {
+    struct Ready {
+        QString filename;
+        QDateTime modified;
+    };
+    std::vector<Ready> ready;
+
+    for (auto it = settling.begin(); it != settling.end();) {
+        auto current = stamp(QDir(directory).filePath(it.key()));
+        if (current.size > 0 and current == it.value()) {
+            // new, or replaced under the same name
+            auto known = seen.constFind(it.key());
+            if (known == seen.constEnd() or not(*known == current))
+                ready.push_back({it.key(), current.modified});
+            seen.insert(it.key(), current);
+            it = settling.erase(it);
+        } else {
+            // still being written, or removed
+            if (current.size > 0)
+                it.value() = current;
+            else if (not QFileInfo::exists(QDir(directory).filePath(it.key()))) {
+                seen.remove(it.key());
+                it = settling.erase(it);
+                continue;
+            }
+            ++it;
+        }
+    }
+    if (not settling.isEmpty())
+        settleTimer.start();
+
+    // capture order, names break ties between images written in the same second
+    std::sort(ready.begin(), ready.end(), [](const Ready &a, const Ready &b) {
+        return a.modified != b.modified ? a.modified < b.modified : a.filename < b.filename;
+    });
+    for (const auto &image: ready)
+        Q_EMIT imageAdded(QDir(directory).filePath(image.filename));
+}
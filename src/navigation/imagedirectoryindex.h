@@ -0,0 +1,84 @@
+//
+// Created by Nic on 04/06/2022.
+//
+
+#ifndef REALTIME3D_IMAGEDIRECTORYINDEX_H
+#define REALTIME3D_IMAGEDIRECTORYINDEX_H
+
+
+#include <QObject>
+#include <QHash>
+#include <QDateTime>
+#include <QStringList>
+#include <QTimer>
+#include <memory>
+
+namespace efsw { class FileWatcher; }
+
+class UpdateListener;
+
+/// Index of the images already seen in a watched directory, with their size and modification time.
+/// Per file events are diffed against it, so the cost of each event does not depend
+/// on how many images the directory holds, and every new or rewritten image is reported in capture order.
+/// Deleted images are dropped, so an image written again under their name is reported.
+class ImageDirectoryIndex : public QObject {
+Q_OBJECT
+    struct FileStamp {
+        qint64 size;
+        QDateTime modified;
+
+        bool operator==(const FileStamp &other) const {
+            return size == other.size and modified == other.modified;
+        }
+    };
+
+    QString directory;
+    QStringList nameFilters;
+    QHash<QString, FileStamp> seen;
+    /// files with a recent event, reported once their size and time stop changing
+    QHash<QString, FileStamp> settling;
+    QTimer settleTimer;
+
+    std::unique_ptr<efsw::FileWatcher> fileWatcher;
+    std::shared_ptr<UpdateListener> listener;
+    long watchId;
+
+    static FileStamp stamp(const QString &filePath);
+
+public:
+    explicit ImageDirectoryIndex(const QStringList &nameFilters, QObject *parent = nullptr);
+
+    ~ImageDirectoryIndex() override;
+
+    /// Time a file must stay unchanged before it is reported, cameras write images in chunks
+    static constexpr int settleMs = 250;
+
+    [[nodiscard]] QString watchedDirectory() const;
+
+    [[nodiscard]] int imageCount() const;
+
+Q_SIGNALS:
+
+    /// New image in the watched directory, or one replaced under the same name, emitted in capture order
+    void imageAdded(const QString &filePath);
+
+public Q_SLOTS:
+
+    /// Starts watching dir, the images already in it are indexed but not reported
+    void setDirectory(const QString &dir);
+
+    void stopWatch();
+
+    /// Full listing diffed against the index, for file systems that drop events
+    void rescan();
+
+private Q_SLOTS:
+
+    void handleFileEvent(const QString &dir, const QString &filename);
+
+    void reportSettled();
+
+};
+
+
+#endif //REALTIME3D_IMAGEDIRECTORYINDEX_H
@@ -1,6 +1,5 @@
 //
 // Created by Nic on 20/03/2022.
-// Kept for reference only, project was switched to use the opencv-python implementation
 //
 
 #include "imageprocessing.h"
@@ -8,13 +7,28 @@
 #include <opencv2/highgui.hpp>
 #include <opencv2/features2d.hpp>
 #include <opencv2/imgproc.hpp>
+#include <opencv2/core/utility.hpp>
 #include <utility>
 #include <QDir>
-#include <iostream>
 #include <QDebug>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutexLocker>
 
-#include <stdexcept>
 #include <chrono>
+#include <cmath>
+
+namespace {
+    /// KeyPoint fields as saved, x, y, size, angle, response, octave and class id
+    constexpr int keypointFields = 7;
+
+    /// Identifies the base map a feature save was made from
+    bool sameSource(const QJsonObject &stamp, const QFileInfo &source) {
+        return stamp["modified"].toVariant().toLongLong() == source.lastModified().toMSecsSinceEpoch()
+               and stamp["bytes"].toVariant().toLongLong() == source.size();
+    }
+}
 
 ImageMatcher::ImageMatcher(QString outputDir,
                            bool saveImages,
@@ -23,6 +37,7 @@ ImageMatcher::ImageMatcher(QString outputDir,
                            double confidence) :
         outputDir(std::move(outputDir)),
         sift(cv::SIFT::create()),
+        siftOblique(cv::SIFT::create()),
         confidence(confidence),
         saveImages(saveImages),
         minMatches(minMatches),
@@ -35,10 +50,6 @@ ImageMatcher::ImageMatcher(QString outputDir,
     if (not(0 <= this->confidence && this->confidence <= 1))
         this->confidence = 0.99;
 
-    const cv::Ptr<cv::flann::IndexParams> &indexParams = new cv::flann::KDTreeIndexParams(4);
-    const cv::Ptr<cv::flann::SearchParams> &searchParams = new cv::flann::SearchParams(50);
-
-    matcher = cv::makePtr<cv::FlannBasedMatcher>(cv::FlannBasedMatcher(indexParams, searchParams));
     colorConverter = cv::COLOR_BGR2GRAY;
     borderLineColor = 255;
     matchLineColor = {0, 255, 0};
@@ -52,7 +63,8 @@ cv::Mat ImageMatcher::readImage(const QString &path) {
     auto img = cv::imread(file_path);
 
     if (img.empty()) {
-        throw std::runtime_error("\"!!! image not found\"");
+        qWarning() << "Could not read image" << path;
+        return {};
     }
 
     cv::cvtColor(img, img, colorConverter);
@@ -66,53 +78,195 @@ QString ImageMatcher::writeImage(const cv::Mat &img, const QString &filename) {
     return writePath;
 }
 
-cv::Mat ImageMatcher::match(const QString &nadirPath, const QString &obliquePath) {
+QDir ImageMatcher::featureDir(const QString &nadirPath) const {
+    QFileInfo source(nadirPath);
+    auto name = source.fileName() + ".features";
+    auto dir = source.absoluteDir();
+    if (not QFileInfo(dir.absolutePath()).isWritable() or not dir.mkpath(name)) {
+        dir = QDir(outputDir);
+        dir.mkpath(name);
+    }
+    return QDir(dir.filePath(name));
+}
+
+bool ImageMatcher::loadFeatures(const QString &nadirPath, cv::Size size) {
+    auto dir = featureDir(nadirPath);
+    auto name = QString("%1x%2").arg(size.width).arg(size.height);
+
+    QFile stampFile(dir.filePath(name + ".json"));
+    if (not stampFile.open(QIODevice::ReadOnly))
+        return false;
+    auto stamp = QJsonDocument::fromJson(stampFile.readAll()).object();
+    auto count = stamp["count"].toInt();
+    auto dims = stamp["dims"].toInt();
+    if (not sameSource(stamp, QFileInfo(nadirPath)) or count < 2 or dims <= 0)
+        return false;
+
+    QFile keypointFile(dir.filePath(name + ".kp"));
+    auto descriptorFile = std::make_unique<QFile>(dir.filePath(name + ".desc"));
+    if (not keypointFile.open(QIODevice::ReadOnly)
+        or keypointFile.size() != qint64(count) * keypointFields * qint64(sizeof(float))
+        or not descriptorFile->open(QIODevice::ReadOnly)
+        or descriptorFile->size() != qint64(count) * dims * qint64(sizeof(float)))
+        return false;
+    auto mapped = descriptorFile->map(0, descriptorFile->size());
+    if (not mapped)
+        return false;
+    cv::Mat descriptors(count, dims, CV_32F, mapped);
+
+    auto index = std::make_unique<cv::flann::Index>();
+    if (not index->load(descriptors, dir.filePath(name + ".flann").toStdString()))
+        return false;
+
+    std::vector<float> fields(std::size_t(count) * keypointFields);
+    if (keypointFile.read(reinterpret_cast<char *>(fields.data()), keypointFile.size()) != keypointFile.size())
+        return false;
+
+    resetFeatures();
+    baseKeypoints.reserve(count);
+    for (auto f = fields.data(); f < fields.data() + fields.size(); f += keypointFields)
+        baseKeypoints.emplace_back(f[0], f[1], f[2], f[3], f[4], int(f[5]), int(f[6]));
+    baseDescriptorFile = std::move(descriptorFile);
+    baseDescriptors = descriptors;
+    baseIndex = std::move(index);
+    return true;
+}
+
+void ImageMatcher::saveFeatures(const QString &nadirPath, cv::Size size) {
+    auto dir = featureDir(nadirPath);
+    auto name = QString("%1x%2").arg(size.width).arg(size.height);
+
+    QFile stampFile(dir.filePath(name + ".json"));
+    // invalidates the previous save before its files are replaced
+    stampFile.remove();
+
+    std::vector<float> fields;
+    fields.reserve(baseKeypoints.size() * keypointFields);
+    for (const auto &k: baseKeypoints)
+        fields.insert(fields.end(), {k.pt.x, k.pt.y, k.size, k.angle, k.response, float(k.octave), float(k.class_id)});
+    QFile keypointFile(dir.filePath(name + ".kp"));
+    QFile descriptorFile(dir.filePath(name + ".desc"));
+    auto descriptorBytes = qint64(baseDescriptors.total() * baseDescriptors.elemSize());
+    if (not keypointFile.open(QIODevice::WriteOnly)
+        or keypointFile.write(reinterpret_cast<const char *>(fields.data()), qint64(fields.size() * sizeof(float))) < 0
+        or not descriptorFile.open(QIODevice::WriteOnly)
+        or descriptorFile.write(reinterpret_cast<const char *>(baseDescriptors.data), descriptorBytes) < 0) {
+        qWarning() << "Could not save the base map features to" << dir.absolutePath();
+        return;
+    }
+    keypointFile.close();
+    descriptorFile.close();
+    baseIndex->save(dir.filePath(name + ".flann").toStdString());
+
+    QFileInfo source(nadirPath);
+    QJsonObject stamp{{"modified", source.lastModified().toMSecsSinceEpoch()},
+                      {"bytes",    source.size()},
+                      {"count",    baseDescriptors.rows},
+                      {"dims",     baseDescriptors.cols}};
+    if (not stampFile.open(QIODevice::WriteOnly) or stampFile.write(QJsonDocument(stamp).toJson()) < 0)
+        qWarning() << "Could not save the base map features to" << dir.absolutePath();
+}
+
+void ImageMatcher::resetFeatures() {
+    // the index refers to the descriptors, which may be mapped from the file
+    baseIndex.reset();
+    baseDescriptors.release();
+    baseDescriptorFile.reset();
+    baseKeypoints.clear();
+}
+
+void ImageMatcher::detectFeatures(const QString &nadirPath, const cv::Mat &imgNadir,
+                                  const cv::Mat &imgOblique,
+                                  std::vector<cv::KeyPoint> &kpOblique, cv::Mat &descOblique) {
+    auto modified = QFileInfo(nadirPath).lastModified();
+    bool baseCached = baseKeyPath == nadirPath and baseKeyModified == modified
+                      and baseKeySize == imgOblique.size() and baseIndex;
+    if (not baseCached)
+        baseCached = loadFeatures(nadirPath, imgOblique.size());
+    if (not baseCached)
+        resetFeatures();
+
+    // both images on the OpenCV thread pool, each detector is only used by one task
+    cv::parallel_for_(cv::Range(0, baseCached ? 1 : 2), [&](const cv::Range &range) {
+        for (int task = range.start; task < range.end; ++task) {
+            if (task == 0)
+                siftOblique->detectAndCompute(imgOblique, cv::noArray(), kpOblique, descOblique);
+            else
+                sift->detectAndCompute(imgNadir, cv::noArray(), baseKeypoints, baseDescriptors);
+        }
+    });
+
+    baseKeyPath = nadirPath;
+    baseKeyModified = modified;
+    baseKeySize = imgOblique.size();
+    if (not baseCached and baseDescriptors.rows >= 2) {
+        // the base descriptors are the train set, indexed once per base map and frame size
+        baseIndex = std::make_unique<cv::flann::Index>(baseDescriptors, cv::flann::KDTreeIndexParams(4));
+        saveFeatures(nadirPath, imgOblique.size());
+    }
+}
+
+cv::Mat ImageMatcher::match(const QString &nadirPath, const QString &obliquePath, cv::Mat *homography,
+                            QString *error) {
+    QMutexLocker locker(&mutex);
+    auto fail = [error](const QString &msg) {
+        qWarning() << msg;
+        if (error) *error = msg;
+        return cv::Mat();
+    };
+
     auto start = std::chrono::steady_clock::now();
     /// image 1
     auto imgNadir = readImage(nadirPath);
     /// image 2
     auto imgOblique = readImage(obliquePath);
+    if (imgNadir.empty() or imgOblique.empty())
+        return fail(QLatin1String("Could not read images for perspective matching."));
 
     auto h = imgOblique.size().height;
     auto w = imgOblique.size().width;
-//    auto img2Size = imgOblique.size();
 
     // resize images
-    cv::resize(imgNadir, imgNadir, {w, h}, interMethod);
-
+    cv::resize(imgNadir, imgNadir, {w, h}, 0, 0, interMethod);
 
     // get keypoints and descriptors
-    std::vector<cv::KeyPoint> kp1, kp2;
-    cv::Mat desc1, desc2;
-    sift->detectAndCompute(imgNadir, cv::noArray(), kp1, desc1);
-    sift->detectAndCompute(imgOblique, cv::noArray(), kp2, desc2);
-
-    cv::Mat imgKP1;
-    cv::Mat imgKP2;
-    cv::drawKeypoints(imgNadir, kp1, imgKP1);
-    cv::drawKeypoints(imgOblique, kp2, imgKP2);
+    std::vector<cv::KeyPoint> kp2;
+    cv::Mat desc2;
+    detectFeatures(nadirPath, imgNadir, imgOblique, kp2, desc2);
+    const auto &kp1 = baseKeypoints;
+    if (not baseIndex or desc2.rows < 2)
+        return fail(QLatin1String("Too few features were found for perspective matching."));
+
     if (saveImages) {
+        cv::Mat imgKP1;
+        cv::Mat imgKP2;
+        cv::drawKeypoints(imgNadir, kp1, imgKP1);
+        cv::drawKeypoints(imgOblique, kp2, imgKP2);
         writeImage(imgKP1, "key1.png");
         writeImage(imgKP2, "key2.png");
     }
 
-    std::vector<std::vector<cv::DMatch>> matches;
-    matcher->knnMatch(desc1, desc2, matches, 2);
+    // query with the oblique descriptors, indices are into the base keypoints
+    cv::Mat indices, dists;
+    baseIndex->knnSearch(desc2, indices, dists, 2, cv::flann::SearchParams(50));
 
-    //-- Filter matches using the Lowe's ratio test
+    //-- Filter matches using the Lowe's ratio test, the kd-tree distances are squared
     const float ratio_thresh = 0.7f;
     std::vector<cv::DMatch> good_matches;
-    for (auto &match: matches)
-        if (match[0].distance < ratio_thresh * match[1].distance)
-            good_matches.push_back(match[0]);
+    for (int i = 0; i < indices.rows; i++) {
+        auto nearest = indices.at<int>(i, 0);
+        auto d = dists.ptr<float>(i);
+        if (nearest >= 0 and indices.at<int>(i, 1) >= 0 and d[0] < ratio_thresh * ratio_thresh * d[1])
+            good_matches.emplace_back(nearest, i, std::sqrt(d[0]));
+    }
 
     // Check if too few matches are found
-    if (good_matches.size() <= minMatches) {
-        std::cout << "Error: too few matches were found" << std::endl;
-        return {};
-    }
+    if (good_matches.size() <= minMatches)
+        return fail(QString("Too few matches were found: %1/%2").arg(good_matches.size()).arg(minMatches));
 
     std::vector<cv::Point2f> srcPts, dstPts;
+    srcPts.reserve(good_matches.size());
+    dstPts.reserve(good_matches.size());
     for (auto &goodMatch: good_matches) {
         // Determine keypoints from the matches
         srcPts.push_back(kp1[goodMatch.queryIdx].pt);
@@ -126,6 +280,8 @@ cv::Mat ImageMatcher::match(const QString &nadirPath, const QString &obliquePath
                                inlierMask,
                                2000,
                                confidence);
+    if (H.empty())
+        return fail(QLatin1String("No homography found for the perspective match."));
 
     if (saveImages) {
         std::vector<cv::Point2f> obj_corners(4);
@@ -145,12 +301,10 @@ cv::Mat ImageMatcher::match(const QString &nadirPath, const QString &obliquePath
         writeImage(im2copy, "oblique_with_borders.png");
     }
 
-    cv::cvtColor(imgNadir, imgNadir, cv::COLOR_BGR2BGRA);
+    cv::cvtColor(imgNadir, imgNadir, cv::COLOR_GRAY2BGRA);
 
     cv::Mat imgOut;
-    cv::warpPerspective(imgNadir, imgOut, H, {w, h});
-
-    cv::resize(imgOut, imgOut, {w, h}, interMethod);
+    cv::warpPerspective(imgNadir, imgOut, H, {w, h}, interMethod);
 
     if (saveImages) {
         // point matched image
@@ -164,17 +318,58 @@ cv::Mat ImageMatcher::match(const QString &nadirPath, const QString &obliquePath
         writeImage(img3, "point_matched.png");
     }
     auto end = std::chrono::steady_clock::now();
-    auto diff = end - start;
-    auto diff_sec = std::chrono::duration_cast<std::chrono::seconds>(diff);
-    qDebug() << diff_sec.count() << "sec.";
+    auto diff_ms = std::chrono::duration_cast<std::chrono::milliseconds>(end - start);
+    qDebug() << "Perspective match took" << diff_ms.count() << "ms.";
+
+    if (homography)
+        *homography = H;
     return imgOut;
 }
 
-QPixmap ImageMatcher::cvImageToQPixmap(cv::Mat cvImage) {
-    cv::Mat rgbImage;
-    cv::cvtColor(cvImage, rgbImage, cv::COLOR_BGR2RGB);
-    auto pixmap = QPixmap();
-    //extra
-    return pixmap;
+MatchResult ImageMatcher::matchImages(const QString &nadirPath, const QString &obliquePath) {
+    MatchResult result;
+    cv::Mat H;
+    auto imgOut = match(nadirPath, obliquePath, &H, &result.error);
+    if (imgOut.empty()) {
+        if (result.error.isEmpty())
+            result.error = QLatin1String("Perspective match failed.");
+        return result;
+    }
+    result.image = cvImageToQImage(imgOut);
+    result.homography = cvHomographyToQTransform(H);
+    return result;
+}
+
+QImage ImageMatcher::cvImageToQImage(const cv::Mat &cvImage) {
+    QImage::Format format;
+    switch (cvImage.type()) {
+        case CV_8UC1:
+            format = QImage::Format_Grayscale8;
+            break;
+        case CV_8UC3:
+            format = QImage::Format_BGR888;
+            break;
+        case CV_8UC4:
+            // BGRA byte order is ARGB32 on little endian
+            format = QImage::Format_ARGB32;
+            break;
+        default:
+            qWarning() << "Unsupported image type for conversion" << cvImage.type();
+            return {};
+    }
+    // wraps the cv::Mat buffer, copy so the QImage owns its pixels
+    return QImage(cvImage.data, cvImage.cols, cvImage.rows, static_cast<int>(cvImage.step), format).copy();
+}
+
+QPixmap ImageMatcher::cvImageToQPixmap(const cv::Mat &cvImage) {
+    return QPixmap::fromImage(cvImageToQImage(cvImage));
 }
 
+QTransform ImageMatcher::cvHomographyToQTransform(const cv::Mat &H) {
+    cv::Mat h;
+    H.convertTo(h, CV_64F);
+    // QTransform maps row vectors, so it takes the transpose of the OpenCV matrix
+    return {h.at<double>(0, 0), h.at<double>(1, 0), h.at<double>(2, 0),
+            h.at<double>(0, 1), h.at<double>(1, 1), h.at<double>(2, 1),
+            h.at<double>(0, 2), h.at<double>(1, 2), h.at<double>(2, 2)};
+}
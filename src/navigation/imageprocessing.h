@@ -1,29 +1,78 @@
 //
 // Created by Nic on 20/03/2022.
-// Kept for reference only, project was switched to use the opencv-python implementation
 //
 
 #ifndef REALTIME3D_IMAGEPROCESSING_H
 #define REALTIME3D_IMAGEPROCESSING_H
 
 #include <opencv2/opencv.hpp>
+#include <opencv2/flann.hpp>
 #include <QString>
+#include <QFile>
 #include <QPixmap>
+#include <QImage>
+#include <QTransform>
+#include <QMutex>
+#include <QDateTime>
+#include <QDir>
+#include <memory>
+
+/// Result of a perspective match, the base map warped into the oblique view
+struct MatchResult {
+    QImage image;
+    /// Maps the resized base map onto the oblique image
+    QTransform homography;
+    QString error;
+
+    [[nodiscard]] bool ok() const { return error.isEmpty() and not image.isNull(); }
+};
 
 class ImageMatcher {
-    cv::Ptr<cv::FlannBasedMatcher> matcher;
     cv::Ptr<cv::SIFT> sift;
+    cv::Ptr<cv::SIFT> siftOblique;
     QString outputDir;
     double confidence;
     bool saveImages;
     int minMatches;
     cv::InterpolationFlags interMethod;
 
+    // base map features, kept while the base map file and the oblique size are unchanged
+    QString baseKeyPath;
+    QDateTime baseKeyModified;
+    cv::Size baseKeySize;
+    std::vector<cv::KeyPoint> baseKeypoints;
+    /// owned, or mapped from baseDescriptorFile
+    cv::Mat baseDescriptors;
+    std::unique_ptr<QFile> baseDescriptorFile;
+    /// kd-tree of the base descriptors, the oblique descriptors are the queries
+    std::unique_ptr<cv::flann::Index> baseIndex;
+
+    /// one match at a time per matcher, the cached base features are shared
+    QMutex mutex;
+
     // aesthetic settings
     cv::ColorConversionCodes colorConverter;
     int borderLineColor;
     cv::Scalar matchLineColor;
 
+    /// <base map>.features next to the base map, in the output directory when that is not writable
+    QDir featureDir(const QString &nadirPath) const;
+
+    /// Loads the base map features saved for this frame size, false if there are none or the base map changed.
+    /// The descriptors are memory mapped.
+    bool loadFeatures(const QString &nadirPath, cv::Size size);
+
+    /// Saves the base map features and kd-tree, the stamp is written last so an interrupted save is ignored
+    void saveFeatures(const QString &nadirPath, cv::Size size);
+
+    void resetFeatures();
+
+    /// Extracts the base map features in parallel with the oblique view features,
+    /// the base map is skipped if its features are cached or saved
+    void detectFeatures(const QString &nadirPath, const cv::Mat &imgNadir,
+                        const cv::Mat &imgOblique,
+                        std::vector<cv::KeyPoint> &kpOblique, cv::Mat &descOblique);
+
 public:
 
     explicit ImageMatcher(QString outputDir = "",
@@ -36,10 +85,20 @@ public:
 
     QString writeImage(const cv::Mat& img, const QString &filename);
 
-    cv::Mat match(const QString &nadirPath, const QString &obliquePath);
+    /// Warps the nadir image onto the oblique image, empty if no match was found
+    cv::Mat match(const QString &nadirPath, const QString &obliquePath, cv::Mat *homography = nullptr,
+                  QString *error = nullptr);
+
+    /// Thread safe, intended to be run through QtConcurrent
+    MatchResult matchImages(const QString &nadirPath, const QString &obliquePath);
+
+    /// Deep copy of a 8 bit grey, BGR or BGRA image, safe to use off the GUI thread
+    static QImage cvImageToQImage(const cv::Mat &cvImage);
 
-    QPixmap cvImageToQPixmap(cv::Mat cvImage);
+    /// Only call on the GUI thread
+    static QPixmap cvImageToQPixmap(const cv::Mat &cvImage);
 
+    static QTransform cvHomographyToQTransform(const cv::Mat &H);
 
 };
 
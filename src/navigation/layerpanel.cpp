@@ -3,6 +3,8 @@
 //
 
 #include "layerpanel.h"
+#include "Workspace/tiledimageitem.h"
+#include "../settings/navigation_settings/navigationsettings.h"
 #include <QDebug>
 #include <QGraphicsScene>
 
@@ -135,6 +137,10 @@ QPixmap LayerData::pixmap() const {
     return graphicsItem->pixmap();
 }
 
+bool LayerData::hasImage() const {
+    return not graphicsItem->boundingRect().isEmpty();
+}
+
 void LayerData::updateOpacity(float value) {
     auto newValue = value / 100;
     opacity = newValue;
@@ -182,8 +188,30 @@ void LayerData::setImage(const QString &fileName, bool center) {
     imagePath = fileName;
 }
 
+void LayerData::setImage(const QImage &image, bool center) const {
+    setImage(QPixmap::fromImage(image), center);
+}
+
+bool LayerData::setTiledImage(const QString &fileName, bool center) {
+    TiledImageItem::setCacheBudget(NavigationSettings::getImageCacheSize());
+    auto tiledItem = new TiledImageItem(fileName);
+    if (tiledItem->isNull()) {
+        delete tiledItem;
+        return false;
+    }
+    if (center)
+        tiledItem->setOffset(-tiledItem->boundingRect().center());
+    if (graphicsItem->scene() != nullptr)
+        graphicsItem->scene()->removeItem(graphicsItem);
+    tiledItem->setOpacity(graphicsItem->opacity());
+    delete graphicsItem;
+    graphicsItem = tiledItem;
+    imagePath = fileName;
+    return true;
+}
+
 void LayerData::handleDeletion() const {
-    if (not graphicsItem->pixmap().isNull())
+    if (hasImage() and graphicsItem->scene() != nullptr)
         graphicsItem->scene()->removeItem(graphicsItem);
 
 }
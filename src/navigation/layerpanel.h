@@ -11,6 +11,7 @@
 #include <QTreeView>
 #include <QGraphicsPixmapItem>
 #include <QSpinBox>
+#include <QTransform>
 
 class LayerData : public QObject {
 Q_OBJECT
@@ -25,11 +26,16 @@ public:
     QStandardItem *layerItem;
     QString description;
     QString imagePath;
+    /// Perspective transform of a matched image from the resized base map, identity otherwise
+    QTransform homography;
 
     bool progSet;
 
     [[nodiscard]] QPixmap pixmap() const;
 
+    /// True once an image is set, tiled images have no pixmap
+    [[nodiscard]] bool hasImage() const;
+
 Q_SIGNALS:
 
     void toggled(bool checked);
@@ -53,6 +59,12 @@ public Q_SLOTS:
 
     void setImage(const QString &fileName, bool center = true);
 
+    void setImage(const QImage &image, bool center = true) const;
+
+    /// Replaces the graphics item by a tiled item that keeps only a thumbnail resident and decodes
+    /// the visible parts of the image on demand. Returns false if the image cannot be read.
+    bool setTiledImage(const QString &fileName, bool center = true);
+
     void handleDeletion() const;
 
     void handleToggle(Qt::CheckState checkState);
@@ -13,6 +13,7 @@
 #include <QDebug>
 #include <QScreen>
 #include <QMessageBox>
+#include <cmath>
 
 MainInterface::MainInterface(QWidget *parent) :
         QMainWindow(parent), ui(new Ui::MainInterface),
@@ -73,6 +74,7 @@ MainInterface::MainInterface(QWidget *parent) :
                                   ui->actionSimulate_Image,
                                   ui->actionSimulate_Flight_Images,
                                   ui->actionConnect_to_Camera,
+                                  ui->actionTracking_Mode,
                                   ui->statusbar,
                                   ui->editorTabs,
                                   workspace,
@@ -108,15 +110,24 @@ void MainInterface::keyReleaseEvent(QKeyEvent *event) {
 }
 
 void MainInterface::openBasemapPhoto(const QString &path) {
-    auto[image, filePath] = waypointer::io::readPhoto(path);
-    if (image.isNull()) return;
+    auto filePath = waypointer::io::photoPath(path);
+    if (filePath.isEmpty()) return;
+
+    // base maps are tiled, only the visible parts are decoded
+    auto newBasemap = layerPanel->addItemToLayer(layerPanel->baseLayer, QFileInfo(filePath).fileName());
+    auto previousBasemap = layerPanel->currentBaseMap;
+    layerPanel->currentBaseMap = LayerPanel::getLayerData(newBasemap);
+    if (not workspace->systemViewer->setBasemap(filePath)) {
+        layerPanel->currentBaseMap->deleteLater();
+        layerPanel->currentBaseMap = previousBasemap;
+        layerPanel->baseLayer->removeRow(newBasemap->row());
+        Messages::warning_msg(this, QString("Could not read %1.").arg(filePath));
+        return;
+    }
     ui->addCoordsBtn->setDisabled(false);
     ui->addCoordsBtn->setToolTip(QLatin1String("Add waypoints to map."));
 
     baseItemFile = filePath;
-    auto newBasemap = layerPanel->addItemToLayer(layerPanel->baseLayer, QFileInfo(filePath).fileName());
-    layerPanel->currentBaseMap = LayerPanel::getLayerData(newBasemap);
-    workspace->systemViewer->setBasemap(image, filePath);
     Q_EMIT layerPanel->layerModel->layoutChanged();
 }
 
@@ -127,9 +138,7 @@ void MainInterface::openWaypoints(const QString &filePath) const {
         return;
     }
     auto data = waypointer::io::readWaypoints(filePath);
-    for (auto p: data) {
-        coordinatePanel->addWaypoint(p, true);
-    }
+    workspace->systemViewer->addWaypoints(data, true);
 }
 
 void MainInterface::addFlightImage(QString flightImagePath, int x, int y) {
@@ -152,57 +161,31 @@ void MainInterface::setZ(double z) const {
     workspace->setCoordView(QVector3D{0, 0, static_cast<float>(z)});
 }
 
+void MainInterface::setGroundSampleDistance(double metresPerPixel) const {
+    flightTools->groundSampleDistance = std::isfinite(metresPerPixel) ? qMax(metresPerPixel, 0.0) : 0.0;
+}
+
 
 void MainInterface::saveWaypoints() {
-    // extra: move to waypointer_io
     auto saveFilePath = QFileDialog::getSaveFileName(this,
                                                      "Save Waypoints",
                                                      QDir(PathSettings::default_tigerDir()).filePath("waypoints.txt"),
-                                                     "Waypoint Files (*.txt *.csv *.tsv)"
+                                                     "Waypoint Files (*.txt *.csv *.tsv);;Mission Files (*.rtm)"
     );
-
-    auto waypointsTable = coordinatePanel->waypointsTable;
-    QFile saveFile(saveFilePath);
-    if (!saveFile.open(QIODevice::WriteOnly)) {
-        qWarning() << "Couldn't open file:" << saveFile << "for writing.";
-        return;
-    }
-    QTextStream streamOut(&saveFile);
-    for (int i = 0; i < waypointsTable->rowCount(); ++i) {
-        auto saveCoord = QString("%1, %2, %3").arg(waypointsTable->item(i, 0)->text(),
-                                                   waypointsTable->item(i, 1)->text(),
-                                                   waypointsTable->item(i, 2)->text());
-        if (QFileInfo(saveFilePath).completeSuffix().contains("tsv"))
-            saveCoord.replace(",", "\t");
-        streamOut << saveCoord << "\n";
-    }
-    qInfo() << "Waypoints saved:" << saveFile.fileName();
+    if (saveFilePath.isEmpty()) return;
+    if (waypointer::io::writeWaypoints(saveFilePath, coordinatePanel->waypointsTable->points()))
+        qInfo() << "Waypoints saved:" << saveFilePath;
 }
 
 void MainInterface::saveTargetPoints(){
-    // extra: move to waypointer_io
     auto saveFilePath = QFileDialog::getSaveFileName(this,
                                                      "Save Target Points",
                                                      QDir(PathSettings::default_tigerDir()).filePath("target_points.txt"),
-                                                     "Waypoint Files (*.txt *.csv *.tsv)"
+                                                     "Waypoint Files (*.txt *.csv *.tsv);;Mission Files (*.rtm)"
     );
-
-    auto waypointsTable = coordinatePanel->waypointsTable;
-    QFile saveFile(saveFilePath);
-    if (!saveFile.open(QIODevice::WriteOnly)) {
-        qWarning() << "Couldn't open file:" << saveFile << "for writing.";
-        return;
-    }
-    QTextStream streamOut(&saveFile);
-    for (int i = 0; i < waypointsTable->rowCount(); ++i) {
-        auto saveCoord = QString("%1, %2, %3").arg(waypointsTable->item(i, 0)->text(),
-                                                   waypointsTable->item(i, 1)->text(),
-                                                   waypointsTable->item(i, 2)->text());
-        if (QFileInfo(saveFilePath).completeSuffix().contains("tsv"))
-            saveCoord.replace(",", "\t");
-        streamOut << saveCoord << "\n";
-    }
-    qInfo() << "Target point saved:" << saveFile.fileName();
+    if (saveFilePath.isEmpty()) return;
+    if (waypointer::io::writeWaypoints(saveFilePath, coordinatePanel->targetsTable->points()))
+        qInfo() << "Target point saved:" << saveFilePath;
 }
 //
 //void MainInterface::saveMissionImageAs(){
@@ -112,6 +112,9 @@ public Q_SLOTS:
 
     void setZ(double z) const;
 
+    /// Metres per pixel of the flight images, used to convert navigation search distances
+    void setGroundSampleDistance(double metresPerPixel) const;
+
 protected:
     void keyPressEvent(QKeyEvent *event) override;
 
@@ -4,17 +4,19 @@
 #include "images.hpp"
 #include "../../settings/path_settings/pathsettings.h"
 
+QString waypointer::io::photoPath(const QString &path) {
+    if (not path.isNull() and not path.isEmpty())
+        return path;
+    return QFileDialog::getOpenFileName(
+            nullptr,
+            QLatin1String("Open Base Image"),
+            PathSettings::default_tigerDir(),
+            supportedImageFormats()
+    );
+}
+
 std::tuple<QPixmap, QString> waypointer::io::readPhoto(const QString &path) {
-    QString file_path;
-    if (path.isNull() or path.isEmpty())
-        file_path = QFileDialog::getOpenFileName(
-                nullptr,
-                QLatin1String("Open Base Image"),
-                PathSettings::default_tigerDir(),
-                supportedImageFormats()
-        );
-    else
-        file_path = path;
+    auto file_path = photoPath(path);
     if (file_path.isEmpty() or file_path.isNull()) return {};
     return {QPixmap(file_path), file_path};
 }
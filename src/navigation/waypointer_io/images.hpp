@@ -10,6 +10,9 @@
 #include <QFileDialog>
 
 namespace waypointer::io {
+    /// Asks for an image file if path is empty
+    QString photoPath(const QString &path);
+
     std::tuple<QPixmap, QString> readPhoto(const QString &path);
 }
 
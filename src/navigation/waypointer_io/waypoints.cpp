@@ -3,37 +3,178 @@
 //
 #include "waypoints.hpp"
 #include "../../settings/path_settings/pathsettings.h"
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QtEndian>
+#include <QDebug>
+#include <algorithm>
+#include <charconv>
+#include <cstring>
 
+namespace {
+    constexpr char missionMagic[4] = {'R', 'T', 'W', 'P'};
+    constexpr quint32 missionVersion = 1;
+    static_assert(sizeof(waypointer::io::MissionHeader) == 16);
+    static_assert(sizeof(QVector3D) == 3 * sizeof(float), "QVector3D is copied as packed floats");
 
-QList <QVector3D> waypointer::io::readWaypoints(const QString &path) {
-    QString file_path;
-    if (path.isNull() or path.isEmpty())
-        file_path = QFileDialog::getOpenFileName(
-                nullptr,
-                "Open Waypoints",
-                PathSettings::default_tigerDir(),
-                "Waypoint Files (*.txt *.csv *.tsv)"
-        );
+    bool isSeparator(char c) {
+        return c == ',' or c == ' ' or c == '\t' or c == ';' or c == '\r';
+    }
+}
+
+QString waypointer::io::waypointsPath(const QString &path) {
+    if (not path.isNull() and not path.isEmpty())
+        return path;
+    return QFileDialog::getOpenFileName(
+            nullptr,
+            "Open Waypoints",
+            PathSettings::default_tigerDir(),
+            "Waypoint Files (*.txt *.csv *.tsv *.rtm)"
+    );
+}
+
+QVector<QVector3D> waypointer::io::readWaypoints(const QString &path) {
+    auto file_path = waypointsPath(path);
     if (file_path.isEmpty() or file_path.isNull()) return {};
+    if (QFileInfo(file_path).suffix().compare(missionSuffix, Qt::CaseInsensitive) == 0)
+        return readMission(file_path);
 
     QFile file(file_path);
-    if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+    if (not file.open(QIODevice::ReadOnly) or file.size() == 0)
+        return {};
+    auto size = file.size();
+    auto data = reinterpret_cast<const char *>(file.map(0, size));
+    if (data == nullptr) {
+        // not mappable, e.g. a pipe
+        auto bytes = file.readAll();
+        return parseWaypoints(bytes.constData(), bytes.constData() + bytes.size());
+    }
+    auto points = parseWaypoints(data, data + size);
+    file.unmap(reinterpret_cast<uchar *>(const_cast<char *>(data)));
+    return points;
+}
+
+QVector<QVector3D> waypointer::io::parseWaypoints(const char *begin, const char *end) {
+    // utf-8 byte order mark
+    if (end - begin >= 3 and std::memcmp(begin, "\xEF\xBB\xBF", 3) == 0)
+        begin += 3;
+
+    QVector<QVector3D> points;
+    points.reserve(static_cast<int>(std::count(begin, end, '\n')) + 1);
+    auto p = begin;
+    while (p < end) {
+        auto lineEnd = static_cast<const char *>(std::memchr(p, '\n', end - p));
+        if (lineEnd == nullptr)
+            lineEnd = end;
+
+        float values[3] = {0, 0, 0};
+        int count = 0;
+        while (count < 3) {
+            while (p < lineEnd and isSeparator(*p))
+                ++p;
+            if (p >= lineEnd)
+                break;
+            auto [next, error] = std::from_chars(p, lineEnd, values[count]);
+            // header or comment
+            if (error != std::errc())
+                break;
+            p = next;
+            ++count;
+        }
+        if (count >= 2)
+            points.append(QVector3D(values[0], values[1], values[2]));
+        p = lineEnd + 1;
+    }
+    return points;
+}
+
+QVector<QVector3D> waypointer::io::readMission(const QString &filePath) {
+    QFile file(filePath);
+    if (not file.open(QIODevice::ReadOnly)) {
+        qWarning() << "Couldn't open file:" << filePath << "for reading.";
+        return {};
+    }
+    auto size = file.size();
+    if (size < qint64(sizeof(MissionHeader))) {
+        qWarning() << filePath << "is not a mission file.";
         return {};
+    }
+    auto data = file.map(0, size);
+    QByteArray bytes;
+    if (data == nullptr) {
+        bytes = file.readAll();
+        data = reinterpret_cast<uchar *>(bytes.data());
+    }
 
-    QList<QVector3D> data;
-    QString delimiter(" ");
-    QTextStream in(&file);
-    while (!in.atEnd()) {
-        QString line = in.readLine();
-        if (line.contains(","))
-            delimiter = ",";
-        auto parts = line.split(delimiter);
-        data.append(QVector3D(parts.value(0).toFloat(),
-                              parts.value(1).toFloat(),
-                              parts.value(2).toFloat()
-        ));
-        delimiter = " ";
-    }
-    return data;
+    MissionHeader header{};
+    std::memcpy(&header, data, sizeof(header));
+    auto count = qFromLittleEndian(header.count);
+    QVector<QVector3D> points;
+    if (std::memcmp(header.magic, missionMagic, sizeof(missionMagic)) != 0
+        or qFromLittleEndian(header.version) != missionVersion
+        or qint64(sizeof(MissionHeader)) + qint64(count) * qint64(sizeof(QVector3D)) > size) {
+        qWarning() << filePath << "is not a version" << missionVersion << "mission file or is truncated.";
+    } else {
+        points.resize(static_cast<int>(count));
+        auto floats = data + sizeof(MissionHeader);
+        if constexpr (Q_BYTE_ORDER == Q_LITTLE_ENDIAN) {
+            std::memcpy(points.data(), floats, count * sizeof(QVector3D));
+        } else {
+            auto values = reinterpret_cast<float *>(points.data());
+            qFromLittleEndian<float>(floats, qsizetype(count) * 3, values);
+        }
+    }
+    if (bytes.isNull())
+        file.unmap(data);
+    return points;
 }
 
+bool waypointer::io::writeWaypoints(const QString &filePath, const QVector<QVector3D> &points) {
+    QSaveFile saveFile(filePath);
+    if (not saveFile.open(QIODevice::WriteOnly)) {
+        qWarning() << "Couldn't open file:" << filePath << "for writing.";
+        return false;
+    }
+
+    auto suffix = QFileInfo(filePath).suffix();
+    if (suffix.compare(missionSuffix, Qt::CaseInsensitive) == 0) {
+        MissionHeader header{};
+        std::memcpy(header.magic, missionMagic, sizeof(missionMagic));
+        header.version = qToLittleEndian(missionVersion);
+        header.count = qToLittleEndian(quint32(points.size()));
+        saveFile.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        if constexpr (Q_BYTE_ORDER == Q_LITTLE_ENDIAN) {
+            saveFile.write(reinterpret_cast<const char *>(points.constData()),
+                           qint64(points.size()) * qint64(sizeof(QVector3D)));
+        } else {
+            QByteArray packed(points.size() * int(sizeof(QVector3D)), Qt::Uninitialized);
+            qToLittleEndian<float>(points.constData(), qsizetype(points.size()) * 3, packed.data());
+            saveFile.write(packed);
+        }
+    } else {
+        auto separator = suffix.contains(QLatin1String("tsv"), Qt::CaseInsensitive) ? "\t" : ", ";
+        auto separatorLength = std::strlen(separator);
+        // shortest round trip text per value, written in one go
+        std::string text;
+        text.resize(std::size_t(points.size()) * 3 * (16 + separatorLength));
+        auto out = text.data();
+        auto last = text.data() + text.size();
+        for (const auto &point: points) {
+            for (int axis = 0; axis < 3; ++axis) {
+                out = std::to_chars(out, last, point[axis]).ptr;
+                if (axis < 2) {
+                    std::memcpy(out, separator, separatorLength);
+                    out += separatorLength;
+                }
+            }
+            *out++ = '\n';
+        }
+        saveFile.write(text.data(), out - text.data());
+    }
+    if (not saveFile.commit()) {
+        qWarning() << "Couldn't write" << filePath << saveFile.errorString();
+        return false;
+    }
+    return true;
+}
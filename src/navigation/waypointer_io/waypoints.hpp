@@ -5,14 +5,35 @@
 #ifndef REALTIME3D_WAYPOINTS_HPP
 #define REALTIME3D_WAYPOINTS_HPP
 
-#include <QList>
+#include <QVector>
 #include <QVector3D>
 #include <QFileDialog>
-#include <QTextStream>
 
 namespace waypointer::io {
-    QList<QVector3D> readWaypoints(const QString &path);
-};
+    /// Binary mission files, a MissionHeader followed by packed little endian float x, y, z triplets
+    inline const QString missionSuffix = QStringLiteral("rtm");
+
+    struct MissionHeader {
+        char magic[4];
+        quint32 version;
+        quint32 count;
+        quint32 reserved;
+    };
+
+    /// Asks for a waypoint file if path is empty
+    QString waypointsPath(const QString &path);
+
+    /// Reads a binary mission file, or a text file with one x, y[, z] point per line
+    QVector<QVector3D> readWaypoints(const QString &path);
+
+    /// Parses comma, tab, semicolon or space delimited points, lines without at least x and y are skipped
+    QVector<QVector3D> parseWaypoints(const char *begin, const char *end);
+
+    QVector<QVector3D> readMission(const QString &filePath);
+
+    /// Writes a binary mission file for the mission suffix, tab separated text for tsv, comma separated otherwise
+    bool writeWaypoints(const QString &filePath, const QVector<QVector3D> &points);
+}
 
 
 #endif //REALTIME3D_WAYPOINTS_HPP
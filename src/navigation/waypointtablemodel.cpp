@@ -0,0 +1,215 @@
+//
+// Created by Nic on 07/06/2022.
+//
+
+#include "waypointtablemodel.h"
+#include "Workspace/waypoint.h"
+#include <QTimer>
+
+WaypointTableModel::WaypointTableModel(QObject *parent, bool editable) :
+        QAbstractTableModel(parent),
+        editable(editable),
+        dirtyFirst(-1),
+        dirtyLast(-1) {
+}
+
+int WaypointTableModel::rowCount(const QModelIndex &parent) const {
+    return parent.isValid() ? 0 : static_cast<int>(xs.size());
+}
+
+int WaypointTableModel::columnCount(const QModelIndex &parent) const {
+    return parent.isValid() ? 0 : 3;
+}
+
+QVariant WaypointTableModel::data(const QModelIndex &index, int role) const {
+    if (not index.isValid() or index.row() >= rowCount())
+        return {};
+    float value;
+    switch (index.column()) {
+        case X:
+            value = xs.at(index.row());
+            break;
+        case Y:
+            value = ys.at(index.row());
+            break;
+        case Z:
+            value = zs.at(index.row());
+            break;
+        default:
+            return {};
+    }
+    switch (role) {
+        case Qt::DisplayRole:
+            return QString::number(value);
+        case Qt::EditRole:
+            return value;
+        case Qt::TextAlignmentRole:
+            return int(Qt::AlignRight | Qt::AlignVCenter);
+        default:
+            return {};
+    }
+}
+
+QVariant WaypointTableModel::headerData(int section, Qt::Orientation orientation, int role) const {
+    if (role != Qt::DisplayRole)
+        return {};
+    if (orientation == Qt::Vertical)
+        return section;
+    switch (section) {
+        case X:
+            return QLatin1String("X");
+        case Y:
+            return QLatin1String("Y");
+        case Z:
+            return QLatin1String("Z");
+        default:
+            return {};
+    }
+}
+
+Qt::ItemFlags WaypointTableModel::flags(const QModelIndex &index) const {
+    if (not index.isValid())
+        return Qt::NoItemFlags;
+    auto itemFlags = Qt::ItemIsSelectable | Qt::ItemIsEnabled;
+    if (editable)
+        itemFlags |= Qt::ItemIsEditable;
+    return itemFlags;
+}
+
+bool WaypointTableModel::setData(const QModelIndex &index, const QVariant &value, int role) {
+    if (role != Qt::EditRole or not index.isValid() or index.row() >= rowCount())
+        return false;
+    bool ok;
+    auto number = value.toFloat(&ok);
+    if (not ok)
+        return false;
+
+    auto pos = point(index.row());
+    switch (index.column()) {
+        case X:
+            pos.setX(number);
+            break;
+        case Y:
+            pos.setY(number);
+            break;
+        case Z:
+            pos.setZ(number);
+            break;
+        default:
+            return false;
+    }
+    if (auto wp = waypoints.at(index.row())) {
+        wp->setZ(qRound(pos.z()));
+        wp->setPos(pos.toPointF());
+    }
+    setPoint(index.row(), pos);
+    return true;
+}
+
+bool WaypointTableModel::removeRows(int row, int count, const QModelIndex &parent) {
+    if (parent.isValid() or row < 0 or count <= 0 or row + count > rowCount())
+        return false;
+    beginRemoveRows(parent, row, row + count - 1);
+    xs.remove(row, count);
+    ys.remove(row, count);
+    zs.remove(row, count);
+    waypoints.remove(row, count);
+    endRemoveRows();
+    // rows after the removed ones have shifted, repaint the whole pending range
+    if (dirtyFirst >= 0) {
+        dirtyFirst = qMin(dirtyFirst, row);
+        dirtyLast = rowCount() - 1;
+    }
+    return true;
+}
+
+int WaypointTableModel::appendPoints(const QVector<QVector3D> &points) {
+    auto first = rowCount();
+    if (points.isEmpty())
+        return first;
+    auto total = first + static_cast<int>(points.size());
+    beginInsertRows(QModelIndex(), first, total - 1);
+    xs.reserve(total);
+    ys.reserve(total);
+    zs.reserve(total);
+    for (const auto &pos: points) {
+        xs.append(pos.x());
+        ys.append(pos.y());
+        zs.append(pos.z());
+    }
+    waypoints.resize(total);
+    endInsertRows();
+    return first;
+}
+
+QVector3D WaypointTableModel::point(int row) const {
+    return {xs.at(row), ys.at(row), zs.at(row)};
+}
+
+QVector<QVector3D> WaypointTableModel::points() const {
+    QVector<QVector3D> all(rowCount());
+    for (int row = 0; row < all.size(); ++row)
+        all[row] = QVector3D(xs.at(row), ys.at(row), zs.at(row));
+    return all;
+}
+
+float WaypointTableModel::x(int row) const {
+    return xs.at(row);
+}
+
+float WaypointTableModel::y(int row) const {
+    return ys.at(row);
+}
+
+float WaypointTableModel::z(int row) const {
+    return zs.at(row);
+}
+
+Waypoint *WaypointTableModel::waypoint(int row) const {
+    if (row < 0 or row >= waypoints.size())
+        return nullptr;
+    return waypoints.at(row);
+}
+
+void WaypointTableModel::setWaypoint(int row, Waypoint *waypoint) {
+    waypoints[row] = waypoint;
+}
+
+void WaypointTableModel::setPoint(int row, const QVector3D &pos) {
+    if (row < 0 or row >= rowCount())
+        return;
+    if (xs.at(row) == pos.x() and ys.at(row) == pos.y() and zs.at(row) == pos.z())
+        return;
+    xs[row] = pos.x();
+    ys[row] = pos.y();
+    zs[row] = pos.z();
+
+    if (dirtyFirst < 0) {
+        dirtyFirst = dirtyLast = row;
+        QTimer::singleShot(0, this, &WaypointTableModel::flushChanges);
+    } else {
+        dirtyFirst = qMin(dirtyFirst, row);
+        dirtyLast = qMax(dirtyLast, row);
+    }
+}
+
+void WaypointTableModel::flushChanges() {
+    if (dirtyFirst < 0)
+        return;
+    auto first = qMin(dirtyFirst, rowCount() - 1);
+    auto last = qMin(dirtyLast, rowCount() - 1);
+    dirtyFirst = dirtyLast = -1;
+    if (first < 0 or last < first)
+        return;
+    Q_EMIT dataChanged(index(first, X), index(last, Z), {Qt::DisplayRole, Qt::EditRole});
+}
+
+void WaypointTableModel::clear() {
+    beginResetModel();
+    xs.clear();
+    ys.clear();
+    zs.clear();
+    waypoints.clear();
+    dirtyFirst = dirtyLast = -1;
+    endResetModel();
+}
@@ -0,0 +1,83 @@
+//
+// Created by Nic on 07/06/2022.
+//
+
+#ifndef REALTIME3D_WAYPOINTTABLEMODEL_H
+#define REALTIME3D_WAYPOINTTABLEMODEL_H
+
+
+#include <QAbstractTableModel>
+#include <QVector>
+#include <QVector3D>
+
+class Waypoint;
+
+/// Table of map points stored as one contiguous array per coordinate.
+/// Cells are formatted only when a view asks for them, and point moves are gathered into one
+/// dataChanged range per event loop pass, so dragging does not reformat rows on every pixel.
+class WaypointTableModel : public QAbstractTableModel {
+Q_OBJECT
+    QVector<float> xs;
+    QVector<float> ys;
+    QVector<float> zs;
+    QVector<Waypoint *> waypoints;
+    bool editable;
+
+    // rows moved since the last dataChanged
+    int dirtyFirst;
+    int dirtyLast;
+
+    void flushChanges();
+
+public:
+    enum Column {
+        X = 0,
+        Y = 1,
+        Z = 2
+    };
+
+    explicit WaypointTableModel(QObject *parent = nullptr, bool editable = false);
+
+    [[nodiscard]] int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+
+    [[nodiscard]] int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+
+    [[nodiscard]] QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+
+    [[nodiscard]] QVariant headerData(int section, Qt::Orientation orientation,
+                                      int role = Qt::DisplayRole) const override;
+
+    [[nodiscard]] Qt::ItemFlags flags(const QModelIndex &index) const override;
+
+    /// Edits move the waypoint, which updates the row back through setPoint
+    bool setData(const QModelIndex &index, const QVariant &value, int role = Qt::EditRole) override;
+
+    bool removeRows(int row, int count, const QModelIndex &parent = QModelIndex()) override;
+
+    /// Appends the points in a single insertion, returns the first new row
+    int appendPoints(const QVector<QVector3D> &points);
+
+    [[nodiscard]] QVector3D point(int row) const;
+
+    /// Every row as x, y, z, for export
+    [[nodiscard]] QVector<QVector3D> points() const;
+
+    [[nodiscard]] float x(int row) const;
+
+    [[nodiscard]] float y(int row) const;
+
+    [[nodiscard]] float z(int row) const;
+
+    [[nodiscard]] Waypoint *waypoint(int row) const;
+
+    void setWaypoint(int row, Waypoint *waypoint);
+
+    /// Stores the new position, the view is told once the current event has been handled
+    void setPoint(int row, const QVector3D &pos);
+
+    void clear();
+
+};
+
+
+#endif //REALTIME3D_WAYPOINTTABLEMODEL_H
@@ -35,6 +35,13 @@ GeometricSettings::GeometricSettings(QWidget *parent) :
                 ui->description->setText(methodDesc[methodLookup(index)]);
     });
 
+    connect(ui->lutDiskCache, &QCheckBox::toggled,
+            this, &SettingsForm::reportChanges);
+    connect(ui->vignettingCorrection, &QCheckBox::toggled,
+            this, &SettingsForm::reportChanges);
+    connect(ui->tcaCorrection, &QCheckBox::toggled,
+            this, &SettingsForm::reportChanges);
+
     ui->methodSelect->setInsertPolicy(QComboBox::InsertAlphabetically);
 
     setMethod(INTER_CUBIC);
@@ -56,12 +63,18 @@ void GeometricSettings::writeSettings() {
             ui->methodSelect->objectName(),
             static_cast<int>(methodLookup(ui->methodSelect->currentIndex()))
             );
+    settings.setValue(ui->lutDiskCache->objectName(), ui->lutDiskCache->isChecked());
+    settings.setValue(ui->vignettingCorrection->objectName(), ui->vignettingCorrection->isChecked());
+    settings.setValue(ui->tcaCorrection->objectName(), ui->tcaCorrection->isChecked());
 }
 
 void GeometricSettings::readSettings() {
     auto defMethod =  QVariant(static_cast<int>(INTER_CUBIC));
     auto savedMethod = settings.value(ui->methodSelect->objectName(), defMethod).toInt();
     setMethod(static_cast<InterpolationFlags>(savedMethod));
+    ui->lutDiskCache->setChecked(settings.value(ui->lutDiskCache->objectName(), true).toBool());
+    ui->vignettingCorrection->setChecked(settings.value(ui->vignettingCorrection->objectName(), false).toBool());
+    ui->tcaCorrection->setChecked(settings.value(ui->tcaCorrection->objectName(), false).toBool());
 }
 
 SettingDescriptor GeometricSettings::desc = {// NOLINT(cert-err58-cpp)
@@ -71,6 +84,9 @@ SettingDescriptor GeometricSettings::desc = {// NOLINT(cert-err58-cpp)
 
 void GeometricSettings::resetToDefault() {
     setMethod(INTER_CUBIC);
+    ui->lutDiskCache->setChecked(true);
+    ui->vignettingCorrection->setChecked(false);
+    ui->tcaCorrection->setChecked(false);
 }
 
 InterpolationFlags GeometricSettings::methodLookup(int idx) {
@@ -93,3 +109,15 @@ int GeometricSettings::getInterMethod() {
     auto defMethod =  QVariant(static_cast<int>(INTER_CUBIC));
     return getSettingValue(GeometricSettings::desc, "methodSelect", defMethod).toInt();
 }
+
+bool GeometricSettings::getLutDiskCache() {
+    return getSettingValue(GeometricSettings::desc, "lutDiskCache", true).toBool();
+}
+
+bool GeometricSettings::getVignettingCorrection() {
+    return getSettingValue(GeometricSettings::desc, "vignettingCorrection", false).toBool();
+}
+
+bool GeometricSettings::getTcaCorrection() {
+    return getSettingValue(GeometricSettings::desc, "tcaCorrection", false).toBool();
+}
@@ -48,6 +48,13 @@ public:
 
     static int getInterMethod();
 
+    /// Correction grids are also saved to disk and reused across sessions
+    static bool getLutDiskCache();
+
+    static bool getVignettingCorrection();
+
+    static bool getTcaCorrection();
+
 private:
     Ui::GeometricSettings *ui;
 
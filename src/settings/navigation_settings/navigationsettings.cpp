@@ -0,0 +1,73 @@
+//
+// Created by Nic on 02/06/2022.
+//
+
+// You may need to build the project (run Qt uic code generator) to get "ui_NavigationSettings.h" resolved
+
+#include "navigationsettings.h"
+#include "ui_NavigationSettings.h"
+
+namespace {
+    constexpr double defaultSearchRadius = 150.0;
+    constexpr int defaultImageCacheSize = 512;
+}
+
+NavigationSettings::NavigationSettings(QWidget *parent) :
+        SettingsForm(desc, parent), ui(new Ui::NavigationSettings) {
+    ui->setupUi(this);
+
+    connect(ui->searchRadius, qOverload<double>(&QDoubleSpinBox::valueChanged),
+            this, &SettingsForm::reportChanges);
+    connect(ui->pyramidSearch, &QCheckBox::toggled,
+            this, &SettingsForm::reportChanges);
+    connect(ui->imageCacheSize, qOverload<int>(&QSpinBox::valueChanged),
+            this, &SettingsForm::reportChanges);
+    connect(ui->matcher, qOverload<int>(&QComboBox::currentIndexChanged),
+            this, &SettingsForm::reportChanges);
+}
+
+NavigationSettings::~NavigationSettings() {
+    delete ui;
+}
+
+void NavigationSettings::writeSettings() {
+    settings.setValue(ui->searchRadius->objectName(), ui->searchRadius->value());
+    settings.setValue(ui->pyramidSearch->objectName(), ui->pyramidSearch->isChecked());
+    settings.setValue(ui->imageCacheSize->objectName(), ui->imageCacheSize->value());
+    settings.setValue(ui->matcher->objectName(), ui->matcher->currentIndex());
+}
+
+void NavigationSettings::readSettings() {
+    ui->searchRadius->setValue(settings.value(ui->searchRadius->objectName(), defaultSearchRadius).toDouble());
+    ui->pyramidSearch->setChecked(settings.value(ui->pyramidSearch->objectName(), false).toBool());
+    ui->imageCacheSize->setValue(settings.value(ui->imageCacheSize->objectName(), defaultImageCacheSize).toInt());
+    ui->matcher->setCurrentIndex(settings.value(ui->matcher->objectName(), PhaseCorrelation).toInt());
+}
+
+void NavigationSettings::resetToDefault() {
+    ui->searchRadius->setValue(defaultSearchRadius);
+    ui->pyramidSearch->setChecked(false);
+    ui->imageCacheSize->setValue(defaultImageCacheSize);
+    ui->matcher->setCurrentIndex(PhaseCorrelation);
+}
+
+SettingDescriptor NavigationSettings::desc = {// NOLINT(cert-err58-cpp)
+        QStringLiteral(u"settings/navigation"),
+        QStringLiteral(u"Navigation")
+};
+
+double NavigationSettings::getSearchRadius() {
+    return getSettingValue(NavigationSettings::desc, "searchRadius", defaultSearchRadius).toDouble();
+}
+
+bool NavigationSettings::getPyramidSearch() {
+    return getSettingValue(NavigationSettings::desc, "pyramidSearch", false).toBool();
+}
+
+int NavigationSettings::getImageCacheSize() {
+    return getSettingValue(NavigationSettings::desc, "imageCacheSize", defaultImageCacheSize).toInt();
+}
+
+NavigationSettings::Matcher NavigationSettings::getMatcher() {
+    return static_cast<Matcher>(getSettingValue(NavigationSettings::desc, "matcher", PhaseCorrelation).toInt());
+}
@@ -0,0 +1,55 @@
+//
+// Created by Nic on 02/06/2022.
+//
+
+#ifndef REALTIME3D_NAVIGATIONSETTINGS_H
+#define REALTIME3D_NAVIGATIONSETTINGS_H
+
+#include "../SettingsForm.h"
+
+
+QT_BEGIN_NAMESPACE
+namespace Ui { class NavigationSettings; }
+QT_END_NAMESPACE
+
+class NavigationSettings : public SettingsForm {
+Q_OBJECT
+
+public:
+    explicit NavigationSettings(QWidget *parent = nullptr);
+
+    ~NavigationSettings() override;
+
+    void writeSettings() override;
+
+    void readSettings() override;
+
+    void resetToDefault() override;
+
+    static SettingDescriptor desc;
+
+    /// Scoring of the positions in the search window, the values are passed on to the matching script
+    enum Matcher {
+        /// Phase correlation on a grid of blocks, falling back to rotation invariant and NCC matching
+        PhaseCorrelation,
+        /// Dense normalised cross correlation with sub-pixel refinement
+        NormalisedCrossCorrelation
+    };
+
+    static Matcher getMatcher();
+
+    /// Radius in metres searched around the prior position by the coarse to fine matcher
+    static double getSearchRadius();
+
+    /// Use the coarse to fine matcher for every flight image, not only after tracking is lost
+    static bool getPyramidSearch();
+
+    /// Memory budget in MiB of the image tiles shared by the base map and flight images
+    static int getImageCacheSize();
+
+private:
+    Ui::NavigationSettings *ui;
+};
+
+
+#endif //REALTIME3D_NAVIGATIONSETTINGS_H
@@ -35,6 +35,9 @@ SettingsMenu::SettingsMenu(QWidget *parent) :
     geometricSettings = new GeometricSettings();
     addSettingsField(geometricSettings);
 
+    navigationSettings = new NavigationSettings();
+    addSettingsField(navigationSettings);
+
 }
 
 SettingsMenu::~SettingsMenu() {
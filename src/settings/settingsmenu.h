@@ -13,6 +13,7 @@
 #include "dem_behaviour/dembehaviour.h"
 #include "general_settings/generalsettings.h"
 #include "geometric_settings/geometricsettings.h"
+#include "navigation_settings/navigationsettings.h"
 
 
 QT_BEGIN_NAMESPACE
@@ -33,6 +34,7 @@ public:
     PathSettings *pathSettings;
     DemBehaviour *demBehaviour;
     GeometricSettings *geometricSettings;
+    NavigationSettings *navigationSettings;
     void setSettingsField(int index);
 
 Q_SIGNALS:
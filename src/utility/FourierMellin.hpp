@@ -0,0 +1,90 @@
+//
+// Created by Nic on 20/06/2022.
+//
+
+#ifndef REALTIME3D_FOURIERMELLIN_HPP
+#define REALTIME3D_FOURIERMELLIN_HPP
+
+#include "PhaseCorrelation.hpp"
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+#include <cmath>
+
+/// Rotation and scale between two images from their magnitude spectra (Fourier-Mellin).
+/// The magnitude does not change with translation, and resampled on a log-polar grid a rotation or scaling
+/// of the image becomes a shift along the angle or log-radius axis, found by phase correlation.
+/// Used by the pair pre-registration and, through rt3d_fourier_mellin, by the flight image matcher.
+namespace fm {
+
+    /// Moves the zero frequency to the centre, the sides must be even
+    inline void shiftQuadrants(cv::Mat &spectrum) {
+        auto cx = spectrum.cols / 2;
+        auto cy = spectrum.rows / 2;
+        cv::Mat q0(spectrum, cv::Rect(0, 0, cx, cy)), q1(spectrum, cv::Rect(cx, 0, cx, cy));
+        cv::Mat q2(spectrum, cv::Rect(0, cy, cx, cy)), q3(spectrum, cv::Rect(cx, cy, cx, cy));
+        cv::Mat swap;
+        q0.copyTo(swap);
+        q3.copyTo(q0);
+        swap.copyTo(q3);
+        q1.copyTo(swap);
+        q2.copyTo(q1);
+        swap.copyTo(q2);
+    }
+
+    /// Emphasises the high frequencies that carry the rotation, (1 - X)(2 - X) with X = cos(pi u) cos(pi v)
+    inline cv::Mat highPassFilter(int side) {
+        cv::Mat filter(side, side, CV_32F);
+        for (int y = 0; y < side; y++) {
+            auto cy = std::cos(CV_PI * (double(y) / (side - 1) - 0.5));
+            auto row = filter.ptr<float>(y);
+            for (int x = 0; x < side; x++) {
+                auto X = std::cos(CV_PI * (double(x) / (side - 1) - 0.5)) * cy;
+                row[x] = float((1.0 - X) * (2.0 - X));
+            }
+        }
+        return filter;
+    }
+
+    /// Centred magnitude spectrum of a square CV_32F block, mean removed and windowed
+    inline cv::Mat centredMagnitude(const cv::Mat &square, const cv::Mat &window) {
+        cv::Mat centred = square - cv::mean(square);
+        cv::Mat planes[2];
+        cv::Mat complex;
+        cv::dft(centred.mul(window), complex, cv::DFT_COMPLEX_OUTPUT);
+        cv::split(complex, planes);
+        cv::Mat magnitude;
+        cv::magnitude(planes[0], planes[1], magnitude);
+        shiftQuadrants(magnitude);
+        return magnitude;
+    }
+
+    /// polarSize x polarSize log-polar resampling of a centred square magnitude after the high pass,
+    /// rows are angles over the full turn, columns the log of the radius
+    inline cv::Mat logPolar(const cv::Mat &magnitude, const cv::Mat &highPass, int polarSize) {
+        auto side = magnitude.cols;
+        cv::Mat polar;
+        cv::warpPolar(magnitude.mul(highPass), polar, cv::Size(polarSize, polarSize),
+                      cv::Point2f(side / 2.0f, side / 2.0f), side / 2.0, cv::INTER_LINEAR | cv::WARP_POLAR_LOG);
+        return polar;
+    }
+
+    struct Similarity {
+        /// Counter-clockwise degrees, as cv::getRotationMatrix2D takes them
+        double angle = 0.0;
+        double scale = 1.0;
+        /// Phase correlation peak of the log-polar magnitudes, 0 to 1
+        double response = 0.0;
+    };
+
+    /// Rotation and scale that map the secondary onto the reference, from the log-polar magnitudes of blocks
+    /// of the given side. A spectrum cannot tell the angle from the one half a turn away.
+    inline Similarity rotationScale(const cv::Mat &referencePolar, const cv::Mat &secondaryPolar, int side) {
+        Similarity similarity;
+        auto shift = phase::correlate(referencePolar, secondaryPolar, cv::Mat(), &similarity.response);
+        similarity.angle = shift.y * 360.0 / referencePolar.rows;
+        similarity.scale = std::exp(shift.x * std::log(side / 2.0) / referencePolar.cols);
+        return similarity;
+    }
+}
+
+#endif //REALTIME3D_FOURIERMELLIN_HPP
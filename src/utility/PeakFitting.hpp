@@ -0,0 +1,319 @@
+//
+// Created by Nic on 18/06/2022.
+//
+
+#ifndef REALTIME3D_PEAKFITTING_HPP
+#define REALTIME3D_PEAKFITTING_HPP
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <utility>
+#include <vector>
+
+/// Sub-pixel location of the maximum of a correlation surface.
+/// Parabolic and Gaussian fit three samples on each axis, LeastSquares fits a 2D quadratic to the neighbourhood
+/// and Robust does the same with Tukey weights, so a neighbour on a second peak does not pull the vertex.
+/// The batch functions take one array per sample, so a loop over many windows vectorises.
+namespace peak {
+
+    enum class Method {
+        Parabolic,
+        Gaussian,
+        LeastSquares,
+        Robust
+    };
+
+    template<typename T>
+    struct Peak {
+        T x;
+        T y;
+        /// of the fitted surface at (x, y)
+        T value;
+    };
+
+    /// Row major view of a surface, stride in elements
+    template<typename T>
+    struct Surface {
+        const T *data;
+        int width;
+        int height;
+        std::ptrdiff_t stride;
+
+        Surface(const T *data, int width, int height, std::ptrdiff_t stride = 0) :
+                data(data), width(width), height(height), stride(stride > 0 ? stride : width) {}
+
+        T operator()(int x, int y) const { return data[y * stride + x]; }
+    };
+
+    /// Vertex offset from the centre sample, within half a sample of it when the centre is the largest
+    template<typename T>
+    inline T parabolic(T left, T centre, T right) {
+        auto d = left - 2 * centre + right;
+        return d < 0 ? std::clamp(T(0.5) * (left - right) / d, T(-1), T(1)) : T(0);
+    }
+
+    /// Parabolic fit of the logarithms, exact for a Gaussian peak. Parabolic when a sample is not positive.
+    template<typename T>
+    inline T gaussian(T left, T centre, T right) {
+        if (left <= 0 or centre <= 0 or right <= 0)
+            return parabolic(left, centre, right);
+        return parabolic(std::log(left), std::log(centre), std::log(right));
+    }
+
+    template<typename T>
+    inline void parabolic(const T *left, const T *centre, const T *right, T *offset, std::size_t n) {
+        for (std::size_t i = 0; i < n; i++) {
+            auto d = left[i] - 2 * centre[i] + right[i];
+            auto vertex = T(0.5) * (left[i] - right[i]) / (d < 0 ? d : T(-1));
+            offset[i] = d < 0 ? std::clamp(vertex, T(-1), T(1)) : T(0);
+        }
+    }
+
+    template<typename T>
+    inline void gaussian(const T *left, const T *centre, const T *right, T *offset, std::size_t n) {
+        for (std::size_t i = 0; i < n; i++)
+            offset[i] = gaussian(left[i], centre[i], right[i]);
+    }
+
+    template<typename T>
+    inline std::pair<int, int> argmax(const Surface<T> &surface) {
+        int bestX = 0, bestY = 0;
+        auto best = surface(0, 0);
+        for (int y = 0; y < surface.height; y++) {
+            auto row = surface.data + y * surface.stride;
+            auto x = int(std::max_element(row, row + surface.width) - row);
+            if (row[x] > best) {
+                best = row[x];
+                bestX = x;
+                bestY = y;
+            }
+        }
+        return {bestX, bestY};
+    }
+
+    namespace detail {
+        /// z = c0 + c1 x + c2 y + c3 x^2 + c4 x y + c5 y^2
+        using Quadratic = std::array<double, 6>;
+
+        inline std::array<double, 6> terms(double x, double y) {
+            return {1.0, x, y, x * x, x * y, y * y};
+        }
+
+        /// Samples as fitted, the logarithm of a Gaussian is a quadratic, samples that have none are left out
+        inline bool sample(double value, bool logarithm, double &z) {
+            if (not logarithm) {
+                z = value;
+                return true;
+            }
+            if (value <= 0)
+                return false;
+            z = std::log(value);
+            return true;
+        }
+
+        /// Weighted least squares over the samples, false when they do not fix the quadratic
+        template<typename T>
+        bool fitQuadratic(const Surface<T> &surface, int cx, int cy, int radius,
+                          const std::vector<double> &weights, bool logarithm, Quadratic &q) {
+            double a[6][7] = {};
+            int k = 0;
+            for (int dy = -radius; dy <= radius; dy++) {
+                for (int dx = -radius; dx <= radius; dx++, k++) {
+                    auto x = cx + dx, y = cy + dy;
+                    double z;
+                    if (x < 0 or y < 0 or x >= surface.width or y >= surface.height or weights[k] <= 0
+                        or not sample(double(surface(x, y)), logarithm, z))
+                        continue;
+                    auto t = terms(dx, dy);
+                    for (int i = 0; i < 6; i++) {
+                        for (int j = 0; j < 6; j++)
+                            a[i][j] += weights[k] * t[i] * t[j];
+                        a[i][6] += weights[k] * t[i] * z;
+                    }
+                }
+            }
+            // Gaussian elimination with partial pivoting of the normal equations
+            for (int c = 0; c < 6; c++) {
+                int pivot = c;
+                for (int r = c + 1; r < 6; r++)
+                    if (std::abs(a[r][c]) > std::abs(a[pivot][c]))
+                        pivot = r;
+                if (std::abs(a[pivot][c]) < 1e-12)
+                    return false;
+                std::swap(a[c], a[pivot]);
+                for (int r = c + 1; r < 6; r++) {
+                    auto f = a[r][c] / a[c][c];
+                    for (int j = c; j < 7; j++)
+                        a[r][j] -= f * a[c][j];
+                }
+            }
+            for (int r = 5; r >= 0; r--) {
+                auto sum = a[r][6];
+                for (int j = r + 1; j < 6; j++)
+                    sum -= a[r][j] * q[j];
+                q[r] = sum / a[r][r];
+            }
+            return true;
+        }
+
+        inline double evaluate(const Quadratic &q, double x, double y) {
+            auto t = terms(x, y);
+            double z = 0;
+            for (int i = 0; i < 6; i++)
+                z += q[i] * t[i];
+            return z;
+        }
+
+        /// Vertex of a quadratic with a maximum, within radius of the centre
+        template<typename T>
+        bool vertex(const Quadratic &q, int radius, T &dx, T &dy) {
+            auto a = 2 * q[3], b = q[4], c = 2 * q[5];
+            auto det = a * c - b * b;
+            if (a >= 0 or det <= 0)
+                return false;
+            auto x = (-q[1] * c + q[2] * b) / det;
+            auto y = (-q[2] * a + q[1] * b) / det;
+            if (std::abs(x) > radius or std::abs(y) > radius)
+                return false;
+            dx = T(x);
+            dy = T(y);
+            return true;
+        }
+    }
+
+    template<typename T>
+    inline Peak<T> separable(const Surface<T> &surface, int x, int y, Method method) {
+        auto fit = [method](T a, T b, T c) {
+            return method == Method::Gaussian ? gaussian(a, b, c) : parabolic(a, b, c);
+        };
+        auto centre = surface(x, y);
+        auto dx = 0 < x and x < surface.width - 1 ? fit(surface(x - 1, y), centre, surface(x + 1, y)) : T(0);
+        auto dy = 0 < y and y < surface.height - 1 ? fit(surface(x, y - 1), centre, surface(x, y + 1)) : T(0);
+        return {x + dx, y + dy, centre};
+    }
+
+    /// 2D quadratic over the (2 radius + 1)^2 neighbourhood, parabolic when it has no maximum there
+    template<typename T>
+    inline Peak<T> leastSquares(const Surface<T> &surface, int x, int y, int radius = 1) {
+        auto side = 2 * radius + 1;
+        detail::Quadratic q{};
+        T dx, dy;
+        if (detail::fitQuadratic(surface, x, y, radius, std::vector<double>(side * side, 1.0), false, q)
+            and detail::vertex(q, radius, dx, dy))
+            return {x + dx, y + dy, T(detail::evaluate(q, dx, dy))};
+        return separable(surface, x, y, Method::Parabolic);
+    }
+
+    /// 2D Gaussian, a quadratic fitted to the logarithms, over the (2 radius + 1)^2 neighbourhood.
+    /// Reweighted with Tukey's biweight of the residuals so samples off the peak, e.g. on a second one, drop out.
+    template<typename T>
+    inline Peak<T> robust(const Surface<T> &surface, int x, int y, int radius = 2, int iterations = 4) {
+        auto side = 2 * radius + 1;
+        std::vector<double> weights(side * side, 1.0);
+        detail::Quadratic q{};
+        if (not detail::fitQuadratic(surface, x, y, radius, weights, true, q))
+            return separable(surface, x, y, Method::Gaussian);
+
+        std::vector<double> residuals(weights.size(), 0.0);
+        for (int iteration = 0; iteration < iterations; iteration++) {
+            std::vector<double> magnitudes;
+            int k = 0;
+            for (int dy = -radius; dy <= radius; dy++) {
+                for (int dx = -radius; dx <= radius; dx++, k++) {
+                    auto sx = x + dx, sy = y + dy;
+                    double z;
+                    if (sx < 0 or sy < 0 or sx >= surface.width or sy >= surface.height
+                        or not detail::sample(double(surface(sx, sy)), true, z)) {
+                        residuals[k] = std::numeric_limits<double>::infinity();
+                        continue;
+                    }
+                    residuals[k] = z - detail::evaluate(q, dx, dy);
+                    magnitudes.push_back(std::abs(residuals[k]));
+                }
+            }
+            // scale from the median absolute residual, 4.685 sigma is the usual biweight cut off
+            auto middle = magnitudes.begin() + magnitudes.size() / 2;
+            std::nth_element(magnitudes.begin(), middle, magnitudes.end());
+            auto cut = 4.685 * 1.4826 * *middle;
+            if (cut <= 1e-12)
+                break;
+            for (std::size_t i = 0; i < weights.size(); i++) {
+                auto u = residuals[i] / cut;
+                weights[i] = std::abs(u) < 1 ? (1 - u * u) * (1 - u * u) : 0.0;
+            }
+            detail::Quadratic next{};
+            if (not detail::fitQuadratic(surface, x, y, radius, weights, true, next))
+                break;
+            q = next;
+        }
+
+        T dx, dy;
+        if (detail::vertex(q, radius, dx, dy))
+            return {x + dx, y + dy, T(std::exp(detail::evaluate(q, dx, dy)))};
+        return separable(surface, x, y, Method::Gaussian);
+    }
+
+    /// Sub-pixel peak around the sample (x, y)
+    template<typename T>
+    inline Peak<T> fit(const Surface<T> &surface, int x, int y, Method method = Method::Gaussian) {
+        switch (method) {
+            case Method::LeastSquares:
+                return leastSquares(surface, x, y);
+            case Method::Robust:
+                return robust(surface, x, y);
+            default:
+                return separable(surface, x, y, method);
+        }
+    }
+
+    /// Sub-pixel maximum of the surface
+    template<typename T>
+    inline Peak<T> locate(const Surface<T> &surface, Method method = Method::Gaussian) {
+        auto[x, y] = argmax(surface);
+        return fit(surface, x, y, method);
+    }
+
+    /// Sub-pixel maxima of count windows of width x height, stored one after the other.
+    /// The three point fits run over all windows at once, the samples gathered one array per position.
+    template<typename T>
+    void locateAll(const T *windows, std::size_t count, int width, int height, Method method, Peak<T> *peaks) {
+        auto size = std::size_t(width) * height;
+        if (method == Method::LeastSquares or method == Method::Robust) {
+            for (std::size_t i = 0; i < count; i++)
+                peaks[i] = locate(Surface<T>(windows + i * size, width, height), method);
+            return;
+        }
+
+        // left, centre, right, up and down neighbours of each window's maximum, edges repeat the centre
+        std::vector<T> samples(5 * count);
+        auto left = samples.data(), centre = left + count, right = centre + count;
+        auto up = right + count, down = up + count;
+        std::vector<std::pair<int, int>> maxima(count);
+        for (std::size_t i = 0; i < count; i++) {
+            Surface<T> surface(windows + i * size, width, height);
+            auto[x, y] = maxima[i] = argmax(surface);
+            centre[i] = surface(x, y);
+            left[i] = x > 0 ? surface(x - 1, y) : centre[i];
+            right[i] = x < width - 1 ? surface(x + 1, y) : centre[i];
+            up[i] = y > 0 ? surface(x, y - 1) : centre[i];
+            down[i] = y < height - 1 ? surface(x, y + 1) : centre[i];
+        }
+
+        std::vector<T> offsets(2 * count);
+        auto dx = offsets.data(), dy = dx + count;
+        if (method == Method::Gaussian) {
+            gaussian(left, centre, right, dx, count);
+            gaussian(up, centre, down, dy, count);
+        } else {
+            parabolic(left, centre, right, dx, count);
+            parabolic(up, centre, down, dy, count);
+        }
+        for (std::size_t i = 0; i < count; i++)
+            peaks[i] = {maxima[i].first + dx[i], maxima[i].second + dy[i], centre[i]};
+    }
+}
+
+#endif //REALTIME3D_PEAKFITTING_HPP
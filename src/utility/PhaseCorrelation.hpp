@@ -0,0 +1,62 @@
+//
+// Created by Nic on 20/06/2022.
+//
+
+#ifndef REALTIME3D_PHASECORRELATION_HPP
+#define REALTIME3D_PHASECORRELATION_HPP
+
+#include "PeakFitting.hpp"
+#include <opencv2/core.hpp>
+#include <cfloat>
+
+/// Phase correlation with the sub-pixel peak of PeakFitting.hpp, so the C++ correlators locate their peaks
+/// as the matching scripts do rather than with the weighted centroid of cv::phaseCorrelate.
+namespace phase {
+
+    /// Moves element 0 of each axis to the middle, as numpy.fft.fftshift, for any size
+    inline cv::Mat centred(const cv::Mat &surface) {
+        auto w = surface.cols, h = surface.rows;
+        auto sx = w - w / 2, sy = h - h / 2;
+        cv::Mat shifted(surface.size(), surface.type());
+        surface(cv::Rect(sx, sy, w - sx, h - sy)).copyTo(shifted(cv::Rect(0, 0, w - sx, h - sy)));
+        surface(cv::Rect(0, sy, sx, h - sy)).copyTo(shifted(cv::Rect(w - sx, 0, sx, h - sy)));
+        surface(cv::Rect(sx, 0, w - sx, sy)).copyTo(shifted(cv::Rect(0, h - sy, w - sx, sy)));
+        surface(cv::Rect(0, 0, sx, sy)).copyTo(shifted(cv::Rect(w - sx, h - sy, sx, sy)));
+        return shifted;
+    }
+
+    /// Normalised cross power surface of two CV_32F images of one size, zero shift in the middle, peak 1 at most
+    inline cv::Mat surface(const cv::Mat &a, const cv::Mat &b, const cv::Mat &window = cv::Mat()) {
+        cv::Mat fa, fb;
+        cv::dft(window.empty() ? a : a.mul(window), fa, cv::DFT_COMPLEX_OUTPUT);
+        cv::dft(window.empty() ? b : b.mul(window), fb, cv::DFT_COMPLEX_OUTPUT);
+        cv::Mat cross;
+        cv::mulSpectrums(fa, fb, cross, 0, true);
+
+        cv::Mat planes[2];
+        cv::split(cross, planes);
+        cv::Mat magnitude;
+        cv::magnitude(planes[0], planes[1], magnitude);
+        magnitude += FLT_EPSILON;
+        cv::divide(planes[0], magnitude, planes[0]);
+        cv::divide(planes[1], magnitude, planes[1]);
+        cv::merge(planes, 2, cross);
+
+        cv::Mat correlation;
+        cv::idft(cross, correlation, cv::DFT_REAL_OUTPUT | cv::DFT_SCALE);
+        return centred(correlation);
+    }
+
+    /// Shift of b relative to a, as cv::phaseCorrelate returns it. response, when given, is set to the fitted peak.
+    inline cv::Point2d correlate(const cv::Mat &a, const cv::Mat &b, const cv::Mat &window = cv::Mat(),
+                                 double *response = nullptr, peak::Method method = peak::Method::Gaussian) {
+        auto correlation = surface(a, b, window);
+        auto p = peak::locate(peak::Surface<float>(correlation.ptr<float>(), correlation.cols, correlation.rows,
+                                                   std::ptrdiff_t(correlation.step1())), method);
+        if (response)
+            *response = std::clamp(double(p.value), 0.0, 1.0);
+        return {correlation.cols / 2 - double(p.x), correlation.rows / 2 - double(p.y)};
+    }
+}
+
+#endif //REALTIME3D_PHASECORRELATION_HPP
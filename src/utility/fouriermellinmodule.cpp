@@ -0,0 +1,76 @@
+//
+// Created by Nic on 20/06/2022.
+//
+
+// rt3d_fourier_mellin, the rotation and scale estimate of FourierMellin.hpp for the matching scripts.
+// Embedded in the application, and built as the extension module of the same name for the scripts run on their own.
+
+#include "FourierMellin.hpp"
+#include <pybind11/numpy.h>
+
+#ifdef RT3D_PYTHON_EXTENSION
+#include <pybind11/pybind11.h>
+#define RT3D_MODULE PYBIND11_MODULE
+#else
+#include <pybind11/embed.h>
+#define RT3D_MODULE PYBIND11_EMBEDDED_MODULE
+#endif
+
+namespace py = pybind11;
+
+namespace {
+    using Array = py::array_t<float, py::array::c_style | py::array::forcecast>;
+
+    cv::Mat matOf(const Array &image) {
+        if (image.ndim() != 2)
+            throw py::value_error("array must be 2D");
+        return {int(image.shape(0)), int(image.shape(1)), CV_32F, const_cast<float *>(image.data())};
+    }
+
+    Array arrayOf(const cv::Mat &mat) {
+        Array result({py::ssize_t(mat.rows), py::ssize_t(mat.cols)});
+        mat.copyTo(cv::Mat(mat.rows, mat.cols, CV_32F, result.mutable_data()));
+        return result;
+    }
+
+    /// The flight matcher asks for blocks of one side, the filter is kept for the last side
+    const cv::Mat &highPassFor(int side) {
+        thread_local cv::Mat filter;
+        if (filter.cols != side)
+            filter = fm::highPassFilter(side);
+        return filter;
+    }
+}
+
+RT3D_MODULE(rt3d_fourier_mellin, m) {
+    m.doc() = "Rotation and scale between two images from their log-polar magnitude spectra";
+
+    m.def("log_polar_magnitude", [](const Array &magnitude, int polarSize) {
+        auto mat = matOf(magnitude);
+        if (mat.rows != mat.cols)
+            throw py::value_error("magnitude must be square");
+        cv::Mat polar;
+        {
+            py::gil_scoped_release release;
+            polar = fm::logPolar(mat, highPassFor(mat.cols), polarSize);
+        }
+        return arrayOf(polar);
+    }, py::arg("magnitude"), py::arg("polar_size"),
+          "polar_size x polar_size log-polar resampling of a centred square magnitude spectrum after the high pass, "
+          "rows are angles over the full turn");
+
+    m.def("rotation_scale", [](const Array &referencePolar, const Array &secondaryPolar, int side) {
+        auto reference = matOf(referencePolar);
+        auto secondary = matOf(secondaryPolar);
+        if (reference.size() != secondary.size())
+            throw py::value_error("log-polar magnitudes differ in size");
+        fm::Similarity similarity;
+        {
+            py::gil_scoped_release release;
+            similarity = fm::rotationScale(reference, secondary, side);
+        }
+        return py::make_tuple(similarity.angle, similarity.scale, similarity.response);
+    }, py::arg("reference_polar"), py::arg("secondary_polar"), py::arg("side"),
+          "(angle, scale, response) mapping the secondary onto the reference, angle in degrees counter-clockwise "
+          "as cv.getRotationMatrix2D takes it");
+}
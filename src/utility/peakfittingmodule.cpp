@@ -0,0 +1,71 @@
+//
+// Created by Nic on 18/06/2022.
+//
+
+// rt3d_peak, the peak fitting of PeakFitting.hpp for the matching scripts.
+// Embedded in the application, and built as the extension module of the same name for the scripts run on their own.
+
+#include "PeakFitting.hpp"
+#include <pybind11/numpy.h>
+
+#ifdef RT3D_PYTHON_EXTENSION
+#include <pybind11/pybind11.h>
+#define RT3D_MODULE PYBIND11_MODULE
+#else
+#include <pybind11/embed.h>
+#define RT3D_MODULE PYBIND11_EMBEDDED_MODULE
+#endif
+
+namespace py = pybind11;
+
+namespace {
+    using Array = py::array_t<double, py::array::c_style | py::array::forcecast>;
+
+    peak::Surface<double> surfaceOf(const Array &surface) {
+        if (surface.ndim() != 2)
+            throw py::value_error("surface must be 2D");
+        return {surface.data(), int(surface.shape(1)), int(surface.shape(0))};
+    }
+
+    py::tuple toTuple(const peak::Peak<double> &p) {
+        return py::make_tuple(p.x, p.y, p.value);
+    }
+}
+
+RT3D_MODULE(rt3d_peak, m) {
+    m.doc() = "Sub-pixel peak fitting, methods: 0 parabolic, 1 gaussian, 2 least squares, 3 robust";
+
+    m.def("fit", [](const Array &surface, int x, int y, int method) {
+        auto s = surfaceOf(surface);
+        if (x < 0 or y < 0 or x >= s.width or y >= s.height)
+            throw py::index_error("peak outside the surface");
+        return toTuple(peak::fit(s, x, y, static_cast<peak::Method>(method)));
+    }, py::arg("surface"), py::arg("x"), py::arg("y"), py::arg("method") = int(peak::Method::Gaussian),
+          "(x, y, value) of the peak around the sample (x, y)");
+
+    m.def("locate", [](const Array &surface, int method) {
+        return toTuple(peak::locate(surfaceOf(surface), static_cast<peak::Method>(method)));
+    }, py::arg("surface"), py::arg("method") = int(peak::Method::Gaussian),
+          "(x, y, value) of the maximum of the surface");
+
+    m.def("locate_all", [](const Array &windows, int method) {
+        if (windows.ndim() != 3)
+            throw py::value_error("windows must be count x height x width");
+        auto count = std::size_t(windows.shape(0));
+        std::vector<peak::Peak<double>> peaks(count);
+        {
+            py::gil_scoped_release release;
+            peak::locateAll(windows.data(), count, int(windows.shape(2)), int(windows.shape(1)),
+                            static_cast<peak::Method>(method), peaks.data());
+        }
+        Array result({py::ssize_t(count), py::ssize_t(3)});
+        auto out = result.mutable_unchecked<2>();
+        for (std::size_t i = 0; i < count; i++) {
+            out(i, 0) = peaks[i].x;
+            out(i, 1) = peaks[i].y;
+            out(i, 2) = peaks[i].value;
+        }
+        return result;
+    }, py::arg("windows"), py::arg("method") = int(peak::Method::Gaussian),
+          "count x 3 array of the (x, y, value) maxima of each window");
+}
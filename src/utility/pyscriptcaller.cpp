@@ -5,28 +5,63 @@
 #include <QPixmap>
 #include <QDebug>
 #include <pybind11/embed.h> // everything needed for embedding
+#include <pybind11/stl.h>
+#include <string>
+#include <unordered_map>
 
 namespace py = pybind11;
 using namespace py::literals;
 
-std::string pycall::perspectiveMatching(const std::string &outputDir, const std::string &nadirImagePath,
-                                        const std::string &obliqueImagePath, bool saveImages) {
-    py::gil_scoped_acquire acquire;
+namespace {
+    /// The functions called from here, imported by warmUp
+    const std::pair<const char *, const char *> scriptFunctions[] = {
+            {"scripts.image_processing",  "match_aerial_to_map"},
+            {"scripts.image_processing",  "match_aerial_to_map_pyramid"},
+            {"scripts.image_processing",  "prebuild_map_corridor"},
+            {"scripts.video2frames",      "make_frames_dir"},
+            {"scripts.video2frames",      "video2frames"},
+            {"scripts.dat2tiff",          "dat2tiff"},
+            {"scripts.dat2tiff",          "dir_dat2tiff"},
+    };
+
+    /// module.name to function, only used with the GIL held
+    std::unordered_map<std::string, py::object> functions;
+
+    /// The function, imported at the first call if warmUp has not resolved it. The caller holds the GIL.
+    py::object function(const char *module, const char *name) {
+        auto key = std::string(module) + '.' + name;
+        auto found = functions.find(key);
+        if (found != functions.end())
+            return found->second;
+        auto resolved = py::module_::import(module).attr(name);
+        functions.emplace(key, resolved);
+        return resolved;
+    }
+}
 
-    try {
-        auto match_images = py::module_::import("scripts.image_matching_v2").attr("match_images");
-        auto matchedImagePath = match_images(outputDir, nadirImagePath, obliqueImagePath);
-        return py::cast<std::string>(matchedImagePath);
-    } catch (py::error_already_set &e) {
-        qDebug() << e.what();
+int pycall::warmUp() {
+    py::gil_scoped_acquire acquire;
+    int resolved = 0;
+    for (const auto &[module, name]: scriptFunctions) {
+        try {
+            function(module, name);
+            resolved += 1;
+        } catch (py::error_already_set &e) {
+            qWarning() << "Could not import" << module << name << e.what();
+        }
     }
-    return {};
+    return resolved;
+}
+
+void pycall::releaseFunctions() {
+    py::gil_scoped_acquire acquire;
+    functions.clear();
 }
 
 std::string pycall::makeFramesDir(const std::string &videoFilePath) {
     py::gil_scoped_acquire acquire;
     try {
-        auto framesDir = py::module_::import("scripts.video2frames").attr("make_frames_dir");
+        auto framesDir = function("scripts.video2frames", "make_frames_dir");
         return py::cast<std::string>(framesDir(videoFilePath));
     } catch (py::error_already_set &e) {
         qDebug() << e.what();
@@ -37,7 +72,7 @@ std::string pycall::makeFramesDir(const std::string &videoFilePath) {
 void pycall::video2frames(const std::string &videoFilePath, const std::string &framesDir, double frameRate) {
     py::gil_scoped_acquire acquire;
     try {
-        auto video_2_frames = py::module_::import("scripts.video2frames").attr("video2frames");
+        auto video_2_frames = function("scripts.video2frames", "video2frames");
         video_2_frames(videoFilePath, framesDir, frameRate);
     } catch (py::error_already_set &e) {
         qDebug() << e.what();
@@ -49,7 +84,7 @@ void pycall::video2frames(const std::string &videoFilePath,
                           double frameRate, int maximum) {
     py::gil_scoped_acquire acquire;
     try {
-        auto video_2_frames = py::module_::import("scripts.video2frames").attr("video2frames");
+        auto video_2_frames = function("scripts.video2frames", "video2frames");
         video_2_frames(videoFilePath, framesDir, frameRate, maximum);
     } catch (py::error_already_set &e) {
         qDebug() << e.what();
@@ -57,14 +92,33 @@ void pycall::video2frames(const std::string &videoFilePath,
 }
 
 // extra: pass image data directly
-std::tuple<int, int>
-pycall::matchAerialToMap(const std::string &aerialImage, const std::string &baseMap, int x, int y) {
+std::tuple<int, int, double>
+pycall::matchAerialToMap(const std::string &aerialImage, const std::string &baseMap, int x, int y,
+                         int searchWindow, int matcher) {
+    py::gil_scoped_acquire acquire;
+
+    try {
+        auto aerialMatching = function("scripts.image_processing", "match_aerial_to_map");
+        py::tuple pos = aerialMatching(aerialImage, baseMap, x, y, searchWindow, matcher);
+        if (pos.size() > 3)
+            qDebug() << "Matched" << aerialImage.c_str() << "by" << py::cast<std::string>(pos[3]).c_str();
+        return {py::cast<int>(pos[0]), py::cast<int>(pos[1]), py::cast<double>(pos[2])};
+    } catch (py::error_already_set &e) {
+        qDebug() << e.what();
+    }
+
+    return {};
+}
+
+std::tuple<int, int, double>
+pycall::matchAerialToMapPyramid(const std::string &aerialImage, const std::string &baseMap, int x, int y,
+                                int searchRadius) {
     py::gil_scoped_acquire acquire;
 
     try {
-        auto aerialMatching = py::module_::import("scripts.image_processing").attr("match_aerial_to_map");
-        py::tuple pos = aerialMatching(aerialImage, baseMap, x, y);
-        return {py::cast<int>(pos[0]), py::cast<int>(pos[1])};
+        auto aerialMatching = function("scripts.image_processing", "match_aerial_to_map_pyramid");
+        py::tuple pos = aerialMatching(aerialImage, baseMap, x, y, searchRadius);
+        return {py::cast<int>(pos[0]), py::cast<int>(pos[1]), py::cast<double>(pos[2])};
     } catch (py::error_already_set &e) {
         qDebug() << e.what();
     }
@@ -72,11 +126,24 @@ pycall::matchAerialToMap(const std::string &aerialImage, const std::string &base
     return {};
 }
 
+int pycall::prebuildTileBank(const std::string &baseMap, const std::vector<std::tuple<int, int>> &points) {
+    py::gil_scoped_acquire acquire;
+
+    try {
+        auto prebuild = function("scripts.image_processing", "prebuild_map_corridor");
+        return py::cast<int>(prebuild(baseMap, points));
+    } catch (py::error_already_set &e) {
+        qDebug() << e.what();
+    }
+
+    return 0;
+}
+
 bool pycall::dat2tiff_dir(const std::string &dirname) {
     py::gil_scoped_acquire acquire;
     qDebug() << "Converting .dat files in Folder to .tiff";
     try {
-        auto dat2tiff_dir = py::module_::import("scripts.dat2tiff").attr("dir_dat2tiff");
+        auto dat2tiff_dir = function("scripts.dat2tiff", "dir_dat2tiff");
         dat2tiff_dir(dirname);
         return true;
     } catch (py::error_already_set &e) {
@@ -89,7 +156,7 @@ bool pycall::dat2tiff(const std::string &filename) {
     py::gil_scoped_acquire acquire;
     qInfo() << "Converting .dat to .tiff";
     try {
-        auto dat2tiff = py::module_::import("scripts.dat2tiff").attr("dat2tiff");
+        auto dat2tiff = function("scripts.dat2tiff", "dat2tiff");
         dat2tiff(filename);
         return true;
     } catch (py::error_already_set &e) {
@@ -98,26 +165,3 @@ bool pycall::dat2tiff(const std::string &filename) {
     }
 }
 
-void
-pycall::correctDistortion(const std::string &imagePath,
-                          const std::string &cameraMaker,
-                          const std::string &cameraModel,
-                          const std::string &lensMaker,
-                          const std::string &lensModel,
-                          double focalLength,
-                          double aperture,
-                          double distanceToSubject,
-                          int interMethod) {
-    py::gil_scoped_acquire acquire;
-
-    try {
-        auto correctDistortion = py::module_::import("scripts.lens_correction").attr("correct_distortion");
-        correctDistortion(imagePath, cameraMaker, cameraModel, lensMaker, lensModel,
-                          focalLength, aperture, distanceToSubject, interMethod);
-
-    } catch (py::error_already_set &e) {
-        qDebug() << e.what();
-    }
-}
-
-
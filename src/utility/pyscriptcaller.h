@@ -6,36 +6,46 @@
 #define REALTIME3D_PYSCRIPTCALLER_H
 
 #include <string>
+#include <tuple>
+#include <vector>
 
 namespace pycall {
-    bool dat2tiff(const std::string &filename);
+    /// Imports the scripts and resolves the functions called here, so calls do not look them up.
+    /// Returns the number resolved, scripts that fail to import are logged and looked up again when called.
+    int warmUp();
 
-    bool dat2tiff_dir(const std::string &dirname);
+    /// Drops the resolved functions, called with the interpreter still running
+    void releaseFunctions();
 
-    std::string perspectiveMatching(const std::string &outputDir,
-                                    const std::string &nadirImagePath,
-                                    const std::string &obliqueImagePath,
-                                    bool saveImages = true);
+    bool dat2tiff(const std::string &filename);
 
+    bool dat2tiff_dir(const std::string &dirname);
 
-    std::tuple<int, int> matchAerialToMap(const std::string &aerialImage,
-                                          const std::string &baseMap,
-                                          int x, int y);
+    /// Returns the matched position and its confidence, the phase correlation peak or the NCC from 0 to 1,
+    /// 0 for an NCC below its acceptance threshold. The stage that gave the match is logged.
+    /// searchWindow is the side of the square base map region searched around x, y,
+    /// matcher a NavigationSettings::Matcher.
+    std::tuple<int, int, double> matchAerialToMap(const std::string &aerialImage,
+                                                  const std::string &baseMap,
+                                                  int x, int y,
+                                                  int searchWindow = 450,
+                                                  int matcher = 0);
+
+    /// Coarse to fine match over a radius in base map pixels around x, y, for large prior errors.
+    std::tuple<int, int, double> matchAerialToMapPyramid(const std::string &aerialImage,
+                                                         const std::string &baseMap,
+                                                         int x, int y,
+                                                         int searchRadius);
+
+    /// Caches the base map block spectra used by matchAerialToMap around each (x, y) point.
+    /// Returns the number of cached blocks.
+    int prebuildTileBank(const std::string &baseMap,
+                         const std::vector<std::tuple<int, int>> &points);
 
     void video2frames(const std::string &videoFilePath,
                       const std::string &framesDir,
                       double frameRate);
 
-    void correctDistortion(const std::string &imagePath,
-                           const std::string &cameraMaker,
-                           const std::string &cameraModel,
-                           const std::string &lensMaker,
-                           const std::string &lensModel,
-                           double focalLength,
-                           double aperture,
-                           double distanceToSubject,
-                           int interMethod);
-
     std::string makeFramesDir(const std::string &videoFilePath);
 
     void video2frames(const std::string &videoFilePath, const std::string &framesDir, double frameRate, int maximum);
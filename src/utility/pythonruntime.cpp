@@ -0,0 +1,54 @@
+//
+// Created by Nic on 19/06/2022.
+//
+
+#include "pythonruntime.h"
+#include "pyscriptcaller.h"
+#include <QElapsedTimer>
+#include <QtConcurrent>
+#include <QDebug>
+#include <memory>
+
+PythonRuntime::PythonRuntime(QObject *parent) : QObject(parent) {}
+
+PythonRuntime *PythonRuntime::instance() {
+    static PythonRuntime runtime;
+    return &runtime;
+}
+
+void PythonRuntime::warmUp() {
+    if (warming.isStarted())
+        return;
+    warming = QtConcurrent::run([this]() {
+        QElapsedTimer timer;
+        timer.start();
+        auto resolved = pycall::warmUp();
+        qInfo() << "Python scripts imported," << resolved << "functions resolved in" << timer.elapsed() << "ms";
+        // set on the GUI thread, so whenReady cannot miss the signal
+        QMetaObject::invokeMethod(this, [this]() {
+            warm = true;
+            Q_EMIT ready();
+        }, Qt::QueuedConnection);
+    });
+}
+
+bool PythonRuntime::isReady() const {
+    return warm;
+}
+
+void PythonRuntime::whenReady(QObject *context, std::function<void()> action) {
+    if (isReady()) {
+        action();
+        return;
+    }
+    auto connection = std::make_shared<QMetaObject::Connection>();
+    *connection = connect(this, &PythonRuntime::ready, context, [connection, action = std::move(action)]() {
+        QObject::disconnect(*connection);
+        action();
+    });
+}
+
+void PythonRuntime::release() {
+    warming.waitForFinished();
+    pycall::releaseFunctions();
+}
@@ -0,0 +1,48 @@
+//
+// Created by Nic on 19/06/2022.
+//
+
+#ifndef REALTIME3D_PYTHONRUNTIME_H
+#define REALTIME3D_PYTHONRUNTIME_H
+
+#include <QObject>
+#include <QFuture>
+#include <atomic>
+#include <functional>
+
+/// Start up of the embedded interpreter's scripts.
+/// Importing the scripts pulls in numpy, cv2 and PIL, which takes seconds, so it is done on a worker
+/// at launch rather than on the GUI thread at the first call. Actions on the GUI thread that need the scripts
+/// are queued with whenReady instead of waiting for the imports.
+class PythonRuntime : public QObject {
+Q_OBJECT
+    std::atomic_bool warm{false};
+    QFuture<void> warming;
+
+    explicit PythonRuntime(QObject *parent = nullptr);
+
+public:
+    static PythonRuntime *instance();
+
+    /// Imports the scripts and resolves the functions pycall calls on a worker, ready is emitted when done.
+    /// Needs the interpreter running with the GIL released by the GUI thread.
+    void warmUp();
+
+    [[nodiscard]] bool isReady() const;
+
+    /// Runs action on the thread of context once the scripts are imported, straight away if they are.
+    /// Dropped if context is destroyed first.
+    void whenReady(QObject *context, std::function<void()> action);
+
+    /// Waits for the imports and drops the resolved functions, before the interpreter is finalised.
+    /// Called once nothing can call a script any more, after the main window and the pool jobs are done.
+    void release();
+
+Q_SIGNALS:
+
+    void ready();
+
+};
+
+
+#endif //REALTIME3D_PYTHONRUNTIME_H